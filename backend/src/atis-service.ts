@@ -2,6 +2,8 @@
  * VATSIM ATIS data polling service.
  * Fetches ATIS information from the VATSIM Data API and extracts
  * ATIS letter codes and QNH values for configured airports.
+ * QNH from METARs forwarded by the plugin takes precedence, as those
+ * arrive as soon as EuroScope has them.
  */
 
 const VATSIM_DATA_URL = "https://data.vatsim.net/v3/vatsim-data.json"
@@ -72,11 +74,23 @@ function extractQnh(textLines: string[]): number | undefined {
     return undefined
 }
 
+/**
+ * Extract QNH in hPa from a METAR, converting altimeter settings in inHg.
+ */
+function extractMetarQnh(metar: string): number | undefined {
+    const hpa = metar.match(/\bQ(\d{4})\b/)
+    if (hpa) return parseInt(hpa[1]!, 10)
+    const inhg = metar.match(/\bA(\d{4})\b/)
+    if (inhg) return Math.round((parseInt(inhg[1]!, 10) / 100) * 33.8639)
+    return undefined
+}
+
 export class AtisService {
     private airports: string[] = []
     private pollTimer: ReturnType<typeof setTimeout> | null = null
     private cache = new Map<string, AtisCache>()
     private essaCache: { arrLetter?: string; depLetter?: string; qnh?: number } = {}
+    private metarQnh = new Map<string, number>()
     private onUpdate: () => void
     private pollIntervalMs: number
 
@@ -107,14 +121,28 @@ export class AtisService {
      * Get cached ATIS data for a single-ATIS airport.
      */
     getAtis(airport: string): { letter?: string; qnh?: number } {
-        return this.cache.get(airport) ?? {}
+        const cached = this.cache.get(airport) ?? {}
+        return { ...cached, qnh: this.metarQnh.get(airport) ?? cached.qnh }
     }
 
     /**
      * Get cached ATIS data for ESSA (split arrival/departure ATIS).
      */
     getEssaAtis(): { arrLetter?: string; depLetter?: string; qnh?: number } {
-        return { ...this.essaCache }
+        return { ...this.essaCache, qnh: this.metarQnh.get("ESSA") ?? this.essaCache.qnh }
+    }
+
+    /**
+     * Take the QNH from a METAR forwarded by the plugin. The plugin only
+     * forwards METARs that changed, so this is called rarely.
+     */
+    setMetar(station: string, metar: string): void {
+        if (!this.airports.includes(station)) return
+        const qnh = extractMetarQnh(metar)
+        if (qnh === undefined || qnh < 900 || qnh > 1100) return
+        if (this.metarQnh.get(station) === qnh) return
+        this.metarQnh.set(station, qnh)
+        this.onUpdate()
     }
 
     private schedulePoll(): void {
@@ -12,6 +12,8 @@ const TIZ_URL = 'https://daim.lfv.se/geoserver/wfs?service=WFS&version=1.1.0&req
 interface CtrZone {
     /** Airport ICAO code */
     airport: string
+    /** Zone kind, CTR or TIZ */
+    kind: string
     /** Upper boundary in feet MSL */
     upperFt: number
     /** Polygon coordinates in WGS84 [lat, lon][] */
@@ -59,7 +61,7 @@ function pointInPolygon(lat: number, lon: number, polygon: { lat: number; lon: n
 /**
  * Parse a GeoJSON FeatureCollection from LFV and extract CTR zones.
  */
-function parseFeatures(geojson: any): CtrZone[] {
+function parseFeatures(geojson: any, kind: string): CtrZone[] {
     const zones: CtrZone[] = []
 
     if (!geojson?.features || !Array.isArray(geojson.features)) {
@@ -90,7 +92,7 @@ function parseFeatures(geojson: any): CtrZone[] {
         }
 
         if (polygon.length >= 3) {
-            zones.push({ airport, upperFt, polygon })
+            zones.push({ airport, kind, upperFt, polygon })
         }
     }
 
@@ -119,9 +121,9 @@ export async function loadCtrData(): Promise<number> {
 
     let totalZones = 0
 
-    for (const result of results) {
+    for (const [index, result] of results.entries()) {
         if (result.status === 'fulfilled') {
-            const zones = parseFeatures(result.value)
+            const zones = parseFeatures(result.value, index === 0 ? 'CTR' : 'TIZ')
             for (const zone of zones) {
                 if (!ctrZones.has(zone.airport)) {
                     ctrZones.set(zone.airport, [])
@@ -151,6 +153,35 @@ export function isCtrDataLoaded(): boolean {
     return dataLoaded
 }
 
+/**
+ * Build the UDP messages that send the loaded zones to the EuroScope plugin, which emits
+ * airspaceEnter/airspaceExit events as aircraft move. One message per zone, as all of them
+ * would not fit in one datagram; zones that don't fit in one are skipped.
+ */
+export function getCtrPluginMessages(): string[] {
+    const messages = [JSON.stringify({ type: 'clearAirspaces' })]
+    if (!dataLoaded) return messages
+
+    const round = (degrees: number) => Math.round(degrees * 1e5) / 1e5 // about 1 m
+    for (const [airport, zones] of ctrZones) {
+        for (const zone of zones) {
+            const message = JSON.stringify({
+                type: 'airspace',
+                name: `${airport} ${zone.kind}`,
+                airport,
+                upperFt: zone.upperFt,
+                points: zone.polygon.map(p => [round(p.lat), round(p.lon)])
+            })
+            if (message.length > 65000) {
+                console.warn(`CTR/TIZ zone ${airport} ${zone.kind} too large to send to the plugin`)
+                continue
+            }
+            messages.push(message)
+        }
+    }
+    return messages
+}
+
 /**
  * Check if a position is within any CTR/TIZ zone for the specified airports.
  *
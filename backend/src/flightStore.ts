@@ -3,6 +3,11 @@ import type {
     Flight,
     PluginMessage,
     FlightPlanDataUpdateMessage,
+    FlightPlanDetailMessage,
+    ExtractedRouteMessage,
+    PositionBackfillMessage,
+    CompactExtractedRoute,
+    ExtractedRoutePoint,
     ControllerAssignedDataUpdateMessage,
     RadarTargetPositionUpdateMessage,
     FlightStripPushedMessage,
@@ -55,8 +60,9 @@ export interface ProcessMessageResult {
  * Falls back to flight.sid if route doesn't contain a special SID.
  */
 function extractDisplaySid(flight: Flight): string | undefined {
-    if (flight.route) {
-        const firstTerm = flight.route.split(' ')[0]!
+    const route = flight.route ?? flight.routeHead
+    if (route) {
+        const firstTerm = route.split(' ')[0]!
         const slashIdx = firstTerm.indexOf('/')
         if (slashIdx < 0) return flight.sid
         const prefix = firstTerm.substring(0, slashIdx)
@@ -67,6 +73,24 @@ function extractDisplaySid(flight: Flight): string | undefined {
     return flight.sid
 }
 
+/**
+ * Expand the plugin's compact extracted route
+ */
+function decodeExtractedRoute(route: CompactExtractedRoute): ExtractedRoutePoint[] {
+    const points: ExtractedRoutePoint[] = []
+    for (let i = 0; i + 4 < route.points.length; i += 5) {
+        const airway = route.names[route.points[i + 1]!]
+        points.push({
+            name: route.names[route.points[i]!] ?? '',
+            ...(airway ? { airway } : {}),
+            latitude: route.points[i + 2]! / 1e5,
+            longitude: route.points[i + 3]! / 1e5,
+            distance: route.points[i + 4]! / 10,
+        })
+    }
+    return points
+}
+
 /**
  * Store for managing Flight objects built from EuroScope plugin messages
  */
@@ -397,6 +421,19 @@ class FlightStore {
             case 'flightPlanDataUpdate':
                 return this.handleFlightPlanDataUpdate(message)
 
+            case 'flightPlanSummary':
+                // The same fields as far as they go, the rest arrive with the full update
+                return this.handleFlightPlanDataUpdate({ ...message, type: 'flightPlanDataUpdate' })
+
+            case 'flightPlanDetail':
+                return this.handleFlightPlanDetail(message)
+
+            case 'extractedRoute':
+                return this.handleExtractedRoute(message)
+
+            case 'positionBackfill':
+                return this.handlePositionBackfill(message)
+
             case 'controllerAssignedDataUpdate':
                 return this.handleControllerAssignedDataUpdate(message)
 
@@ -420,6 +457,41 @@ class FlightStore {
         }
     }
 
+    /**
+     * Handle flightPlanDetail message - only shown in the flight plan dialog, so no strip update
+     */
+    private handleFlightPlanDetail(message: FlightPlanDetailMessage): ProcessMessageResult {
+        const flight = this.flights.get(message.callsign)
+        if (!flight || message.found === false) return {}
+        if (message.route !== undefined) flight.route = message.route
+        if (message.remarks !== undefined) flight.flightPlanRemarks = message.remarks
+        if (message.extractedRoute !== undefined) flight.extractedRoute = decodeExtractedRoute(message.extractedRoute)
+        return {}
+    }
+
+    /**
+     * Handle extractedRoute message - not shown on the strip
+     */
+    private handleExtractedRoute(message: ExtractedRouteMessage): ProcessMessageResult {
+        const flight = this.flights.get(message.callsign)
+        if (flight) flight.extractedRoute = decodeExtractedRoute(message)
+        return {}
+    }
+
+    /**
+     * Handle positionBackfill message - replay the recent positions through the airborne
+     * hysteresis, so that e.g. an aircraft low on final is known to be airborne. The strip
+     * follows with the next position update.
+     */
+    private handlePositionBackfill(message: PositionBackfillMessage): ProcessMessageResult {
+        const flight = this.flights.get(message.callsign)
+        if (!flight) return {}
+        for (const [, , , altitude, groundSpeed] of message.points) {
+            this.updateAirborne(flight, altitude, groundSpeed)
+        }
+        return {}
+    }
+
     /**
      * Handle flightPlanDataUpdate message
      */
@@ -442,6 +514,15 @@ class FlightStore {
         if (message.wakeTurbulence !== undefined) flight.wakeTurbulence = message.wakeTurbulence
         if (message.flightRules !== undefined) flight.flightRules = message.flightRules
         if (message.route !== undefined) flight.route = message.route
+        if (message.routeHead !== undefined) {
+            flight.routeHead = message.routeHead
+            // The details may have been amended, they are fetched again when needed
+            if (message.route === undefined) {
+                flight.route = undefined
+                flight.flightPlanRemarks = undefined
+                flight.extractedRoute = undefined
+            }
+        }
         if (message.eobt !== undefined) flight.eobt = message.eobt
         if (message.ete !== undefined) flight.ete = message.ete
         if (message.rfl !== undefined) flight.rfl = message.rfl
@@ -637,19 +718,7 @@ class FlightStore {
         // Auto-set PARK for uncontrolled arrivals stationary at a stand (observer mode support)
         this.tryAutoSetParked(flight)
 
-        const wasAirborne = flight.airborne ?? false
-        const fieldElevation = getFieldElevationForFlight(flight, this.config)
-        const airborneThreshold = fieldElevation + 200
-        const defNotAirborneThreshold = fieldElevation + 30
-        const groundSpeedThreshold = 55
-
-        // Set airborne flag for both departures and arrivals
-        if (!wasAirborne && message.altitude > airborneThreshold) {
-            flight.airborne = true
-        } else if (wasAirborne && message.altitude <= airborneThreshold && (message.groundSpeed <= groundSpeedThreshold || message.altitude <= defNotAirborneThreshold)) {
-            // Aircraft has landed
-            flight.airborne = false
-        }
+        this.updateAirborne(flight, message.altitude, message.groundSpeed)
 
         const deleteState = this.applyDeleteRules(callsign, flight)
         if (deleteState.shortCircuit) {
@@ -674,6 +743,24 @@ class FlightStore {
         )
     }
 
+    /**
+     * Set airborne flag for both departures and arrivals
+     */
+    private updateAirborne(flight: Flight, altitude: number, groundSpeed: number) {
+        const wasAirborne = flight.airborne ?? false
+        const fieldElevation = getFieldElevationForFlight(flight, this.config)
+        const airborneThreshold = fieldElevation + 200
+        const defNotAirborneThreshold = fieldElevation + 30
+        const groundSpeedThreshold = 55
+
+        if (!wasAirborne && altitude > airborneThreshold) {
+            flight.airborne = true
+        } else if (wasAirborne && altitude <= airborneThreshold && (groundSpeed <= groundSpeedThreshold || altitude <= defNotAirborneThreshold)) {
+            // Aircraft has landed
+            flight.airborne = false
+        }
+    }
+
     /**
      * Find section configuration by bay and section ID
      */
@@ -40,7 +40,7 @@ import { store } from "./store.js"
 import { flightStore } from "./flightStore.js"
 import { setMyCallsign, setMyAirports, setIsController, setMyFrequency, setActiveRunways, staticConfig, determineMoveAction, applyConfig, parseControllerRole, setMyRole, updateOnlineController, removeOnlineController, clearOnlineControllers, getControllerCallsign } from "./config.js"
 import type { EuroscopeCommand } from "./config.js"
-import type { MyselfUpdateMessage, ControllerPositionUpdateMessage, ControllerDisconnectMessage, Flight } from "./types.js"
+import type { MyselfUpdateMessage, ControllerPositionUpdateMessage, ControllerDisconnectMessage, MetarMessage, DuplicateSquawkMessage, Flight } from "./types.js"
 import { loadAirports, getAirportCount, getAirportByIcao } from "./airport-data.js"
 import { loadRunways, getRunwayCount, getRunwaysByAirport } from "./runway-data.js"
 import { isOnRunway } from "./runway-detection.js"
@@ -48,7 +48,7 @@ import { loadConfig, getDefaultConfigPath, scanConfigDirectory } from "./config-
 import type { ConfigFileInfo } from "./config-loader.js"
 import { loadStands } from "./stand-data.js"
 import { loadSidData, getSidsForRunway, getSidAltitude } from "./sid-data.js"
-import { loadCtrData, checkCtrAtPosition } from "./ctr-data.js"
+import { loadCtrData, checkCtrAtPosition, getCtrPluginMessages } from "./ctr-data.js"
 import { mockMyselfUpdate } from "./mockPluginMessages.js"
 import { loadHoppieConfig, getLogonCode, getDclAirports, fillDclTemplate, fillDclTemplateWithMarkers } from "./hoppie-config.js"
 import type { DclTemplateData } from "./hoppie-config.js"
@@ -67,15 +67,13 @@ let dataDir = path.resolve(__dirname, "../../data")
 if (!fs.existsSync(dataDir)) dataDir = path.resolve(__dirname, "../data")
 if (!fs.existsSync(dataDir)) dataDir = path.resolve(__dirname, "data")
 
-const port = 17770
-const udpInPort = 17771
 const udpOutPort = 17772
 const udpHost = "127.0.0.1"
 
 // Parse command-line arguments
-function parseArgs(): { config?: string; callsign?: string; airports?: string[]; recordFile?: string; mock?: boolean } {
+function parseArgs(): { config?: string; callsign?: string; airports?: string[]; recordFile?: string; mock?: boolean; port?: number; udpPort?: number } {
     const args = process.argv.slice(2)
-    const result: { config?: string; callsign?: string; airports?: string[]; recordFile?: string; mock?: boolean } = {}
+    const result: { config?: string; callsign?: string; airports?: string[]; recordFile?: string; mock?: boolean; port?: number; udpPort?: number } = {}
 
     for (let i = 0; i < args.length; i++) {
         if (args[i] === "--config" && args[i + 1]) {
@@ -89,6 +87,11 @@ function parseArgs(): { config?: string; callsign?: string; airports?: string[];
             result.recordFile = args[++i]
         } else if (args[i] === "--mock") {
             result.mock = true
+        } else if (args[i] === "--port" && args[i + 1]) {
+            result.port = parseInt(args[++i], 10)
+        } else if (args[i] === "--udp-port" && args[i + 1]) {
+            // For a second backend, with a matching destination line in VatEFSPlugin.txt
+            result.udpPort = parseInt(args[++i], 10)
         }
     }
 
@@ -96,6 +99,8 @@ function parseArgs(): { config?: string; callsign?: string; airports?: string[];
 }
 
 const cliArgs = parseArgs()
+const port = cliArgs.port ?? 17770
+const udpInPort = cliArgs.udpPort ?? 17771
 
 // Configuration management
 const configDir = path.join(dataDir, "config")
@@ -219,7 +224,7 @@ if (EUROSCOPE_DIR) {
 }
 
 // Load CTR/TIZ boundary data from LFV (async, non-fatal)
-loadCtrData().catch((err) => {
+loadCtrData().then(() => sendAirspacesToPlugin()).catch((err) => {
     console.warn(`Failed to load CTR data: ${err instanceof Error ? err.message : err}`)
 })
 
@@ -375,6 +380,7 @@ type OutboundPluginCommand =
     | { type: "assignSid"; callsign: string; sid: string }
     | { type: "assignHeading"; callsign: string; heading: number }
     | { type: "assignCfl"; callsign: string; altitude: number }
+    | { type: "amend"; callsign: string; departureRunway?: string; sid?: string; arrivalRunway?: string; rfl?: number; cfl?: number; heading?: number; squawk?: string }
     | { type: "createFlightPlan"; callsign: string; stripType: "vfrDep" | "vfrArr" | "cross"; origin: string; destination: string; aircraftType: string; flightRules: string }
     | { type: "goaround"; callsign: string }
     | { type: "clearScratchpad"; callsign: string }
@@ -489,17 +495,50 @@ function broadcast(message: ServerMessage, exclude?: WebSocket) {
     })
 }
 
+// Set by the plugin's first myselfUpdate after it has connected, cleared when it is logged off
+let pluginSessionStarted = false
+
+// EFS state shown in the plugin's EuroScope tag items, sent when it changes
+const sentEfsStates = new Map<string, string>()
+
+function sendEfsStateToPlugin(callsign: string, state: { stand: string; bay: string; section: string; clearedToLand: boolean }) {
+    const udpString = JSON.stringify({ type: "efsState", callsign, ...state })
+    if (sentEfsStates.get(callsign) === udpString) return
+    sentEfsStates.set(callsign, udpString)
+    sendUdp(udpString)
+}
+
+function sendStripEfsStateToPlugin(strip: FlightStrip) {
+    sendEfsStateToPlugin(strip.callsign, {
+        stand: strip.stand ?? "",
+        bay: strip.bayId,
+        section: strip.sectionId,
+        clearedToLand: strip.clearedToLand ?? false,
+    })
+}
+
+// The plugin loses its state when it reconnects, and may have dropped it on a refresh
+function resendAllEfsStatesToPlugin() {
+    sentEfsStates.clear()
+    for (const strip of store.getAllStrips()) sendStripEfsStateToPlugin(strip)
+}
+
 // Broadcast a strip update
 function broadcastStrip(strip: FlightStrip, options?: { exclude?: WebSocket; autoMoved?: boolean }) {
     const message: StripMessage = { type: "strip", strip }
     if (options?.autoMoved) message.autoMoved = true
     broadcast(message, options?.exclude)
+    sendStripEfsStateToPlugin(strip)
 }
 
 // Broadcast a strip delete
 function broadcastStripDelete(stripId: string, exclude?: WebSocket) {
     const message: StripDeleteMessage = { type: "stripDelete", stripId }
     broadcast(message, exclude)
+    if (sentEfsStates.has(stripId)) {
+        sendEfsStateToPlugin(stripId, { stand: "", bay: "", section: "", clearedToLand: false })
+        sentEfsStates.delete(stripId)
+    }
 }
 
 // Broadcast a gap update
@@ -1238,6 +1277,7 @@ async function handleTypedMessage(socket: WebSocket, message: ClientMessage) {
                 sendGaps(socket)
             } else if (message.request === "refresh") {
                 sendUdp(JSON.stringify({ type: "refresh" }))
+                resendAllEfsStatesToPlugin()
             }
             break
 
@@ -1481,7 +1521,8 @@ async function handleTypedMessage(socket: WebSocket, message: ClientMessage) {
                             pluginCommand = { type: "assignSid", callsign: strip.callsign, sid: message.value }
                             const sidAlt = getSidAltitude(strip.adep, message.value)
                             if (sidAlt !== undefined) {
-                                sendUdp(JSON.stringify({ type: "assignCfl", callsign: strip.callsign, altitude: sidAlt }))
+                                // SID and CFL in one command
+                                pluginCommand = { type: "amend", callsign: strip.callsign, sid: message.value, cfl: sidAlt }
                                 console.log(`[ASSIGN] Auto-CFL ${sidAlt} for SID ${message.value} at ${strip.adep}`)
                                 mockCflAuto = sidAlt
                             }
@@ -1909,8 +1950,13 @@ app.get("/api/flights", (req, res) => {
     res.json(flights)
 })
 
-app.get("/api/flight/:callsign", (req, res) => {
-    const flight = flightStore.getFlight(req.params.callsign)
+app.get("/api/flight/:callsign", async (req, res) => {
+    let flight = flightStore.getFlight(req.params.callsign)
+    // With the plugin's lazydetail setting the route and remarks are fetched when needed
+    if (flight && flight.route === undefined && flight.routeHead !== undefined) {
+        await fetchFlightPlanDetail(flight.callsign)
+        flight = flightStore.getFlight(req.params.callsign)
+    }
     if (flight) {
         res.json(flight)
     } else {
@@ -2068,6 +2114,63 @@ function sendUdp(udpString: string) {
     lastUdpString = udpString
 }
 
+// Send CTR/TIZ zones to the plugin. Its airspace enter/exit events are not subscribed to, as
+// nothing here handles them yet, but a target crossing a zone boundary still gets its position
+// sent while ground positions are throttled.
+function sendAirspacesToPlugin() {
+    for (const message of getCtrPluginMessages()) sendUdp(message)
+}
+
+// Tell the plugin what to send, so that it doesn't encode what is ignored here. Message types
+// the plugin can't filter are always sent. Only the types and fields are restricted, as strips
+// are created by distance to our airports rather than by origin and destination.
+function sendSubscriptionToPlugin() {
+    sendUdp(JSON.stringify({
+        type: "subscribe",
+        port: udpInPort, // so that it only applies to this backend if the plugin has several
+        types: [
+            "flightPlanDataUpdate",
+            "flightPlanSummary",
+            "controllerAssignedDataUpdate",
+            "radarTargetPositionUpdate",
+            "extractedRoute",
+            "positionBackfill",
+            "metar",
+            "duplicateSquawk",
+        ],
+        stations: staticConfig.myAirports,
+        excludeFields: ["verticalSpeed", "heading"],
+    }))
+}
+
+// Requests waiting for flightPlanDetail, by callsign
+const FLIGHT_PLAN_DETAIL_TIMEOUT_MS = 1000
+const pendingFlightPlanDetails = new Map<string, (() => void)[]>()
+
+function fetchFlightPlanDetail(callsign: string): Promise<void> {
+    return new Promise((resolve) => {
+        let waiting = pendingFlightPlanDetails.get(callsign)
+        if (!waiting) {
+            waiting = []
+            pendingFlightPlanDetails.set(callsign, waiting)
+            sendUdp(JSON.stringify({ type: "getFlightPlanDetail", callsign }))
+        }
+        waiting.push(resolve)
+        // Answer without the details rather than hang if the plugin doesn't respond
+        const requested = waiting
+        setTimeout(() => {
+            if (pendingFlightPlanDetails.get(callsign) === requested) pendingFlightPlanDetails.delete(callsign)
+            resolve()
+        }, FLIGHT_PLAN_DETAIL_TIMEOUT_MS)
+    })
+}
+
+function resolveFlightPlanDetail(callsign: string) {
+    const waiting = pendingFlightPlanDetails.get(callsign)
+    pendingFlightPlanDetails.delete(callsign)
+    waiting?.forEach((resolve) => resolve())
+}
+
 // UDP socket for receiving
 const udpIn = dgram.createSocket("udp4")
 udpIn.on("message", (msg, rinfo) => {
@@ -2081,6 +2184,7 @@ udpIn.on("message", (msg, rinfo) => {
         // Handle connectionTypeUpdate - connection type 0 means logged off
         if (data.type === "connectionTypeUpdate" && data.connectionType === 0) {
             console.log("Connection lost (connectionType 0), clearing stores")
+            pluginSessionStarted = false
             store.clear()
             setMyCallsign("")
             setMyAirports([])
@@ -2104,6 +2208,19 @@ udpIn.on("message", (msg, rinfo) => {
             return
         }
 
+        // Handle metar - only sent when it changed, for our airports
+        if (data.type === "metar") {
+            const msg = data as MetarMessage
+            atisService?.setMetar(msg.station, msg.metar)
+            return
+        }
+
+        if (data.type === "duplicateSquawk") {
+            const msg = data as DuplicateSquawkMessage
+            console.warn(`Duplicate squawk ${msg.squawk}: ${msg.callsigns.join(", ")}`)
+            return
+        }
+
         // Handle controllerPositionUpdate - track online controllers at our airports
         if (data.type === "controllerPositionUpdate") {
             const msg = data as ControllerPositionUpdateMessage
@@ -2149,6 +2266,15 @@ udpIn.on("message", (msg, rinfo) => {
                 console.log(`My callsign set to: ${msg.callsign}`)
             }
 
+            // The plugin has (re)connected, it only listens while connected. Not tied to the callsign
+            // changing, as --callsign and --mock set it before the plugin's first update.
+            if (!pluginSessionStarted) {
+                pluginSessionStarted = true
+                sendSubscriptionToPlugin()
+                sendAirspacesToPlugin()
+                resendAllEfsStatesToPlugin()
+            }
+
             setIsController(msg.controller)
 
             // Parse controller role from callsign (only when not in mock mode, which sets it at startup)
@@ -2194,7 +2320,10 @@ udpIn.on("message", (msg, rinfo) => {
                     const airportsChanged = JSON.stringify(previousAirports.sort()) !== JSON.stringify(knownAirports.sort())
 
                     setMyAirports(knownAirports)
-                    if (airportsChanged) console.log(`Airports discovered from rwyconfig: ${knownAirports.join(", ")}`)
+                    if (airportsChanged) {
+                        console.log(`Airports discovered from rwyconfig: ${knownAirports.join(", ")}`)
+                        sendSubscriptionToPlugin() // for the METARs of these airports
+                    }
 
                     // If airports changed, we need to refresh
                     if (airportsChanged && previousAirports.length > 0) {
@@ -2246,6 +2375,7 @@ udpIn.on("message", (msg, rinfo) => {
 
         // Try to process as plugin message
         const result = store.tryProcessPluginMessage(data)
+        if (data.type === "flightPlanDetail") resolveFlightPlanDetail(data.callsign)
 
         if (result) {
             // Plugin message was processed - only broadcast/log if there was an actual change
@@ -21,6 +21,9 @@ export interface Flight {
     wakeTurbulence?: string   // L/M/H/J
     flightRules?: string      // I/V/Y/Z
     route?: string
+    routeHead?: string        // First term of the route, when the rest is fetched on demand
+    flightPlanRemarks?: string // RMK, fetched with the route on demand
+    extractedRoute?: ExtractedRoutePoint[]
     eobt?: string              // Estimated Off Block Time (HHmm)
     ete?: number               // Estimated Time Enroute (seconds)
 
@@ -99,6 +102,25 @@ export function flightHasRequiredData(flight: Flight): boolean {
     )
 }
 
+export interface ExtractedRoutePoint {
+    name: string
+    airway?: string
+    latitude: number
+    longitude: number
+    distance: number          // nm along the route from the first point
+}
+
+/**
+ * Extracted route as sent by the plugin: points are flat, five numbers each - name and airway
+ * as indices into names (0 is no airway), latitude and longitude in 1e-5 degrees and distance
+ * in 0.1 nm.
+ */
+export interface CompactExtractedRoute {
+    version?: number
+    names: string[]
+    points: number[]
+}
+
 // Plugin message types
 
 export interface FlightPlanDataUpdateMessage {
@@ -112,6 +134,7 @@ export interface FlightPlanDataUpdateMessage {
     wakeTurbulence?: string   // L/M/H/J
     flightRules?: string      // I/V/Y/Z
     route?: string
+    routeHead?: string         // Instead of route with the plugin's lazydetail setting
     eobt?: string              // Estimated Off Block Time (HHmm)
     ete?: number               // Estimated Time Enroute (seconds)
     rfl?: number              // Requested flight level (feet)
@@ -126,6 +149,54 @@ export interface FlightPlanDataUpdateMessage {
     nextControllerFrequency?: number // Next controller frequency
 }
 
+/**
+ * Compact record for a flight plan outside the plugin's horizon window (EOBT or ETE too far
+ * ahead). The full flightPlanDataUpdate follows when it enters the window.
+ */
+export interface FlightPlanSummaryMessage {
+    type: 'flightPlanSummary'
+    callsign: string
+    origin?: string
+    destination?: string
+    aircraftType?: string
+    flightRules?: string
+    eobt?: string
+    ete?: number
+}
+
+/**
+ * Heavy flight plan fields, in response to getFlightPlanDetail. found is false if the plugin has
+ * no flight plan for the callsign.
+ */
+export interface FlightPlanDetailMessage {
+    type: 'flightPlanDetail'
+    callsign: string
+    found?: boolean
+    route?: string
+    remarks?: string
+    extractedRoute?: CompactExtractedRoute
+}
+
+/**
+ * Sent after flightPlanDataUpdate when the extracted route has changed (not with the plugin's
+ * lazydetail setting, then it comes with flightPlanDetail)
+ */
+export interface ExtractedRouteMessage extends CompactExtractedRoute {
+    type: 'extractedRoute'
+    callsign: string
+}
+
+/**
+ * Recent positions of a target, oldest first, sent by the plugin after a refresh so that
+ * position-based state starts from the target's recent history rather than a single report.
+ * Points are [time (epoch seconds), latitude, longitude, altitude (ft), ground speed (kt)].
+ */
+export interface PositionBackfillMessage {
+    type: 'positionBackfill'
+    callsign: string
+    points: [number, number, number, number, number][]
+}
+
 export interface ControllerAssignedDataUpdateMessage {
     type: 'controllerAssignedDataUpdate'
     callsign: string
@@ -138,6 +209,14 @@ export interface ControllerAssignedDataUpdateMessage {
     clearedToLand?: boolean
     scratch?: string          // Raw scratchpad value (unrecognized by plugin, e.g. "MISAP_" or "")
     stand?: string
+    // Decoded TopSky scratchpad events (TopSky's internal ones are dropped by the plugin)
+    hold?: string             // Holding fix, "" when the hold is cancelled or left
+    coordination?: { code: string; fields: string[] } // e.g. code "SBY/RTI", fields [controller, level]
+    operatorText?: string
+    operatorTextRequest?: { controller?: string; callsign?: string; text?: string }
+    approachCategory?: number // 2 or 3
+    onContact?: boolean
+    starAcknowledged?: string
     asp?: number
     mach?: number
     arc?: number
@@ -175,6 +254,20 @@ export interface ControllerDisconnectMessage {
     callsign: string
 }
 
+/** Sent by the plugin when a station's METAR has changed */
+export interface MetarMessage {
+    type: 'metar'
+    station: string
+    metar: string
+}
+
+/** Sent by the plugin when a target starts squawking a discrete code another target squawks */
+export interface DuplicateSquawkMessage {
+    type: 'duplicateSquawk'
+    squawk: string
+    callsigns: string[]
+}
+
 export interface MyselfUpdateMessage {
     type: 'myselfUpdate'
     callsign: string
@@ -206,6 +299,10 @@ export interface RadarTargetPositionUpdateMessage {
 
 export type PluginMessage =
     | FlightPlanDataUpdateMessage
+    | FlightPlanSummaryMessage
+    | FlightPlanDetailMessage
+    | ExtractedRouteMessage
+    | PositionBackfillMessage
     | ControllerAssignedDataUpdateMessage
     | FlightPlanDisconnectMessage
     | FlightStripPushedMessage
@@ -224,6 +321,10 @@ export function isPluginMessage(data: unknown): data is PluginMessage {
     const type = (data as { type: unknown }).type
     return (
         type === 'flightPlanDataUpdate' ||
+        type === 'flightPlanSummary' ||
+        type === 'flightPlanDetail' ||
+        type === 'extractedRoute' ||
+        type === 'positionBackfill' ||
         type === 'controllerAssignedDataUpdate' ||
         type === 'flightPlanDisconnect' ||
         type === 'flightPlanFlightStripPushed' ||
@@ -0,0 +1,239 @@
+#include "airspace.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace VatEFS
+{
+
+static int CellOf(double degrees, double cellDegrees)
+{
+    return static_cast<int>(std::floor(degrees / cellDegrees));
+}
+
+static std::int64_t Key(int latitudeCell, int longitudeCell)
+{
+    return (static_cast<std::int64_t>(latitudeCell) << 32) ^ static_cast<std::uint32_t>(longitudeCell);
+}
+
+void AirspaceIndex::Clear()
+{
+    zones.clear();
+    nodes.clear();
+    children.clear();
+    root = NONE;
+    cells.clear();
+    cellIndex.clear();
+    dirty = true;
+}
+
+void AirspaceIndex::Add(const std::string &name, const std::string &airport, int lowerFt, int upperFt,
+                        const std::vector<GeoPoint> &points)
+{
+    if (points.size() < 3) return;
+    Zone zone;
+    zone.name = name;
+    zone.airport = airport;
+    zone.lowerFt = lowerFt;
+    zone.upperFt = upperFt;
+    zone.points = points;
+    zone.minLatitude = zone.maxLatitude = points[0].latitude;
+    zone.minLongitude = zone.maxLongitude = points[0].longitude;
+    for (const GeoPoint &p : points) {
+        zone.minLatitude = std::min(zone.minLatitude, p.latitude);
+        zone.maxLatitude = std::max(zone.maxLatitude, p.latitude);
+        zone.minLongitude = std::min(zone.minLongitude, p.longitude);
+        zone.maxLongitude = std::max(zone.maxLongitude, p.longitude);
+    }
+    zones.push_back(std::move(zone));
+    dirty = true;
+}
+
+void AirspaceIndex::Build()
+{
+    BuildTree();
+    BuildCells();
+    dirty = false;
+}
+
+void AirspaceIndex::BuildTree()
+{
+    // Sort-Tile-Recursive packing: sort by longitude into vertical slices, each slice by latitude,
+    // and group runs of NODE_CAPACITY entries into nodes, level by level up to the root
+    nodes.clear();
+    children.clear();
+    root = NONE;
+    if (zones.empty()) return;
+
+    struct Entry {
+        Box box;
+        int ref; // zone on the first level, node above that
+    };
+    std::vector<Entry> level;
+    for (int i = 0; i < Count(); i++) {
+        const Zone &zone = zones[i];
+        const Box box = { zone.minLatitude, zone.maxLatitude, zone.minLongitude, zone.maxLongitude };
+        level.push_back({ box, i });
+    }
+    auto byLatitude = [](const Entry &a, const Entry &b) {
+        return a.box.minLatitude + a.box.maxLatitude < b.box.minLatitude + b.box.maxLatitude;
+    };
+    auto byLongitude = [](const Entry &a, const Entry &b) {
+        return a.box.minLongitude + a.box.maxLongitude < b.box.minLongitude + b.box.maxLongitude;
+    };
+
+    bool leaf = true;
+    do {
+        const std::size_t nodeCount = (level.size() + NODE_CAPACITY - 1) / NODE_CAPACITY;
+        const auto sliceCount = static_cast<std::size_t>(std::ceil(std::sqrt((double)nodeCount)));
+        const std::size_t sliceSize = sliceCount * NODE_CAPACITY;
+        std::sort(level.begin(), level.end(), byLongitude);
+        for (std::size_t start = 0; start < level.size(); start += sliceSize) {
+            auto end = level.begin() + std::min(start + sliceSize, level.size());
+            std::sort(level.begin() + start, end, byLatitude);
+        }
+
+        std::vector<Entry> parents;
+        for (std::size_t start = 0; start < level.size(); start += NODE_CAPACITY) {
+            const std::size_t end = std::min(start + NODE_CAPACITY, level.size());
+            Node node;
+            node.box = level[start].box;
+            node.begin = static_cast<int>(children.size());
+            node.leaf = leaf;
+            for (std::size_t i = start; i < end; i++) {
+                const Box &box = level[i].box;
+                node.box.minLatitude = std::min(node.box.minLatitude, box.minLatitude);
+                node.box.maxLatitude = std::max(node.box.maxLatitude, box.maxLatitude);
+                node.box.minLongitude = std::min(node.box.minLongitude, box.minLongitude);
+                node.box.maxLongitude = std::max(node.box.maxLongitude, box.maxLongitude);
+                children.push_back(level[i].ref);
+            }
+            node.end = static_cast<int>(children.size());
+            nodes.push_back(node);
+            parents.push_back({ node.box, static_cast<int>(nodes.size()) - 1 });
+        }
+        level.swap(parents);
+        leaf = false;
+    } while (level.size() > 1);
+    root = level[0].ref;
+}
+
+AirspaceIndex::Cell &AirspaceIndex::CellAt(int latitudeCell, int longitudeCell)
+{
+    auto inserted = cellIndex.emplace(Key(latitudeCell, longitudeCell), static_cast<int>(cells.size()));
+    if (inserted.second) cells.emplace_back();
+    return cells[inserted.first->second];
+}
+
+void AirspaceIndex::BuildCells()
+{
+    cells.clear();
+    cellIndex.clear();
+
+    // Cells crossed by each boundary segment, by walking the grid along it
+    for (const Zone &zone : zones) {
+        for (std::size_t i = 0, j = zone.points.size() - 1; i < zone.points.size(); j = i++) {
+            const GeoPoint &a = zone.points[j], &b = zone.points[i];
+            const double x0 = a.longitude / CELL_DEGREES, y0 = a.latitude / CELL_DEGREES;
+            const double x1 = b.longitude / CELL_DEGREES, y1 = b.latitude / CELL_DEGREES;
+            int x = static_cast<int>(std::floor(x0)), y = static_cast<int>(std::floor(y0));
+            const int endX = static_cast<int>(std::floor(x1)), endY = static_cast<int>(std::floor(y1));
+            const int stepX = x1 > x0 ? 1 : -1, stepY = y1 > y0 ? 1 : -1;
+            const double dx = std::abs(x1 - x0), dy = std::abs(y1 - y0);
+            double nextX = dx == 0 ? HUGE_VAL : (stepX > 0 ? x + 1 - x0 : x0 - x) / dx;
+            double nextY = dy == 0 ? HUGE_VAL : (stepY > 0 ? y + 1 - y0 : y0 - y) / dy;
+            int steps = std::abs(endX - x) + std::abs(endY - y);
+            CellAt(y, x).boundary = true;
+            for (; steps > 0; steps--) {
+                if (nextX < nextY) {
+                    x += stepX;
+                    nextX += 1 / dx;
+                } else {
+                    y += stepY;
+                    nextY += 1 / dy;
+                }
+                CellAt(y, x).boundary = true;
+            }
+        }
+    }
+
+    // Zones covering the other cells in their bounding box, decided by the cell's center
+    for (int zone = 0; zone < Count(); zone++) {
+        const Zone &z = zones[zone];
+        const int minLat = CellOf(z.minLatitude, CELL_DEGREES), maxLat = CellOf(z.maxLatitude, CELL_DEGREES);
+        const int minLon = CellOf(z.minLongitude, CELL_DEGREES), maxLon = CellOf(z.maxLongitude, CELL_DEGREES);
+        for (int lat = minLat; lat <= maxLat; lat++) {
+            for (int lon = minLon; lon <= maxLon; lon++) {
+                auto it = cellIndex.find(Key(lat, lon));
+                if (it != cellIndex.end() && cells[it->second].boundary) continue;
+                const GeoPoint center = { (lat + 0.5) * CELL_DEGREES, (lon + 0.5) * CELL_DEGREES };
+                if (PointInPolygon(center, z.points)) CellAt(lat, lon).inside.push_back(zone);
+            }
+        }
+    }
+    for (Cell &cell : cells) {
+        std::sort(cell.inside.begin(), cell.inside.end(),
+                  [&](int a, int b) { return zones[a].upperFt < zones[b].upperFt; });
+    }
+}
+
+std::int64_t AirspaceIndex::CellKey(GeoPoint position)
+{
+    return Key(CellOf(position.latitude, CELL_DEGREES), CellOf(position.longitude, CELL_DEGREES));
+}
+
+int AirspaceIndex::FindCell(std::int64_t cellKey) const
+{
+    auto it = cellIndex.find(cellKey);
+    return it == cellIndex.end() ? NONE : it->second;
+}
+
+bool AirspaceIndex::Contains(const Box &box, GeoPoint position)
+{
+    return position.latitude >= box.minLatitude && position.latitude <= box.maxLatitude &&
+           position.longitude >= box.minLongitude && position.longitude <= box.maxLongitude;
+}
+
+bool AirspaceIndex::IsWithinLimits(const Zone &zone, int altitude)
+{
+    return (zone.lowerFt == SURFACE || altitude >= zone.lowerFt) && altitude <= zone.upperFt;
+}
+
+int AirspaceIndex::Find(int cell, GeoPoint position, int altitude) const
+{
+    if (cell == NONE) return NONE;
+    if (cells[cell].boundary) return Find(position, altitude);
+    for (int zone : cells[cell].inside) {
+        if (IsWithinLimits(zones[zone], altitude)) return zone;
+    }
+    return NONE;
+}
+
+int AirspaceIndex::Find(GeoPoint position, int altitude) const
+{
+    if (root == NONE) return NONE;
+    int found = NONE;
+    int stack[64]; // depth * (NODE_CAPACITY - 1) + 1 is enough
+    int top = 0;
+    stack[top++] = root;
+    while (top > 0) {
+        const Node &node = nodes[stack[--top]];
+        if (!Contains(node.box, position)) continue;
+        for (int i = node.begin; i < node.end; i++) {
+            if (!node.leaf) {
+                stack[top++] = children[i];
+                continue;
+            }
+            const Zone &zone = zones[children[i]];
+            if (!IsWithinLimits(zone, altitude) || (found != NONE && zones[found].upperFt <= zone.upperFt))
+                continue;
+            if (position.latitude < zone.minLatitude || position.latitude > zone.maxLatitude ||
+                position.longitude < zone.minLongitude || position.longitude > zone.maxLongitude)
+                continue;
+            if (PointInPolygon(position, zone.points)) found = children[i];
+        }
+    }
+    return found;
+}
+
+} // namespace VatEFS
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "geofence.h"
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace VatEFS
+{
+
+// Controlled airspace volumes (CTR/TIZ from ctr-data.ts in the backend, which sends them to the
+// plugin): polygons with lower and upper limits, in a packed R-tree. On top of that, the area is
+// divided into cells. Most cells are crossed by no zone boundary, so the zones covering them are
+// known in advance and only the altitude needs checking; only cells on a boundary need the full
+// R-tree and point-in-polygon test.
+class AirspaceIndex
+{
+    public:
+    static constexpr int NONE = -1;
+    static constexpr std::int64_t NO_CELL = INT64_MIN;
+    static constexpr int SURFACE = INT_MIN; // lower limit of zones from the ground up
+
+    struct Zone {
+        std::string name;
+        std::string airport;
+        int lowerFt, upperFt;
+        std::vector<GeoPoint> points;
+        double minLatitude, maxLatitude, minLongitude, maxLongitude;
+    };
+
+    void Clear();
+    void Add(const std::string &name, const std::string &airport, int lowerFt, int upperFt,
+             const std::vector<GeoPoint> &points);
+    // Builds the R-tree and cells, after zones have been added
+    void Build();
+    bool NeedsBuild() const
+    {
+        return dirty;
+    }
+
+    static std::int64_t CellKey(GeoPoint position);
+    // Index of the cell for Find(), NONE if no zone is near the cell
+    int FindCell(std::int64_t cellKey) const;
+    // The zone the position is in, the one with the lowest upper limit if zones overlap
+    int Find(int cell, GeoPoint position, int altitude) const;
+    int Find(GeoPoint position, int altitude) const;
+
+    const Zone &Get(int zone) const
+    {
+        return zones[zone];
+    }
+    int Count() const
+    {
+        return static_cast<int>(zones.size());
+    }
+    int CellCount() const
+    {
+        return static_cast<int>(cells.size());
+    }
+
+    private:
+    static constexpr double CELL_DEGREES = 0.05; // about 5 km north-south
+    static constexpr int NODE_CAPACITY = 8;
+
+    struct Box {
+        double minLatitude, maxLatitude, minLongitude, maxLongitude;
+    };
+    struct Node {
+        Box box;
+        int begin, end; // range in children: node indices, or zone indices for leaves
+        bool leaf;
+    };
+    struct Cell {
+        bool boundary = false; // crossed by a zone boundary, needs the full test
+        std::vector<int> inside; // zones covering the whole cell, lowest upper limit first
+    };
+
+    static bool Contains(const Box &box, GeoPoint position);
+    static bool IsWithinLimits(const Zone &zone, int altitude);
+    void BuildTree();
+    void BuildCells();
+    Cell &CellAt(int latitudeCell, int longitudeCell);
+
+    std::vector<Zone> zones;
+    std::vector<Node> nodes;
+    std::vector<int> children;
+    int root = NONE;
+    std::vector<Cell> cells;
+    std::unordered_map<std::int64_t, int> cellIndex; // cell key to index in cells
+    bool dirty = false;
+};
+
+} // namespace VatEFS
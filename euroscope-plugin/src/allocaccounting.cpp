@@ -0,0 +1,97 @@
+#include "allocaccounting.h"
+
+#ifdef VATEFS_ALLOC_ACCOUNTING
+
+#include <cstdlib>
+#include <new>
+
+namespace VatEFS
+{
+
+static AllocCounters counters;
+static thread_local AllocEntryPoint currentEntryPoint = ALLOC_NONE;
+
+AllocScope::AllocScope(AllocEntryPoint entryPoint) : previous(currentEntryPoint)
+{
+    currentEntryPoint = entryPoint;
+    counters.calls[entryPoint]++;
+}
+
+AllocScope::~AllocScope()
+{
+    currentEntryPoint = previous;
+}
+
+const AllocCounters &GetAllocCounters()
+{
+    return counters;
+}
+
+void ResetAllocCounters()
+{
+    counters = AllocCounters();
+}
+
+const char *AllocEntryPointName(AllocEntryPoint entryPoint)
+{
+    switch (entryPoint) {
+    case ALLOC_RADAR:
+        return "radar target update";
+    case ALLOC_FLIGHT_PLAN:
+        return "flight plan update";
+    case ALLOC_CONTROLLER:
+        return "controller update";
+    case ALLOC_TIMER:
+        return "timer";
+    case ALLOC_INBOUND:
+        return "inbound command";
+    case ALLOC_METAR:
+        return "METAR";
+    default:
+        return "other";
+    }
+}
+
+static void *CountedAllocate(std::size_t size)
+{
+    counters.allocations[currentEntryPoint]++;
+    return std::malloc(size ? size : 1);
+}
+
+} // namespace VatEFS
+
+// Replacing these in the DLL only affects allocations made by the plugin itself. The nothrow and
+// aligned forms are left to the runtime, the former forward to the ones below.
+void *operator new(std::size_t size)
+{
+    if (void *p = VatEFS::CountedAllocate(size)) return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    if (void *p = VatEFS::CountedAllocate(size)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+#endif
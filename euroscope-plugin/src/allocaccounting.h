@@ -0,0 +1,54 @@
+#pragma once
+
+namespace VatEFS
+{
+
+// Plugin entry points that heap allocations are attributed to
+enum AllocEntryPoint {
+    ALLOC_NONE,
+    ALLOC_RADAR,       // OnRadarTargetPositionUpdate
+    ALLOC_FLIGHT_PLAN, // flight plan data, controller assigned data, disconnect, strip pushed
+    ALLOC_CONTROLLER,  // OnControllerPositionUpdate, OnControllerDisconnect
+    ALLOC_TIMER,       // OnTimer, except inbound commands
+    ALLOC_INBOUND,     // commands received from the backend
+    ALLOC_METAR,       // OnNewMetarReceived
+    ALLOC_ENTRY_POINTS
+};
+
+#ifdef VATEFS_ALLOC_ACCOUNTING
+
+// Built with -DVATEFS_ALLOC_ACCOUNTING=ON, global operator new is replaced with one that counts
+// calls against the innermost AllocScope on the calling thread. Shown by .efs stats, which makes
+// the steady-state allocation count of each entry point visible instead of assumed.
+struct AllocCounters {
+    unsigned long long calls[ALLOC_ENTRY_POINTS] = {};
+    unsigned long long allocations[ALLOC_ENTRY_POINTS] = {};
+};
+
+class AllocScope
+{
+    public:
+    explicit AllocScope(AllocEntryPoint entryPoint);
+    ~AllocScope();
+    AllocScope(const AllocScope &) = delete;
+    AllocScope &operator=(const AllocScope &) = delete;
+
+    private:
+    AllocEntryPoint previous;
+};
+
+const AllocCounters &GetAllocCounters();
+void ResetAllocCounters();
+const char *AllocEntryPointName(AllocEntryPoint entryPoint);
+
+#else
+
+class AllocScope
+{
+    public:
+    explicit AllocScope(AllocEntryPoint) {}
+};
+
+#endif
+
+} // namespace VatEFS
@@ -0,0 +1,77 @@
+#include "arrivalmetrics.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace VatEFS
+{
+
+static constexpr double EARTH_RADIUS_NM = 3440.065;
+static constexpr double DEG_TO_RAD = 3.14159265358979323846 / 180;
+static constexpr double MIN_CLOSURE_KT = 60; // for the ETA of targets not (yet) heading inbound
+
+void ArrivalThresholds::Clear()
+{
+    points.clear();
+}
+
+void ArrivalThresholds::AddRunwayEnd(const std::string &airport, const std::string &runway, GeoPoint threshold)
+{
+    points[airport + " " + runway] = threshold;
+}
+
+void ArrivalThresholds::AddAirport(const std::string &airport, GeoPoint position)
+{
+    points[airport] = position;
+}
+
+bool ArrivalThresholds::Find(std::string_view airport, std::string_view runway, GeoPoint &threshold) const
+{
+    std::string key(airport);
+    if (!runway.empty()) {
+        auto it = points.find(key + " " + std::string(runway));
+        if (it != points.end()) {
+            threshold = it->second;
+            return true;
+        }
+    }
+    auto it = points.find(key);
+    if (it == points.end()) return false;
+    threshold = it->second;
+    return true;
+}
+
+void ComputeArrivalMetrics(int count,
+                           const double *latitude,
+                           const double *longitude,
+                           const double *thresholdLatitude,
+                           const double *thresholdLongitude,
+                           const int *groundSpeed,
+                           const int *heading,
+                           double *distance,
+                           double *closure,
+                           double *eta)
+{
+    // Haversine distance and initial bearing
+    for (int i = 0; i < count; i++) {
+        const double lat1 = latitude[i] * DEG_TO_RAD;
+        const double lat2 = thresholdLatitude[i] * DEG_TO_RAD;
+        const double dLat = lat2 - lat1;
+        const double dLon = (thresholdLongitude[i] - longitude[i]) * DEG_TO_RAD;
+        const double sinLat = std::sin(dLat * 0.5);
+        const double sinLon = std::sin(dLon * 0.5);
+        const double cosLat1 = std::cos(lat1), cosLat2 = std::cos(lat2);
+        const double a = sinLat * sinLat + cosLat1 * cosLat2 * sinLon * sinLon;
+        distance[i] = 2 * EARTH_RADIUS_NM * std::asin(std::sqrt(std::min(a, 1.0)));
+
+        const double y = std::sin(dLon) * cosLat2;
+        const double x = cosLat1 * std::sin(lat2) - std::sin(lat1) * cosLat2 * std::cos(dLon);
+        const double bearing = std::atan2(y, x);
+        closure[i] = groundSpeed[i] * std::cos(heading[i] * DEG_TO_RAD - bearing);
+    }
+    for (int i = 0; i < count; i++) {
+        eta[i] = distance[i] / std::max(closure[i], MIN_CLOSURE_KT) * 3600;
+    }
+}
+
+} // namespace VatEFS
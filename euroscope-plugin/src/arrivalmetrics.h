@@ -0,0 +1,40 @@
+#pragma once
+
+#include "geofence.h"
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace VatEFS
+{
+
+// Arrival runway thresholds (and airport reference points, for flight plans without an arrival
+// runway) from the sector file
+class ArrivalThresholds
+{
+    public:
+    void Clear();
+    void AddRunwayEnd(const std::string &airport, const std::string &runway, GeoPoint threshold);
+    void AddAirport(const std::string &airport, GeoPoint position);
+    // Threshold of the runway at the airport, the airport itself if the runway isn't known
+    bool Find(std::string_view airport, std::string_view runway, GeoPoint &threshold) const;
+
+    private:
+    std::unordered_map<std::string, GeoPoint> points; // "ESSA" or "ESSA 19R"
+};
+
+// Great-circle distance (nm) and bearing from each position to its threshold, the closure rate
+// (kt) from ground speed and heading, and the time (s) to the threshold at that rate. Plain loops
+// over the target table's columns without branches, for the compiler to vectorize.
+void ComputeArrivalMetrics(int count,
+                           const double *latitude,
+                           const double *longitude,
+                           const double *thresholdLatitude,
+                           const double *thresholdLongitude,
+                           const int *groundSpeed,
+                           const int *heading,
+                           double *distance,
+                           double *closure,
+                           double *eta);
+
+} // namespace VatEFS
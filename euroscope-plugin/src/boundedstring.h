@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace VatEFS
+{
+
+// Fixed-capacity copy of a (possibly null) string returned by EuroScope. The string is walked
+// once, copying at most MaxLength characters while checking UTF-8 validity and ASCII-ness, instead
+// of the null check, strlen, strlen again, IsValidUtf8 and copy that each field used to need.
+template <std::size_t MaxLength>
+class BoundedString
+{
+    public:
+    static constexpr std::size_t MAX_LENGTH = MaxLength;
+
+    BoundedString()
+    {
+        buffer[0] = '\0';
+    }
+    explicit BoundedString(const char *str)
+    {
+        Assign(str);
+    }
+
+    void Assign(const char *str)
+    {
+        length = 0;
+        null = str == nullptr;
+        tooLong = false;
+        utf8 = true;
+        ascii = true;
+        if (null) {
+            buffer[0] = '\0';
+            return;
+        }
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(str);
+        int continuations = 0; // continuation bytes still expected for the current sequence
+        for (unsigned char c; (c = *p) != 0; p++) {
+            if (length == MaxLength) {
+                tooLong = true;
+                break;
+            }
+            buffer[length++] = static_cast<char>(c);
+            if (continuations > 0) {
+                if ((c & 0xC0) != 0x80) utf8 = false;
+                continuations--;
+                continue;
+            }
+            if (c <= 0x7F) continue;
+            ascii = false;
+            if (c >= 0xC2 && c <= 0xDF)
+                continuations = 1;
+            else if (c >= 0xE0 && c <= 0xEF)
+                continuations = 2;
+            else if (c >= 0xF0 && c <= 0xF4)
+                continuations = 3;
+            else
+                utf8 = false; // invalid lead byte (0x80-0xBF, 0xC0-0xC1, 0xF5-0xFF)
+        }
+        if (continuations > 0) utf8 = false;
+        buffer[length] = '\0';
+    }
+
+    bool IsNull() const
+    {
+        return null;
+    }
+    bool IsEmpty() const
+    {
+        return length == 0;
+    }
+    // Longer than MaxLength - the contents are truncated
+    bool IsTooLong() const
+    {
+        return tooLong;
+    }
+    bool IsValidUtf8() const
+    {
+        return utf8;
+    }
+    bool IsAscii() const
+    {
+        return ascii && !tooLong;
+    }
+    // Present, within MaxLength and valid UTF-8
+    bool IsValid() const
+    {
+        return !null && !tooLong && utf8;
+    }
+    std::size_t Length() const
+    {
+        return length;
+    }
+    const char *CStr() const
+    {
+        return buffer;
+    }
+    std::string_view View() const
+    {
+        return std::string_view(buffer, length);
+    }
+    std::string Str() const
+    {
+        return std::string(buffer, length);
+    }
+    bool operator==(std::string_view other) const
+    {
+        return View() == other;
+    }
+
+    private:
+    char buffer[MaxLength + 1];
+    std::size_t length = 0;
+    bool null = true;
+    bool tooLong = false;
+    bool utf8 = true;
+    bool ascii = true;
+};
+
+} // namespace VatEFS
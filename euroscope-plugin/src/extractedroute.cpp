@@ -0,0 +1,71 @@
+#include "extractedroute.h"
+
+#include <cmath>
+
+namespace VatEFS
+{
+
+ExtractedRouteCache::ExtractedRouteCache()
+{
+    Clear();
+}
+
+std::uint64_t ExtractedRouteCache::Hash(std::string_view text, std::uint64_t hash)
+{
+    for (char c : text)
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    // Separate the fields, so that "AB" + "C" differs from "A" + "BC"
+    return (hash ^ 0xff) * 1099511628211ull;
+}
+
+const ExtractedRouteCache::Route *ExtractedRouteCache::Find(const std::string &callsign,
+                                                            std::uint64_t sourceHash) const
+{
+    auto it = routes.find(callsign);
+    if (it == routes.end() || it->second.sourceHash != sourceHash) return nullptr;
+    return &it->second;
+}
+
+ExtractedRouteCache::Route &ExtractedRouteCache::Reset(const std::string &callsign,
+                                                       std::uint64_t sourceHash, unsigned int version)
+{
+    Route &route = routes[callsign];
+    route.sourceHash = sourceHash;
+    route.version = version;
+    route.points.clear();
+    return route;
+}
+
+void ExtractedRouteCache::Add(Route &route, std::string_view name, std::string_view airway,
+                              double latitude, double longitude, double distanceNm)
+{
+    route.points.push_back({ Intern(name), Intern(airway),
+                             static_cast<std::int32_t>(std::lround(latitude * COORDINATE_SCALE)),
+                             static_cast<std::int32_t>(std::lround(longitude * COORDINATE_SCALE)),
+                             static_cast<std::uint32_t>(std::lround(distanceNm * DISTANCE_SCALE)) });
+}
+
+void ExtractedRouteCache::Erase(const std::string &callsign)
+{
+    routes.erase(callsign);
+}
+
+void ExtractedRouteCache::Clear()
+{
+    routes.clear();
+    nameIds.clear();
+    names.assign(1, std::string()); // NO_NAME
+    nameIds.emplace(std::string(), NO_NAME);
+}
+
+std::uint32_t ExtractedRouteCache::Intern(std::string_view name)
+{
+    auto it = nameIds.find(std::string(name));
+    if (it != nameIds.end()) return it->second;
+    const auto id = static_cast<std::uint32_t>(names.size());
+    names.emplace_back(name);
+    nameIds.emplace(names.back(), id);
+    return id;
+}
+
+} // namespace VatEFS
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace VatEFS
+{
+
+// Extracted routes by callsign, in a compact form: point and airway names are interned so that
+// a name shared by many routes is stored once, positions are in 1e-5 degrees and distances in
+// 0.1 nm. A route is kept with a hash of the flight plan fields it was extracted from, so it is
+// only extracted again when those change.
+class ExtractedRouteCache
+{
+    public:
+    static constexpr std::uint32_t NO_NAME = 0; // the empty name, e.g. for a direct leg
+    static constexpr double COORDINATE_SCALE = 1e5;
+    static constexpr double DISTANCE_SCALE = 10;
+
+    struct Point {
+        std::uint32_t name;
+        std::uint32_t airway;
+        std::int32_t latitude;
+        std::int32_t longitude;
+        std::uint32_t distance; // along the route from the first point
+    };
+
+    struct Route {
+        std::uint64_t sourceHash = 0;
+        unsigned int version = 0; // TargetTable::flightPlanVersion when extracted
+        std::vector<Point> points;
+    };
+
+    ExtractedRouteCache();
+
+    // FNV-1a, chained over the fields a route is extracted from
+    static constexpr std::uint64_t HASH_SEED = 14695981039346656037ull;
+    static std::uint64_t Hash(std::string_view text, std::uint64_t hash = HASH_SEED);
+
+    // The callsign's route if it was extracted from fields with this hash, otherwise null
+    const Route *Find(const std::string &callsign, std::uint64_t sourceHash) const;
+    // Empties the callsign's route for filling with Add
+    Route &Reset(const std::string &callsign, std::uint64_t sourceHash, unsigned int version);
+    void Add(Route &route, std::string_view name, std::string_view airway, double latitude,
+             double longitude, double distanceNm);
+    void Erase(const std::string &callsign);
+    void Clear();
+
+    const std::string &Name(std::uint32_t id) const { return names[id]; }
+    std::size_t Count() const { return routes.size(); }
+    std::size_t NameCount() const { return names.size(); }
+
+    private:
+    std::uint32_t Intern(std::string_view name);
+
+    std::unordered_map<std::string, Route> routes;
+    std::unordered_map<std::string, std::uint32_t> nameIds;
+    std::vector<std::string> names; // by id
+};
+
+} // namespace VatEFS
@@ -0,0 +1,133 @@
+#include "flightplancache.h"
+
+namespace VatEFS
+{
+
+FlightPlanCache::FlightPlanCache(EuroScopePlugIn::CPlugIn *inPlugin) : plugin(inPlugin)
+{
+    esCalls = 0;
+    esCallsAvoided = 0;
+    tick = 1;
+}
+
+const FlightPlanView &FlightPlanCache::Get(const EuroScopePlugIn::CFlightPlan &flightPlan,
+                                           unsigned int sections)
+{
+    const char *callsign = flightPlan.GetCallsign();
+    esCalls++;
+    const std::string_view key = callsign ? callsign : "";
+    auto it = views.find(key);
+    if (it == views.end()) it = views.emplace(std::string(key), FlightPlanView()).first;
+    FlightPlanView &view = it->second;
+    if (view.tick != tick) {
+        view.loaded = 0;
+        view.tick = tick;
+    }
+    if (view.callsign.IsNull()) view.callsign.Assign(callsign);
+
+    if (sections & CORE) {
+        if (view.loaded & CORE)
+            esCallsAvoided += CORE_CALLS;
+        else
+            ReadCore(flightPlan, view);
+    }
+    if (sections & FP_DATA) {
+        if (view.loaded & FP_DATA)
+            esCallsAvoided += FP_DATA_CALLS;
+        else
+            ReadFlightPlanData(flightPlan, view);
+    }
+    if (sections & CTR_DATA) {
+        if (view.loaded & CTR_DATA)
+            esCallsAvoided += CTR_DATA_CALLS;
+        else
+            ReadControllerAssignedData(flightPlan, view);
+    }
+    return view;
+}
+
+void FlightPlanCache::Invalidate(const char *callsign, unsigned int sections)
+{
+    if (!callsign) return;
+    auto it = views.find(std::string_view(callsign));
+    if (it != views.end()) it->second.loaded &= ~sections;
+}
+
+void FlightPlanCache::Erase(const char *callsign)
+{
+    if (!callsign) return;
+    auto it = views.find(std::string_view(callsign));
+    if (it != views.end()) views.erase(it);
+}
+
+void FlightPlanCache::NextTick()
+{
+    tick++;
+}
+
+void FlightPlanCache::Clear()
+{
+    views.clear();
+}
+
+void FlightPlanCache::ReadCore(const EuroScopePlugIn::CFlightPlan &flightPlan, FlightPlanView &view)
+{
+    view.state = flightPlan.GetState();
+    view.fpState = flightPlan.GetFPState();
+    view.simulated = flightPlan.GetSimulated();
+    view.trackingController.Assign(flightPlan.GetTrackingControllerCallsign());
+    view.trackedByMe = flightPlan.GetTrackingControllerIsMe();
+    view.nextController.Assign(flightPlan.GetCoordinatedNextController());
+    view.nextControllerFrequency = 0.0;
+    if (!view.nextController.IsEmpty()) {
+        auto nextCon = plugin->ControllerSelect(view.nextController.CStr());
+        if (nextCon.IsValid()) view.nextControllerFrequency = nextCon.GetPrimaryFrequency();
+    }
+    view.handoffTargetController.Assign(flightPlan.GetHandoffTargetControllerCallsign());
+    view.groundState.Assign(flightPlan.GetGroundState());
+    view.clearance = flightPlan.GetClearenceFlag();
+    view.ete = flightPlan.GetPositionPredictions().GetPointsNumber();
+    view.loaded |= CORE;
+    esCalls += CORE_CALLS;
+}
+
+void FlightPlanCache::ReadFlightPlanData(const EuroScopePlugIn::CFlightPlan &flightPlan,
+                                         FlightPlanView &view)
+{
+    EuroScopePlugIn::CFlightPlanData fpData = flightPlan.GetFlightPlanData();
+    view.received = fpData.IsReceived();
+    view.aircraftType.Assign(fpData.GetAircraftFPType());
+    view.wakeTurbulence = fpData.GetAircraftWtc();
+    view.origin.Assign(fpData.GetOrigin());
+    view.destination.Assign(fpData.GetDestination());
+    view.alternate.Assign(fpData.GetAlternate());
+    view.flightRules.Assign(fpData.GetPlanType());
+    view.communicationType = fpData.GetCommunicationType();
+    view.route.Assign(fpData.GetRoute());
+    view.arrRwy.Assign(fpData.GetArrivalRwy());
+    view.star.Assign(fpData.GetStarName());
+    view.depRwy.Assign(fpData.GetDepartureRwy());
+    view.sid.Assign(fpData.GetSidName());
+    view.eobt.Assign(fpData.GetEstimatedDepartureTime());
+    view.loaded |= FP_DATA;
+    esCalls += FP_DATA_CALLS;
+}
+
+void FlightPlanCache::ReadControllerAssignedData(const EuroScopePlugIn::CFlightPlan &flightPlan,
+                                                 FlightPlanView &view)
+{
+    EuroScopePlugIn::CFlightPlanControllerAssignedData ctrData = flightPlan.GetControllerAssignedData();
+    view.squawk.Assign(ctrData.GetSquawk());
+    view.rfl = ctrData.GetFinalAltitude();
+    view.cfl = ctrData.GetClearedAltitude();
+    view.scratch.Assign(ctrData.GetScratchPadString());
+    view.asp = ctrData.GetAssignedSpeed();
+    view.mach = ctrData.GetAssignedMach();
+    view.arc = ctrData.GetAssignedRate();
+    view.ahdg = ctrData.GetAssignedHeading();
+    view.direct.Assign(ctrData.GetDirectToPointName());
+    view.loaded |= CTR_DATA;
+    esCalls += CTR_DATA_CALLS;
+}
+
+} // namespace VatEFS
@@ -0,0 +1,114 @@
+#pragma once
+
+#pragma warning(push, 0)
+#include "EuroScopePlugIn.h"
+#pragma warning(pop)
+
+#include "boundedstring.h"
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace VatEFS
+{
+
+// Values read from EuroScope for one flight plan. Strings are bounded to the longest value the
+// plugin forwards; anything longer is flagged as too long and not sent.
+struct FlightPlanView {
+    BoundedString<20> callsign;
+
+    // FlightPlanCache::CORE
+    int state = 0;
+    int fpState = 0;
+    bool simulated = false;
+    BoundedString<19> trackingController;
+    bool trackedByMe = false;
+    BoundedString<19> nextController;
+    double nextControllerFrequency = 0.0; // 0 if the next controller is not online
+    BoundedString<19> handoffTargetController;
+    BoundedString<31> groundState;
+    bool clearance = false;
+    int ete = -1; // number of position prediction points (minutes)
+
+    // FlightPlanCache::FP_DATA
+    bool received = false;
+    BoundedString<19> aircraftType;
+    char wakeTurbulence = 0;
+    BoundedString<9> origin;
+    BoundedString<9> destination;
+    BoundedString<9> alternate;
+    BoundedString<7> flightRules;
+    char communicationType = 0;
+    BoundedString<999> route;
+    BoundedString<4> arrRwy;
+    BoundedString<49> star;
+    BoundedString<4> depRwy;
+    BoundedString<49> sid;
+    BoundedString<4> eobt;
+
+    // FlightPlanCache::CTR_DATA
+    BoundedString<4> squawk;
+    int rfl = 0;
+    int cfl = 0;
+    BoundedString<50> scratch;
+    int asp = 0;
+    double mach = 0.0;
+    int arc = 0;
+    int ahdg = 0;
+    BoundedString<49> direct;
+
+    unsigned int loaded = 0;       // sections read in the current tick
+    unsigned long long tick = 0;   // tick the sections were read in
+};
+
+// Read-through cache of EuroScope accessor results, valid for one timer tick. The same flight
+// plan is typically read several times per tick (filter, data update, refresh, radar target
+// update), and each read is a number of calls across the DLL boundary. Sections are invalidated
+// by the corresponding EuroScope callbacks, and everything is re-read after the next tick.
+class FlightPlanCache
+{
+    public:
+    enum Section : unsigned int {
+        CORE = 1,
+        FP_DATA = 2,
+        CTR_DATA = 4,
+    };
+
+    // Number of EuroScope calls needed to read each section
+    static constexpr int CORE_CALLS = 14;
+    static constexpr int FP_DATA_CALLS = 15;
+    static constexpr int CTR_DATA_CALLS = 10;
+
+    explicit FlightPlanCache(EuroScopePlugIn::CPlugIn *inPlugin);
+
+    // Returns the view of the flight plan with (at least) the requested sections read
+    const FlightPlanView &Get(const EuroScopePlugIn::CFlightPlan &flightPlan, unsigned int sections);
+    void Invalidate(const char *callsign, unsigned int sections);
+    void Erase(const char *callsign);
+    void NextTick();
+    void Clear();
+
+    unsigned long long esCalls;        // EuroScope calls made to fill the cache
+    unsigned long long esCallsAvoided; // EuroScope calls served from the cache instead
+
+    private:
+    void ReadCore(const EuroScopePlugIn::CFlightPlan &flightPlan, FlightPlanView &view);
+    void ReadFlightPlanData(const EuroScopePlugIn::CFlightPlan &flightPlan, FlightPlanView &view);
+    void ReadControllerAssignedData(const EuroScopePlugIn::CFlightPlan &flightPlan, FlightPlanView &view);
+
+    // Transparent, so that lookups by callsign don't build a std::string
+    struct CallsignHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view callsign) const
+        {
+            return std::hash<std::string_view>()(callsign);
+        }
+    };
+
+    EuroScopePlugIn::CPlugIn *plugin;
+    std::unordered_map<std::string, FlightPlanView, CallsignHash, std::equal_to<>> views;
+    unsigned long long tick;
+};
+
+} // namespace VatEFS
@@ -0,0 +1,289 @@
+#include "geofence.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+
+namespace VatEFS
+{
+
+static constexpr double FEET_TO_METERS = 0.3048;
+static constexpr double METERS_PER_DEGREE_LATITUDE = 111320;
+static constexpr double PI = 3.14159265358979323846;
+
+static double MetersPerDegreeLongitude(double latitude)
+{
+    return METERS_PER_DEGREE_LATITUDE * std::cos(latitude * PI / 180);
+}
+
+// Parses "N059.39.07.320" or "E017.55.50.403" to decimal degrees
+static bool ParseDmsPart(const std::string &part, double &degrees)
+{
+    if (part.size() < 2) return false;
+    char direction = part[0];
+    std::vector<std::string> segments;
+    std::size_t start = 1;
+    for (std::size_t dot; (dot = part.find('.', start)) != std::string::npos; start = dot + 1)
+        segments.push_back(part.substr(start, dot - start));
+    segments.push_back(part.substr(start));
+    if (segments.size() < 3) return false;
+
+    double seconds = std::atof(segments[2].c_str());
+    if (segments.size() >= 4 && !segments[3].empty())
+        seconds += std::atof(segments[3].c_str()) / std::pow(10.0, (double)segments[3].size());
+    degrees = std::atof(segments[0].c_str()) + std::atof(segments[1].c_str()) / 60 + seconds / 3600;
+    if (direction == 'S' || direction == 'W') degrees = -degrees;
+    return true;
+}
+
+static bool ParseDmsCoordinate(const std::string &text, GeoPoint &point)
+{
+    std::size_t colon = text.find(':');
+    if (colon == std::string::npos) return false;
+    return ParseDmsPart(text.substr(0, colon), point.latitude) &&
+           ParseDmsPart(text.substr(colon + 1), point.longitude);
+}
+
+bool PointInPolygon(GeoPoint p, const std::vector<GeoPoint> &polygon)
+{
+    bool inside = false;
+    for (std::size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+        const GeoPoint &a = polygon[i], &b = polygon[j];
+        if ((a.latitude > p.latitude) != (b.latitude > p.latitude) &&
+            p.longitude < (b.longitude - a.longitude) * (p.latitude - a.latitude) /
+                          (b.latitude - a.latitude) + a.longitude)
+            inside = !inside;
+    }
+    return inside;
+}
+
+double DistanceMeters(GeoPoint a, GeoPoint b)
+{
+    double dx = (b.longitude - a.longitude) * MetersPerDegreeLongitude((a.latitude + b.latitude) / 2);
+    double dy = (b.latitude - a.latitude) * METERS_PER_DEGREE_LATITUDE;
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+double TrueBearing(GeoPoint from, GeoPoint to)
+{
+    double dx = (to.longitude - from.longitude) * MetersPerDegreeLongitude((from.latitude + to.latitude) / 2);
+    double dy = (to.latitude - from.latitude) * METERS_PER_DEGREE_LATITUDE;
+    double bearing = std::atan2(dx, dy) * 180 / PI;
+    return bearing < 0 ? bearing + 360 : bearing;
+}
+
+void GeofenceIndex::Clear()
+{
+    fences.clear();
+    airports.clear();
+    groundAltitude.clear();
+    grid.clear();
+    runwayCount = 0;
+}
+
+int GeofenceIndex::AirportIndex(const std::string &airport)
+{
+    auto it = std::find(airports.begin(), airports.end(), airport);
+    if (it != airports.end()) return static_cast<int>(it - airports.begin());
+    airports.push_back(airport);
+    groundAltitude.push_back(INT_MIN);
+    return static_cast<int>(airports.size()) - 1;
+}
+
+void GeofenceIndex::AddRunway(const std::string &airport, const std::string &name, GeoPoint end0, GeoPoint end1)
+{
+    // Rectangle corners in local meters relative to end0, as in runway-detection.ts
+    const double lonScale = MetersPerDegreeLongitude(end0.latitude);
+    const double dx = (end1.longitude - end0.longitude) * lonScale;
+    const double dy = (end1.latitude - end0.latitude) * METERS_PER_DEGREE_LATITUDE;
+    const double length = std::sqrt(dx * dx + dy * dy);
+    if (length == 0) return;
+    const double halfWidth = (RUNWAY_WIDTH_FT / 2 + RUNWAY_BUFFER_FT) * FEET_TO_METERS;
+    const double px = -dy / length * halfWidth, py = dx / length * halfWidth;
+
+    Fence fence;
+    fence.kind = RUNWAY;
+    fence.airport = AirportIndex(airport);
+    fence.name = name;
+    const double corners[4][2] = { { px, py }, { dx + px, dy + py }, { dx - px, dy - py }, { -px, -py } };
+    for (const auto &corner : corners) {
+        fence.points.push_back({ end0.latitude + corner[1] / METERS_PER_DEGREE_LATITUDE,
+                                 end0.longitude + corner[0] / lonScale });
+    }
+    fences.push_back(std::move(fence));
+    runwayCount++;
+    Index(static_cast<int>(fences.size()) - 1);
+}
+
+void GeofenceIndex::AddStand(const std::string &airport, const std::string &name, const std::vector<GeoPoint> &points)
+{
+    if (points.empty()) return;
+    Fence fence;
+    fence.kind = STAND;
+    fence.airport = AirportIndex(airport);
+    fence.name = name;
+    fence.points = points;
+    fences.push_back(std::move(fence));
+    Index(static_cast<int>(fences.size()) - 1);
+}
+
+int GeofenceIndex::LoadStands(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) return 0;
+
+    int count = 0;
+    std::string airport, name;
+    std::vector<GeoPoint> points;
+    auto finish = [&]() {
+        if (!airport.empty() && !points.empty()) {
+            AddStand(airport, name, points);
+            count++;
+        }
+        airport.clear();
+        points.clear();
+    };
+
+    std::string line;
+    while (std::getline(file, line)) {
+        line.erase(0, line.find_first_not_of(" \t"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (line.empty() || line.compare(0, 2, "//") == 0) continue;
+        if (line.compare(0, 6, "STAND:") == 0) {
+            finish();
+            std::size_t colon = line.find(':', 6);
+            if (colon == std::string::npos) continue;
+            airport = line.substr(6, colon - 6);
+            std::size_t end = line.find(':', colon + 1);
+            name = line.substr(colon + 1, end == std::string::npos ? std::string::npos : end - colon - 1);
+        } else if (line.compare(0, 6, "COORD:") == 0 && !airport.empty()) {
+            GeoPoint point;
+            if (ParseDmsCoordinate(line.substr(6), point)) points.push_back(point);
+        } else {
+            finish();
+        }
+    }
+    finish();
+    return count;
+}
+
+int GeofenceIndex::Cell(double degrees)
+{
+    return static_cast<int>(std::floor(degrees / CELL_DEGREES));
+}
+
+std::int64_t GeofenceIndex::CellKey(int latitudeCell, int longitudeCell)
+{
+    return (static_cast<std::int64_t>(latitudeCell) << 32) ^ static_cast<std::uint32_t>(longitudeCell);
+}
+
+void GeofenceIndex::Index(int index)
+{
+    Fence &fence = fences[index];
+    fence.minLatitude = fence.maxLatitude = fence.points[0].latitude;
+    fence.minLongitude = fence.maxLongitude = fence.points[0].longitude;
+    for (const GeoPoint &p : fence.points) {
+        fence.minLatitude = std::min(fence.minLatitude, p.latitude);
+        fence.maxLatitude = std::max(fence.maxLatitude, p.latitude);
+        fence.minLongitude = std::min(fence.minLongitude, p.longitude);
+        fence.maxLongitude = std::max(fence.maxLongitude, p.longitude);
+    }
+    if (fence.kind == STAND && fence.points.size() < 3) {
+        // Point stands match within a radius
+        const double latMargin = POINT_STAND_RADIUS_M / METERS_PER_DEGREE_LATITUDE;
+        const double lonMargin = POINT_STAND_RADIUS_M / MetersPerDegreeLongitude(fence.minLatitude);
+        fence.minLatitude -= latMargin;
+        fence.maxLatitude += latMargin;
+        fence.minLongitude -= lonMargin;
+        fence.maxLongitude += lonMargin;
+    }
+    for (int lat = Cell(fence.minLatitude); lat <= Cell(fence.maxLatitude); lat++) {
+        for (int lon = Cell(fence.minLongitude); lon <= Cell(fence.maxLongitude); lon++)
+            grid[CellKey(lat, lon)].push_back(index);
+    }
+}
+
+const std::vector<int> *GeofenceIndex::CellFences(GeoPoint position) const
+{
+    auto it = grid.find(CellKey(Cell(position.latitude), Cell(position.longitude)));
+    return it == grid.end() ? nullptr : &it->second;
+}
+
+int GeofenceIndex::FindRunway(GeoPoint position) const
+{
+    const std::vector<int> *candidates = CellFences(position);
+    if (!candidates) return NONE;
+    for (int index : *candidates) {
+        const Fence &fence = fences[index];
+        if (fence.kind != RUNWAY) continue;
+        if (position.latitude < fence.minLatitude || position.latitude > fence.maxLatitude ||
+            position.longitude < fence.minLongitude || position.longitude > fence.maxLongitude)
+            continue;
+        if (PointInPolygon(position, fence.points)) return index;
+    }
+    return NONE;
+}
+
+int GeofenceIndex::FindStand(GeoPoint position) const
+{
+    const std::vector<int> *candidates = CellFences(position);
+    if (!candidates) return NONE;
+    // Polygon stands first, then the nearest point stand within POINT_STAND_RADIUS_M
+    int nearest = NONE;
+    double nearestDistance = POINT_STAND_RADIUS_M;
+    for (int index : *candidates) {
+        const Fence &fence = fences[index];
+        if (fence.kind != STAND) continue;
+        if (position.latitude < fence.minLatitude || position.latitude > fence.maxLatitude ||
+            position.longitude < fence.minLongitude || position.longitude > fence.maxLongitude)
+            continue;
+        if (fence.points.size() >= 3) {
+            if (PointInPolygon(position, fence.points)) return index;
+            continue;
+        }
+        for (const GeoPoint &point : fence.points) {
+            double distance = DistanceMeters(position, point);
+            if (distance < nearestDistance) {
+                nearestDistance = distance;
+                nearest = index;
+            }
+        }
+    }
+    return nearest;
+}
+
+void GeofenceIndex::ObserveGround(int airport, int altitude)
+{
+    int &ground = groundAltitude[airport];
+    // Follow lower values at once and higher ones slowly, so one odd report doesn't stick
+    if (ground == INT_MIN || altitude < ground)
+        ground = altitude;
+    else
+        ground += (altitude - ground) / 16;
+}
+
+bool GeofenceIndex::IsOnSurface(int airport, int altitude) const
+{
+    int ground = groundAltitude[airport];
+    return ground != INT_MIN && altitude <= ground + ALTITUDE_THRESHOLD_FT;
+}
+
+int GeofenceIndex::GroundAltitude(GeoPoint position) const
+{
+    const std::vector<int> *candidates = CellFences(position);
+    if (!candidates) return INT_MIN;
+    for (int index : *candidates) {
+        int ground = groundAltitude[fences[index].airport];
+        if (ground != INT_MIN) return ground;
+    }
+    return INT_MIN;
+}
+
+bool GeofenceIndex::IsOnSurface(GeoPoint position, int altitude) const
+{
+    int ground = GroundAltitude(position);
+    return ground != INT_MIN && altitude <= ground + ALTITUDE_THRESHOLD_FT;
+}
+
+} // namespace VatEFS
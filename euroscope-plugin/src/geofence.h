@@ -0,0 +1,95 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace VatEFS
+{
+
+struct GeoPoint {
+    double latitude;
+    double longitude;
+};
+
+// Flat-earth approximations, good for the short distances around an airport
+double DistanceMeters(GeoPoint a, GeoPoint b);
+double TrueBearing(GeoPoint from, GeoPoint to);
+// Ray casting, as pointInPolygon() in stand-data.ts and ctr-data.ts
+bool PointInPolygon(GeoPoint p, const std::vector<GeoPoint> &polygon);
+
+// Runway and stand areas of the sector's airports, with a grid index so that each position only
+// needs testing against the few areas near it. Mirrors runway-detection.ts and stand-data.ts in
+// the backend: runways are rectangles between the sector file's runway ends, widened by a buffer
+// on each side, stands are polygons or points from GRpluginStands.txt.
+class GeofenceIndex
+{
+    public:
+    static constexpr int NONE = -1;
+    static constexpr double RUNWAY_WIDTH_FT = 150;   // the sector file has no runway widths
+    static constexpr double RUNWAY_BUFFER_FT = 200;  // added on each side
+    static constexpr int ALTITUDE_THRESHOLD_FT = 300; // above ground to still be on the surface
+    static constexpr double POINT_STAND_RADIUS_M = 100;
+
+    enum Kind : std::uint8_t { RUNWAY, STAND };
+
+    struct Fence {
+        Kind kind;
+        int airport; // index into airport names
+        std::string name; // "01/19" for runways
+        std::vector<GeoPoint> points; // polygon, or 1-2 points for point stands
+        double minLatitude, maxLatitude, minLongitude, maxLongitude;
+    };
+
+    void Clear();
+    void AddRunway(const std::string &airport, const std::string &name, GeoPoint end0, GeoPoint end1);
+    void AddStand(const std::string &airport, const std::string &name, const std::vector<GeoPoint> &points);
+    // Reads STAND:<airport>:<name> / COORD:<lat>:<lon> entries, returns the number of stands
+    int LoadStands(const std::string &path);
+
+    int FindRunway(GeoPoint position) const;
+    int FindStand(GeoPoint position) const;
+    // Learns the airport's ground level from aircraft known to be on the ground there. There is
+    // no field elevation in the sector file, and pressure altitudes move with QNH anyway.
+    void ObserveGround(int airport, int altitude);
+    // Learned ground level of an airport near the position, INT_MIN if none is known
+    int GroundAltitude(GeoPoint position) const;
+    // Near a known airport and within ALTITUDE_THRESHOLD_FT of its ground level
+    bool IsOnSurface(GeoPoint position, int altitude) const;
+    bool IsOnSurface(int airport, int altitude) const;
+
+    const Fence &Get(int fence) const
+    {
+        return fences[fence];
+    }
+    const std::string &AirportName(int airport) const
+    {
+        return airports[airport];
+    }
+    int RunwayCount() const
+    {
+        return runwayCount;
+    }
+    int StandCount() const
+    {
+        return static_cast<int>(fences.size()) - runwayCount;
+    }
+
+    private:
+    static constexpr double CELL_DEGREES = 0.01; // about 1 km north-south
+    static std::int64_t CellKey(int latitudeCell, int longitudeCell);
+    static int Cell(double degrees);
+    const std::vector<int> *CellFences(GeoPoint position) const;
+    int AirportIndex(const std::string &airport);
+    void Index(int fence);
+
+    std::vector<Fence> fences;
+    std::vector<std::string> airports;
+    std::vector<int> groundAltitude; // per airport, INT_MIN until learned
+    std::unordered_map<std::int64_t, std::vector<int>> grid; // fences overlapping each cell
+    int runwayCount = 0;
+};
+
+} // namespace VatEFS
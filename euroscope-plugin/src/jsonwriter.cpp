@@ -0,0 +1,227 @@
+#include "jsonwriter.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VATEFS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace VatEFS
+{
+
+// Length of the valid UTF-8 sequence starting at p (RFC 3629, no overlongs or surrogates, which is
+// what nlohmann::json accepts), or 0 if there is none
+static std::size_t Utf8SequenceLength(const unsigned char *p, const unsigned char *end)
+{
+    const unsigned char c = p[0];
+    std::size_t length;
+    unsigned char min = 0x80, max = 0xBF; // allowed range for the second byte
+    if (c >= 0xC2 && c <= 0xDF) {
+        length = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        length = 3;
+        if (c == 0xE0) min = 0xA0;
+        if (c == 0xED) max = 0x9F;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        length = 4;
+        if (c == 0xF0) min = 0x90;
+        if (c == 0xF4) max = 0x8F;
+    } else {
+        return 0;
+    }
+    if ((std::size_t)(end - p) < length) return 0;
+    if (p[1] < min || p[1] > max) return 0;
+    for (std::size_t i = 2; i < length; i++) {
+        if ((p[i] & 0xC0) != 0x80) return 0;
+    }
+    return length;
+}
+
+// Number of bytes from p that can be copied without escaping or validation
+static std::size_t PlainPrefixLength(const unsigned char *p, const unsigned char *end)
+{
+    const unsigned char *start = p;
+#ifdef VATEFS_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i space = _mm_set1_epi8(0x20);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        // Signed comparison: control characters and bytes >= 0x80 (negative) are both below ' '
+        __m128i special = _mm_or_si128(_mm_cmplt_epi8(chunk, space),
+                                       _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                                    _mm_cmpeq_epi8(chunk, backslash)));
+        int mask = _mm_movemask_epi8(special);
+        if (mask != 0) {
+            int index = 0;
+            while (!(mask & 1)) {
+                mask >>= 1;
+                index++;
+            }
+            return (std::size_t)(p - start) + index;
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && *p >= 0x20 && *p < 0x80 && *p != '"' && *p != '\\')
+        p++;
+    return (std::size_t)(p - start);
+}
+
+bool AppendJsonString(std::string &out, std::string_view value, bool replaceInvalid)
+{
+    static const char hex[] = "0123456789abcdef";
+    const std::size_t rollback = out.size();
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(value.data());
+    const unsigned char *end = p + value.size();
+
+    out.push_back('"');
+    while (p < end) {
+        std::size_t plain = PlainPrefixLength(p, end);
+        out.append(reinterpret_cast<const char *>(p), plain);
+        p += plain;
+        if (p == end) break;
+
+        const unsigned char c = *p;
+        if (c >= 0x80) {
+            std::size_t length = Utf8SequenceLength(p, end);
+            if (length > 0) {
+                out.append(reinterpret_cast<const char *>(p), length);
+                p += length;
+            } else if (replaceInvalid) {
+                out.push_back('?');
+                p++;
+            } else {
+                out.resize(rollback);
+                return false;
+            }
+            continue;
+        }
+        switch (c) {
+        case '"':
+            out.append("\\\"");
+            break;
+        case '\\':
+            out.append("\\\\");
+            break;
+        case '\b':
+            out.append("\\b");
+            break;
+        case '\f':
+            out.append("\\f");
+            break;
+        case '\n':
+            out.append("\\n");
+            break;
+        case '\r':
+            out.append("\\r");
+            break;
+        case '\t':
+            out.append("\\t");
+            break;
+        default: {
+            const char escaped[] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+            out.append(escaped, sizeof(escaped));
+            break;
+        }
+        }
+        p++;
+    }
+    out.push_back('"');
+    return true;
+}
+
+JsonWriter::JsonWriter(std::string &buffer) : out(buffer)
+{
+    first = true;
+    invalidKey = nullptr;
+    excluded = nullptr;
+}
+
+void JsonWriter::BeginObject()
+{
+    out.push_back('{');
+    first = true;
+}
+
+void JsonWriter::EndObject()
+{
+    out.push_back('}');
+}
+
+void JsonWriter::Exclude(const std::vector<std::string> &keys)
+{
+    excluded = keys.empty() ? nullptr : &keys;
+}
+
+bool JsonWriter::IsExcluded(const char *key) const
+{
+    return excluded &&
+           std::find(excluded->begin(), excluded->end(), std::string_view(key)) != excluded->end();
+}
+
+void JsonWriter::Key(const char *key)
+{
+    // Keys are literals in the plugin and never need escaping
+    if (!first) out.push_back(',');
+    first = false;
+    out.push_back('"');
+    out.append(key);
+    out.append("\":");
+}
+
+bool JsonWriter::String(const char *key, std::string_view value)
+{
+    if (IsExcluded(key)) return true;
+    const std::size_t rollback = out.size();
+    const bool wasFirst = first;
+    Key(key);
+    if (!AppendJsonString(out, value, false)) {
+        out.resize(rollback);
+        first = wasFirst;
+        invalidKey = key;
+        return false;
+    }
+    return true;
+}
+
+void JsonWriter::StringWithUtf8Replace(const char *key, std::string_view value)
+{
+    if (IsExcluded(key)) return;
+    Key(key);
+    AppendJsonString(out, value, true);
+}
+
+void JsonWriter::Int(const char *key, long long value)
+{
+    if (IsExcluded(key)) return;
+    Key(key);
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+void JsonWriter::Double(const char *key, double value)
+{
+    if (IsExcluded(key)) return;
+    Key(key);
+    if (!std::isfinite(value)) {
+        out.append("null"); // as nlohmann::json
+        return;
+    }
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value); // shortest round-trip
+    out.append(buffer, result.ptr);
+}
+
+void JsonWriter::Bool(const char *key, bool value)
+{
+    if (IsExcluded(key)) return;
+    Key(key);
+    out.append(value ? "true" : "false");
+}
+
+} // namespace VatEFS
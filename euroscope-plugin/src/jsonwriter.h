@@ -0,0 +1,60 @@
+#pragma once
+
+#include "boundedstring.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace VatEFS
+{
+
+// Appends a JSON string value (including the quotes) to out, validating UTF-8 and escaping in the
+// same pass. Runs of 16 bytes that need neither are copied as they are. On invalid UTF-8, out is
+// left unchanged and false is returned, unless replaceInvalid is set, in which case each offending
+// byte is written as '?' (like VatEFSPlugin::SanitizeUtf8).
+bool AppendJsonString(std::string &out, std::string_view value, bool replaceInvalid);
+
+// Writes a flat JSON object straight into a string. Used instead of building an nlohmann::json and
+// dumping it for the frequent messages, where dump() would validate and escape every string again.
+class JsonWriter
+{
+    public:
+    explicit JsonWriter(std::string &buffer);
+
+    void BeginObject();
+    void EndObject();
+    // Keys to leave out (the values are not encoded), kept by reference
+    void Exclude(const std::vector<std::string> &keys);
+
+    // Returns false (and writes nothing) if the value is not valid UTF-8
+    bool String(const char *key, std::string_view value);
+    // Skips null and too long values, like VatEFSPlugin::SetJsonIfValid
+    template <std::size_t N>
+    bool String(const char *key, const BoundedString<N> &value)
+    {
+        if (value.IsNull() || value.IsTooLong()) return false;
+        return String(key, value.View());
+    }
+    // Replaces invalid UTF-8 sequences with '?', like VatEFSPlugin::SetJsonWithUtf8Replace
+    void StringWithUtf8Replace(const char *key, std::string_view value);
+    void Int(const char *key, long long value);
+    void Double(const char *key, double value);
+    void Bool(const char *key, bool value);
+
+    // Key of the last string that was dropped as invalid UTF-8, if any
+    const char *InvalidKey() const
+    {
+        return invalidKey;
+    }
+
+    private:
+    void Key(const char *key);
+    bool IsExcluded(const char *key) const;
+
+    std::string &out;
+    bool first;
+    const char *invalidKey;
+    const std::vector<std::string> *excluded; // null if none
+};
+
+} // namespace VatEFS
@@ -0,0 +1,95 @@
+#include "movement.h"
+
+namespace VatEFS
+{
+
+// Ground speeds (kt) to start and stop being considered moving and rolling
+static constexpr int MOVING_START = 3;
+static constexpr int MOVING_STOP = 1;
+static constexpr int ROLLING_START = 40;
+static constexpr int ROLLING_STOP = 30;
+static constexpr int CLIMBING = 500; // ft/min, to tell airborne when the ground level is unknown
+
+const char *MovementStateName(MovementState state)
+{
+    switch (state) {
+    case MOVEMENT_PARKED:
+        return "PARKED";
+    case MOVEMENT_PUSHBACK:
+        return "PUSHBACK";
+    case MOVEMENT_TAXI:
+        return "TAXI";
+    case MOVEMENT_HOLDING:
+        return "HOLDING";
+    case MOVEMENT_LINEUP:
+        return "LINEUP";
+    case MOVEMENT_TAKEOFF_ROLL:
+        return "TAKEOFF";
+    case MOVEMENT_AIRBORNE:
+        return "AIRBORNE";
+    case MOVEMENT_LANDING_ROLL:
+        return "LANDING";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+MovementState InferMovementState(MovementState current, const MovementInput &input)
+{
+    const bool wasMoving = current != MOVEMENT_UNKNOWN && current != MOVEMENT_PARKED &&
+                           current != MOVEMENT_HOLDING;
+    const bool wasRolling = current == MOVEMENT_TAKEOFF_ROLL || current == MOVEMENT_LANDING_ROLL ||
+                            current == MOVEMENT_AIRBORNE;
+    const bool moving = wasMoving ? input.groundSpeed > MOVING_STOP : input.groundSpeed >= MOVING_START;
+    const bool rolling = wasRolling ? input.groundSpeed >= ROLLING_STOP : input.groundSpeed >= ROLLING_START;
+
+    SurfaceState surface = input.surface;
+    if (surface == SURFACE_UNKNOWN) {
+        // Nothing flies this slowly, and climbing out fast means airborne
+        if (!rolling)
+            surface = SURFACE_GROUND;
+        else if (current == MOVEMENT_AIRBORNE || input.verticalSpeed > CLIMBING)
+            surface = SURFACE_AIRBORNE;
+        else if (!input.onRunway)
+            return current;
+        else
+            surface = SURFACE_GROUND;
+    }
+    if (surface == SURFACE_AIRBORNE) return MOVEMENT_AIRBORNE;
+
+    if (input.onRunway && rolling) {
+        if (current == MOVEMENT_AIRBORNE || current == MOVEMENT_LANDING_ROLL) return MOVEMENT_LANDING_ROLL;
+        return MOVEMENT_TAKEOFF_ROLL;
+    }
+    if (!moving) {
+        if (input.onStand) return MOVEMENT_PARKED;
+        return input.onRunway ? MOVEMENT_LINEUP : MOVEMENT_HOLDING;
+    }
+    if (input.reversing &&
+        (input.onStand || current == MOVEMENT_PARKED || current == MOVEMENT_PUSHBACK))
+        return MOVEMENT_PUSHBACK;
+    if (input.onRunway) {
+        // Slowing down and vacating after landing, or entering the runway for departure
+        return current == MOVEMENT_LANDING_ROLL ? MOVEMENT_LANDING_ROLL : MOVEMENT_LINEUP;
+    }
+    return MOVEMENT_TAXI;
+}
+
+bool ConfirmMovementState(MovementState inferred, MovementState &state, MovementState &candidate,
+                          std::uint8_t &confirmations)
+{
+    if (inferred == state) {
+        confirmations = 0;
+        return false;
+    }
+    if (inferred != candidate) {
+        candidate = inferred;
+        confirmations = 0;
+    }
+    if (++confirmations < MOVEMENT_CONFIRMATIONS && state != MOVEMENT_UNKNOWN) return false;
+    state = inferred;
+    confirmations = 0;
+    return true;
+}
+
+} // namespace VatEFS
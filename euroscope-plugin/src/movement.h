@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+namespace VatEFS
+{
+
+// Ground movement phase of a target, inferred from its radar reports
+enum MovementState : std::uint8_t {
+    MOVEMENT_UNKNOWN,
+    MOVEMENT_PARKED,
+    MOVEMENT_PUSHBACK,
+    MOVEMENT_TAXI,
+    MOVEMENT_HOLDING,
+    MOVEMENT_LINEUP,
+    MOVEMENT_TAKEOFF_ROLL,
+    MOVEMENT_AIRBORNE,
+    MOVEMENT_LANDING_ROLL,
+};
+
+enum SurfaceState : std::uint8_t {
+    SURFACE_UNKNOWN, // no known ground level nearby
+    SURFACE_GROUND,
+    SURFACE_AIRBORNE,
+};
+
+struct MovementInput {
+    int groundSpeed;   // kt
+    int verticalSpeed; // ft/min
+    bool reversing;    // moving against the reported heading
+    SurfaceState surface;
+    bool onRunway;
+    bool onStand;
+};
+
+// Consecutive reports that must agree before the state changes
+constexpr int MOVEMENT_CONFIRMATIONS = 2;
+
+const char *MovementStateName(MovementState state);
+
+// The state the input points to, given the current (confirmed) state. Speed thresholds depend on
+// the current state, so that a target hovering around a threshold doesn't flip back and forth.
+MovementState InferMovementState(MovementState current, const MovementInput &input);
+
+// Takes the inferred state into state once it has been inferred MOVEMENT_CONFIRMATIONS times in a
+// row, or right away while the state is unknown. Returns true if the state changed.
+bool ConfirmMovementState(MovementState inferred, MovementState &state, MovementState &candidate,
+                          std::uint8_t &confirmations);
+
+} // namespace VatEFS
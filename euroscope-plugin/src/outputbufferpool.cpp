@@ -0,0 +1,70 @@
+#include "outputbufferpool.h"
+
+#include <utility>
+
+namespace VatEFS
+{
+
+PooledBuffer::PooledBuffer(OutputBufferPool *owner, int fromClass, std::string &&storage)
+: pool(owner), sizeClass(fromClass), buffer(std::move(storage))
+{
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer &&other) noexcept
+: pool(other.pool), sizeClass(other.sizeClass), buffer(std::move(other.buffer))
+{
+    other.pool = nullptr;
+}
+
+PooledBuffer::~PooledBuffer()
+{
+    if (pool) pool->Release(sizeClass, std::move(buffer));
+}
+
+OutputBufferPool::OutputBufferPool()
+{
+    // One buffer per class up front, that is all the synchronous send path needs
+    for (int i = 0; i < SIZE_CLASSES; i++) {
+        free[i].reserve(MAX_FREE);
+        free[i].emplace_back();
+        free[i].back().reserve(CLASS_CAPACITY[i]);
+    }
+}
+
+PooledBuffer OutputBufferPool::Acquire(SizeClass sizeClass)
+{
+    ClassStats &s = stats[sizeClass];
+    s.acquired++;
+    if (++s.inUse > s.highWater) s.highWater = s.inUse;
+
+    std::string buffer;
+    if (!free[sizeClass].empty()) {
+        buffer = std::move(free[sizeClass].back());
+        free[sizeClass].pop_back();
+    } else {
+        s.allocated++;
+        buffer.reserve(CLASS_CAPACITY[sizeClass]);
+    }
+    return PooledBuffer(this, sizeClass, std::move(buffer));
+}
+
+void OutputBufferPool::Release(int sizeClass, std::string &&buffer)
+{
+    ClassStats &s = stats[sizeClass];
+    if (s.inUse > 0) s.inUse--;
+    if (buffer.size() > s.largest) s.largest = buffer.size();
+    if (free[sizeClass].size() >= MAX_FREE) return;
+    buffer.clear(); // keeps the capacity
+    free[sizeClass].push_back(std::move(buffer));
+}
+
+void OutputBufferPool::ResetStats()
+{
+    for (auto &s : stats) {
+        std::size_t inUse = s.inUse;
+        s = ClassStats();
+        s.inUse = s.highWater = inUse;
+    }
+}
+
+} // namespace VatEFS
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace VatEFS
+{
+
+class OutputBufferPool;
+
+// A serialization buffer borrowed from an OutputBufferPool, returned to it when destroyed
+class PooledBuffer
+{
+    public:
+    PooledBuffer(OutputBufferPool *owner, int fromClass, std::string &&storage);
+    PooledBuffer(PooledBuffer &&other) noexcept;
+    PooledBuffer(const PooledBuffer &) = delete;
+    PooledBuffer &operator=(const PooledBuffer &) = delete;
+    ~PooledBuffer();
+
+    std::string &Str()
+    {
+        return buffer;
+    }
+
+    private:
+    OutputBufferPool *pool;
+    int sizeClass;
+    std::string buffer;
+};
+
+// Preallocated, size-classed strings that messages are serialized into and sent from, so that
+// the steady state doesn't allocate a new string (or two) per message. Buffers that outgrow their
+// class are kept in the class they were taken from, so capacity only ever grows.
+class OutputBufferPool
+{
+    public:
+    enum SizeClass {
+        SMALL,  // radar target, controller and controller assigned data updates
+        MEDIUM, // flight plan data updates
+        LARGE,  // anything with long routes or many entries
+        SIZE_CLASSES
+    };
+    static constexpr std::size_t CLASS_CAPACITY[SIZE_CLASSES] = { 512, 2048, 8192 };
+    // Free buffers kept per class; more than this are released to the heap
+    static constexpr std::size_t MAX_FREE = 8;
+
+    struct ClassStats {
+        unsigned long long acquired = 0;
+        unsigned long long allocated = 0; // acquisitions that had to allocate a new buffer
+        std::size_t inUse = 0;
+        std::size_t highWater = 0; // most buffers in use at the same time
+        std::size_t largest = 0;   // longest message serialized into this class
+    };
+
+    OutputBufferPool();
+
+    // Takes a cleared buffer with at least CLASS_CAPACITY[sizeClass] reserved
+    PooledBuffer Acquire(SizeClass sizeClass);
+    void ResetStats();
+
+    const ClassStats &Stats(SizeClass sizeClass) const
+    {
+        return stats[sizeClass];
+    }
+
+    private:
+    friend class PooledBuffer;
+    void Release(int sizeClass, std::string &&buffer);
+
+    std::vector<std::string> free[SIZE_CLASSES];
+    ClassStats stats[SIZE_CLASSES];
+};
+
+} // namespace VatEFS
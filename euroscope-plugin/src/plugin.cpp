@@ -1,8 +1,11 @@
 #include "plugin.h"
 #include "Version.h"
+#include "allocaccounting.h"
 
 #include "json.hpp"
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <ctime>
 #include <format>
 #include <fstream>
@@ -34,11 +37,45 @@ static std::string AnsiToUtf8(const char *ansi)
 namespace VatEFS
 {
 
+template <std::size_t N>
+void VatEFSPlugin::SetJsonIfValid(nlohmann::json &j, const char *key, const BoundedString<N> &value)
+{
+    if (value.IsNull() || value.IsTooLong()) return;
+    if (value.IsValidUtf8()) {
+        j[key] = value.View();
+    } else {
+        DebugMessage("SetJsonIfValid: Invalid UTF-8 string in key " + std::string(key));
+    }
+}
+
+template <std::size_t N>
+void VatEFSPlugin::SetJsonWithUtf8Replace(nlohmann::json &j, const char *key, const BoundedString<N> &value)
+{
+    if (value.IsNull()) return;
+    if (value.IsValidUtf8() && !value.IsTooLong())
+        j[key] = value.View();
+    else
+        j[key] = SanitizeUtf8(value.CStr());
+}
+
+// Writes a string in the ANSI code page (route, SID, STAR) converted to UTF-8
+template <std::size_t N>
+static void WriteFromAnsi(JsonWriter &writer, const char *key, const BoundedString<N> &value)
+{
+    if (value.IsNull() || value.IsTooLong()) return;
+    // Plain ASCII is the same in every code page - no need to go through the conversion
+    if (value.IsAscii())
+        writer.String(key, value.View());
+    else
+        writer.String(key, AnsiToUtf8(value.CStr()));
+}
+
 extern "C" IMAGE_DOS_HEADER __ImageBase;
 char DllPathFile[_MAX_PATH];
 
 VatEFSPlugin::VatEFSPlugin()
-: CPlugIn(EuroScopePlugIn::COMPATIBILITY_CODE, PLUGIN_NAME, PLUGIN_VERSION, PLUGIN_AUTHOR, PLUGIN_LICENSE)
+: CPlugIn(EuroScopePlugIn::COMPATIBILITY_CODE, PLUGIN_NAME, PLUGIN_VERSION, PLUGIN_AUTHOR, PLUGIN_LICENSE),
+  flightPlanCache(this)
 {
     disabled = true; // ... until connected - see OnTimer
     debug = false;
@@ -48,24 +85,68 @@ VatEFSPlugin::VatEFSPlugin()
     backendOutputRead = nullptr;
     backendLogFile = nullptr;
     backendAutoRestartUsed = false;
+    enabledTime = 0;
+    debouncedEmissions = 0;
+    metarsForwarded = 0;
+    metarsUnchanged = 0;
+    duplicateSquawks = 0;
+    groundPositionInterval = 0;
+    trackFilterEnabled = false;
+    horizonDeparture = 0;
+    horizonArrival = 0;
+    lazyDetail = false;
+    sendSocket = nullptr;
 
     GetModuleFileNameA(HINSTANCE(&__ImageBase), DllPathFile, sizeof(DllPathFile));
     std::string settingsPath = DllPathFile;
     settingsPath.resize(settingsPath.size() - strlen("VatEFS.dll"));
     settingsPath += "VatEFSPlugin.txt";
+    standsFile = settingsPath.substr(0, settingsPath.size() - strlen("VatEFSPlugin.txt")) + "GRpluginStands.txt";
     std::ifstream settingsFile(settingsPath);
     if (settingsFile.is_open()) {
         std::string line;
         while (std::getline(settingsFile, line)) {
-            if (line.empty()) continue;
-            for (auto &c : line)
+            // Hand-edited files may have trailing spaces or CRLF line endings
+            std::size_t end = line.find_last_not_of(" \r");
+            if (end == std::string::npos) continue;
+            line.resize(end + 1);
+            // <setting> [value], only the setting name is case insensitive
+            std::size_t space = line.find(' ');
+            std::string setting = line.substr(0, space);
+            std::size_t valueStart = space == std::string::npos ? std::string::npos : line.find_first_not_of(' ', space);
+            std::string value = valueStart == std::string::npos ? "" : line.substr(valueStart);
+            for (auto &c : setting)
                 c = (char)std::tolower(c);
-            if (line == "debug")
+            if (setting == "debug")
                 debug = true;
+            else if (setting == "stands" && !value.empty())
+                standsFile = value;
+            else if (setting == "groundpositioninterval" && !value.empty())
+                groundPositionInterval = std::max(0, std::atoi(value.c_str()));
+            else if (setting == "trackfilter")
+                trackFilterEnabled = true;
+            else if (setting == "horizondeparture" && !value.empty())
+                horizonDeparture = std::max(0, std::atoi(value.c_str()));
+            else if (setting == "horizonarrival" && !value.empty())
+                horizonArrival = std::max(0, std::atoi(value.c_str()));
+            else if (setting == "lazydetail")
+                lazyDetail = true;
+            else if (setting == "destination" && !value.empty()) {
+                if (!AddDestination(value)) DisplayMessage("Invalid destination: " + value);
+            }
+            else if (setting == "squawkrange" && !value.empty()) {
+                if (!AddSquawkRange(value)) DisplayMessage("Invalid squawk range: " + value);
+            }
             else
                 DisplayMessage("Unknown setting: " + line);
         }
     }
+    if (destinations.empty()) AddDestination("127.0.0.1:17771");
+
+    RegisterTagItemType("EFS stand", TAG_ITEM_EFS_STAND);
+    RegisterTagItemType("EFS cleared to land", TAG_ITEM_EFS_CLEARED_TO_LAND);
+    RegisterTagItemType("EFS bay", TAG_ITEM_EFS_BAY);
+    RegisterTagItemType("EFS section", TAG_ITEM_EFS_SECTION);
     DebugMessage("Version " + std::string(PLUGIN_VERSION));
 }
 
@@ -83,13 +164,26 @@ VatEFSPlugin::~VatEFSPlugin()
     }
     CleanupBackendHandles();
     CleanupUdpReceiveSocket();
+    CloseSendSocket();
     CleanupWinsock();
 }
 
 void VatEFSPlugin::OnFlightPlanFlightPlanDataUpdate(EuroScopePlugIn::CFlightPlan FlightPlan)
 {
+    AllocScope allocScope(ALLOC_FLIGHT_PLAN);
     try {
-        if (disabled || !FilterFlightPlan(FlightPlan)) return;
+        flightPlanCache.Invalidate(FlightPlan.GetCallsign(), FlightPlanCache::CORE | FlightPlanCache::FP_DATA);
+        flightPlanDetails.erase(FlightPlan.GetCallsign());
+        if (disabled) return;
+        const bool pass = FilterFlightPlan(FlightPlan);
+        int id = UpdateTarget(BoundedString<20>(FlightPlan.GetCallsign()));
+        if (id != TargetTable::NONE) {
+            targets.filterVerdict[id] = pass ? TargetTable::VERDICT_PASS : TargetTable::VERDICT_REJECT;
+            // The origin or destination may have changed
+            targets.subscribed[id] = TargetTable::VERDICT_UNKNOWN;
+            targets.flightPlanVersion[id]++;
+        }
+        if (!pass) return;
 
         std::string callsign = FlightPlan.GetCallsign();
         if (callsign.empty() || callsign.length() > 20) {
@@ -97,111 +191,228 @@ void VatEFSPlugin::OnFlightPlanFlightPlanDataUpdate(EuroScopePlugIn::CFlightPlan
             return;
         }
 
-        EuroScopePlugIn::CFlightPlanData fpData = FlightPlan.GetFlightPlanData();
-        if (!fpData.IsReceived()) {
+        // Debounced - sent from FlushPendingUpdates on the next timer tick
+        PendingUpdate &pending = pendingUpdates[callsign];
+        if (pending.flightPlanData) debouncedEmissions++;
+        pending.flightPlanData = true;
+    } catch (const std::exception &e) {
+        DisplayMessage(std::string("OnFlightPlanFlightPlanDataUpdate exception: ") + e.what());
+    } catch (...) {
+        DisplayMessage("OnFlightPlanFlightPlanDataUpdate: Unknown exception");
+    }
+}
+
+void VatEFSPlugin::PostFlightPlanData(EuroScopePlugIn::CFlightPlan FlightPlan)
+{
+    try {
+        if (disabled || !FilterFlightPlan(FlightPlan)) return;
+
+        const FlightPlanView &fp =
+        flightPlanCache.Get(FlightPlan, FlightPlanCache::CORE | FlightPlanCache::FP_DATA);
+        if (fp.callsign.IsEmpty() || fp.callsign.IsTooLong()) {
+            DisplayMessage("PostFlightPlanData: Invalid callsign");
+            return;
+        }
+
+        if (!fp.received) {
             DebugMessage("Invalid flight plan data");
             return;
         }
 
-        nlohmann::json message = nlohmann::json::object();
-        message["type"] = "flightPlanDataUpdate";
-        SetJsonIfValidUtf8(message, "callsign", callsign.c_str());
+        int id = targets.Find(fp.callsign.View());
+        if (id == TargetTable::NONE && (horizonDeparture > 0 || horizonArrival > 0))
+            id = UpdateTarget(fp.callsign); // to remember what was sent
+        if (id != TargetTable::NONE && targets.horizon[id] != TargetTable::HORIZON_FULL) {
+            if (IsBeyondHorizon(fp, id)) {
+                PostFlightPlanSummary(fp);
+                targets.horizon[id] = TargetTable::HORIZON_SUMMARY;
+                return;
+            }
+            targets.horizon[id] = TargetTable::HORIZON_FULL;
+        }
+        if (id != TargetTable::NONE) {
+            GeoPoint threshold;
+            targets.hasArrivalThreshold[id] =
+            arrivalThresholds.Find(fp.destination.View(), fp.arrRwy.View(), threshold);
+            if (targets.hasArrivalThreshold[id]) {
+                targets.thresholdLatitude[id] = threshold.latitude;
+                targets.thresholdLongitude[id] = threshold.longitude;
+            }
+        }
+        if (!subscription.Wants(Subscription::FLIGHT_PLAN_DATA)) return;
+
+        PooledBuffer buffer = outputBuffers.Acquire(OutputBufferPool::MEDIUM);
+        std::string &line = buffer.Str();
+        JsonWriter message(line);
+        message.Exclude(subscription.ExcludedFields());
+        message.BeginObject();
+        message.String("type", "flightPlanDataUpdate");
+        message.String("callsign", fp.callsign);
 
         std::stringstream out;
-        out << "FlightPlanDataUpdate " << callsign;
+        out << "FlightPlanDataUpdate " << fp.callsign.View();
 
         // Safe state checks
-        int state = FlightPlan.GetState();
-        int fpstate = FlightPlan.GetFPState();
-        if (state >= 0 && state <= 10 && fpstate >= 0 && fpstate <= 10) {
-            out << " state " << state << " fpstate " << fpstate;
-        }
-
-        if (FlightPlan.GetSimulated()) out << " simulated";
-
-        const char *trackingController = FlightPlan.GetTrackingControllerCallsign();
-        if (trackingController && strlen(trackingController) < 20) {
-            if (strlen(trackingController) > 0) out << " controller " << trackingController;
-            SetJsonIfValidUtf8(message, "controller", trackingController);
-        }
-        const char *nextController = FlightPlan.GetCoordinatedNextController();
-        if (nextController && strlen(nextController) < 20) {
-            if (strlen(nextController) > 0) out << " nextController " << nextController;
-            SetJsonIfValidUtf8(message, "nextController", nextController);
-            auto nextCon = ControllerSelect(nextController);
-            if (nextCon.IsValid())
-                message["nextControllerFrequency"] = nextCon.GetPrimaryFrequency();
-            else
-                message["nextControllerFrequency"] = 0;
-        }
-        const char *handoffTargetController = FlightPlan.GetHandoffTargetControllerCallsign();
-        if (handoffTargetController && strlen(handoffTargetController) < 20) {
-            if (strlen(handoffTargetController) > 0)
-                out << " handoffTargetController " << handoffTargetController;
-            SetJsonIfValidUtf8(message, "handoffTargetController", handoffTargetController);
+        if (fp.state >= 0 && fp.state <= 10 && fp.fpState >= 0 && fp.fpState <= 10) {
+            out << " state " << fp.state << " fpstate " << fp.fpState;
         }
 
-        const char *aircraftType = fpData.GetAircraftFPType();
-        if (aircraftType && strlen(aircraftType) > 0 && strlen(aircraftType) < 20) {
-            SetJsonIfValidUtf8(message, "aircraftType", aircraftType);
+        if (fp.simulated) out << " simulated";
+
+        if (!fp.trackingController.IsTooLong()) {
+            if (!fp.trackingController.IsEmpty()) out << " controller " << fp.trackingController.View();
+            message.String("controller", fp.trackingController);
+        }
+        if (!fp.nextController.IsTooLong()) {
+            if (!fp.nextController.IsEmpty()) out << " nextController " << fp.nextController.View();
+            message.String("nextController", fp.nextController);
+            message.Double("nextControllerFrequency", fp.nextControllerFrequency);
+        }
+        if (!fp.handoffTargetController.IsTooLong()) {
+            if (!fp.handoffTargetController.IsEmpty())
+                out << " handoffTargetController " << fp.handoffTargetController.View();
+            message.String("handoffTargetController", fp.handoffTargetController);
         }
-        SetJsonIfValidUtf8(message, "wakeTurbulence", (std::string("") + fpData.GetAircraftWtc()).c_str());
 
-        const char *origin = fpData.GetOrigin();
-        if (origin && strlen(origin) < 10) SetJsonIfValidUtf8(message, "origin", origin);
-        const char *destination = fpData.GetDestination();
-        if (destination && strlen(destination) < 10)
-            SetJsonIfValidUtf8(message, "destination", destination);
-        const char *alternate = fpData.GetAlternate();
-        if (alternate && strlen(alternate) < 10)
-            SetJsonIfValidUtf8(message, "alternate", alternate);
-        SetJsonIfValidUtf8(message, "flightRules", fpData.GetPlanType());
-        SetJsonIfValidUtf8(message, "communicationType",
-                           (std::string("") + fpData.GetCommunicationType()).c_str());
-        // TODO check this is set correctly, compare controllerAssignedDataUpdate, ensure it doesn't overwrite the custom groundstates
-        SetJsonIfValidUtf8(message, "groundstate", FlightPlan.GetGroundState());
-        message["clearance"] = (bool)FlightPlan.GetClearenceFlag();
+        if (!fp.aircraftType.IsEmpty()) message.String("aircraftType", fp.aircraftType);
+        const char wakeTurbulence[2] = { fp.wakeTurbulence, '\0' };
+        message.String("wakeTurbulence", BoundedString<1>(wakeTurbulence));
 
-        const char *route = fpData.GetRoute();
-        if (route && *route && strlen(route) < 1000)
-            message["route"] = AnsiToUtf8(route);
+        message.String("origin", fp.origin);
+        message.String("destination", fp.destination);
+        message.String("alternate", fp.alternate);
+        message.String("flightRules", fp.flightRules);
+        const char communicationType[2] = { fp.communicationType, '\0' };
+        message.String("communicationType", BoundedString<1>(communicationType));
+        // TODO check this is set correctly, compare controllerAssignedDataUpdate, ensure it doesn't overwrite the custom groundstates
+        message.String("groundstate", fp.groundState);
+        message.Bool("clearance", fp.clearance);
 
-        const char *arrRwy = fpData.GetArrivalRwy();
-        const char *starName = fpData.GetStarName();
-        const char *depRwy = fpData.GetDepartureRwy();
-        const char *sidName = fpData.GetSidName();
+        if (!fp.route.IsEmpty()) {
+            if (!lazyDetail) {
+                WriteFromAnsi(message, "route", fp.route);
+            } else {
+                // The rest is fetched with getFlightPlanDetail, the first term may be a special SID
+                const std::string_view route = fp.route.View();
+                const std::size_t start = route.find_first_not_of(' ');
+                if (start != std::string_view::npos) {
+                    const std::string head(route.substr(start, route.find(' ', start) - start));
+                    if (fp.route.IsAscii())
+                        message.String("routeHead", head);
+                    else
+                        message.String("routeHead", AnsiToUtf8(head.c_str()));
+                }
+            }
+        }
 
-        if (arrRwy && *arrRwy && strlen(arrRwy) < 5) SetJsonIfValidUtf8(message, "arrRwy", arrRwy);
-        if (starName && *starName && strlen(starName) < 50)
-            message["star"] = AnsiToUtf8(starName);
-        if (depRwy && *depRwy && strlen(depRwy) < 5) SetJsonIfValidUtf8(message, "depRwy", depRwy);
-        if (sidName && *sidName && strlen(sidName) < 50)
-            message["sid"] = AnsiToUtf8(sidName);
+        if (!fp.arrRwy.IsEmpty()) message.String("arrRwy", fp.arrRwy);
+        if (!fp.star.IsEmpty()) WriteFromAnsi(message, "star", fp.star);
+        if (!fp.depRwy.IsEmpty()) message.String("depRwy", fp.depRwy);
+        if (!fp.sid.IsEmpty()) WriteFromAnsi(message, "sid", fp.sid);
 
-        const char *eobt = fpData.GetEstimatedDepartureTime();
-        if (eobt && strlen(eobt) == 4) { // Valid EOBT is always 4 digits
-            out << " eobt " << eobt;
-            message["eobt"] = eobt;
+        if (fp.eobt.Length() == 4 && !fp.eobt.IsTooLong()) { // Valid EOBT is always 4 digits
+            out << " eobt " << fp.eobt.View();
+            message.String("eobt", fp.eobt);
         }
 
-        int ete = FlightPlan.GetPositionPredictions().GetPointsNumber();
-        if (ete >= 0 && ete <= 3600) { // Reasonable ETE range
-            out << " ete " << ete;
-            message["ete"] = ete;
+        if (fp.ete >= 0 && fp.ete <= 3600) { // Reasonable ETE range
+            out << " ete " << fp.ete;
+            message.Int("ete", fp.ete);
         }
+        message.EndObject();
+        if (message.InvalidKey()) DebugMessage("PostFlightPlanData: Invalid UTF-8 string in key " + std::string(message.InvalidKey()));
 
         DebugMessage(out.str());
-        PostJson(message, "OnFlightPlanFlightPlanDataUpdate");
+        PostLine(line, "PostFlightPlanData");
+        if (!lazyDetail && subscription.Wants(Subscription::EXTRACTED_ROUTE)) {
+            bool extracted = false;
+            const ExtractedRouteCache::Route &route = ExtractRoute(FlightPlan, fp, extracted);
+            if (extracted) {
+                nlohmann::json routeMessage = ExtractedRouteToJson(route);
+                routeMessage["type"] = "extractedRoute";
+                routeMessage["callsign"] = fp.callsign.Str();
+                PostJson(routeMessage, "PostFlightPlanData");
+            }
+        }
+        if (id != TargetTable::NONE)
+            targets.sentFlightPlanVersion[id] = targets.flightPlanVersion[id];
     } catch (const std::exception &e) {
-        DisplayMessage(std::string("OnFlightPlanFlightPlanDataUpdate exception: ") + e.what());
+        DisplayMessage(std::string("PostFlightPlanData exception: ") + e.what());
     } catch (...) {
-        DisplayMessage("OnFlightPlanFlightPlanDataUpdate: Unknown exception");
+        DisplayMessage("PostFlightPlanData: Unknown exception");
+    }
+}
+
+bool VatEFSPlugin::IsBeyondHorizon(const FlightPlanView &fp, int id) const
+{
+    // Departures with an EOBT further ahead than horizonDeparture minutes, unless already moving
+    if (horizonDeparture > 0 && fp.eobt.Length() == 4 && !fp.eobt.IsTooLong() &&
+        (!targets.hasPosition[id] || targets.filteredGroundSpeed[id] < 50)) {
+        const std::string_view eobt = fp.eobt.View();
+        if (std::all_of(eobt.begin(), eobt.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            const std::time_t now = std::time(NULL);
+            std::tm utc;
+            gmtime_s(&utc, &now);
+            const int eobtMinutes =
+            ((eobt[0] - '0') * 10 + (eobt[1] - '0')) * 60 + (eobt[2] - '0') * 10 + (eobt[3] - '0');
+            // Within 12 hours either way, across midnight
+            int minutes = (eobtMinutes - (utc.tm_hour * 60 + utc.tm_min) + 24 * 60) % (24 * 60);
+            if (minutes >= 12 * 60) minutes -= 24 * 60;
+            if (minutes > horizonDeparture) return true;
+        }
+    }
+    // Arrivals from outside the FIR with more than horizonArrival minutes to go
+    return horizonArrival > 0 && fp.ete > horizonArrival && !fp.origin.View().starts_with("ES");
+}
+
+void VatEFSPlugin::PostFlightPlanSummary(const FlightPlanView &fp)
+{
+    if (!subscription.Wants(Subscription::FLIGHT_PLAN_DATA)) return;
+    PooledBuffer buffer = outputBuffers.Acquire(OutputBufferPool::SMALL);
+    JsonWriter message(buffer.Str());
+    message.BeginObject();
+    message.String("type", "flightPlanSummary");
+    message.String("callsign", fp.callsign);
+    if (!fp.aircraftType.IsEmpty()) message.String("aircraftType", fp.aircraftType);
+    message.String("origin", fp.origin);
+    message.String("destination", fp.destination);
+    message.String("flightRules", fp.flightRules);
+    if (fp.eobt.Length() == 4 && !fp.eobt.IsTooLong()) message.String("eobt", fp.eobt);
+    if (fp.ete >= 0 && fp.ete <= 3600) message.Int("ete", fp.ete);
+    message.EndObject();
+    PostLine(buffer.Str(), "PostFlightPlanSummary");
+}
+
+void VatEFSPlugin::SweepHorizon()
+{
+    // Plans that only got a summary get the full record once they are within the window
+    for (int id = 0; id < targets.Size(); id++) {
+        if (targets.horizon[id] != TargetTable::HORIZON_SUMMARY) continue;
+        EuroScopePlugIn::CFlightPlan FlightPlan = FlightPlanSelect(targets.callsign[id].CStr());
+        if (!FlightPlan.IsValid() || !FilterFlightPlan(FlightPlan)) continue;
+        const FlightPlanView &fp =
+        flightPlanCache.Get(FlightPlan, FlightPlanCache::CORE | FlightPlanCache::FP_DATA);
+        if (!IsBeyondHorizon(fp, id)) PostFlightPlanData(FlightPlan);
     }
 }
 
 void VatEFSPlugin::OnFlightPlanControllerAssignedDataUpdate(EuroScopePlugIn::CFlightPlan FlightPlan, int DataType)
 {
+    AllocScope allocScope(ALLOC_FLIGHT_PLAN);
     try {
+        flightPlanCache.Invalidate(FlightPlan.GetCallsign(), FlightPlanCache::CORE | FlightPlanCache::CTR_DATA);
+        if (!disabled && DataType == EuroScopePlugIn::CTR_DATA_TYPE_SQUAWK) {
+            // Whether filtered or not, so that allocation doesn't hand out the code again
+            const int id = targets.Find(FlightPlan.GetCallsign());
+            if (id != TargetTable::NONE) {
+                // Read through the cache, its controller assigned data was invalidated above
+                const FlightPlanView &assigned =
+                flightPlanCache.Get(FlightPlan, FlightPlanCache::CORE | FlightPlanCache::CTR_DATA);
+                UpdateAssignedSquawk(id, assigned.squawk.IsTooLong()
+                                         ? SquawkPool::NO_CODE
+                                         : SquawkPool::Parse(assigned.squawk.View()));
+            }
+        }
         if (disabled || !FilterFlightPlan(FlightPlan)) return;
 
 
@@ -216,193 +427,281 @@ void VatEFSPlugin::OnFlightPlanControllerAssignedDataUpdate(EuroScopePlugIn::CFl
             return;
         }
 
-        std::stringstream out;
-        out << "ControllerAssignedDataUpdate " << callsign;
+        // Values are read right away, scratch pad strings in particular are transient (set and
+        // reset again within the same tick by UpdateScratchPad and TopSky)
+        nlohmann::json fields = nlohmann::json::object();
+        if (!CollectControllerAssignedData(FlightPlan, DataType, fields)) return;
+
+        // Gathered into one record per callsign - sent from FlushPendingUpdates on the next tick
+        PendingUpdate &pending = pendingUpdates[callsign];
+        const bool scratch = DataType == EuroScopePlugIn::CTR_DATA_TYPE_SCRATCH_PAD_STRING;
+        if (!pending.controllerData.is_null()) {
+            // Later values simply overwrite earlier ones (so CFL 1/2 followed by a heading ends up
+            // with the heading, as with separate messages), except that a scratch pad event must
+            // not overwrite or be overwritten within a record since the backend acts on each one
+            bool conflict = false;
+            for (const auto &[key, value] : fields.items()) {
+                if (scratch ? pending.controllerData.contains(key) : key == pending.scratchKey)
+                    conflict = true;
+            }
+            if (conflict || (scratch && !pending.scratchKey.empty()))
+                PostPendingControllerData(callsign, pending);
+        }
+        if (pending.controllerData.is_null())
+            pending.controllerData = nlohmann::json::object();
+        else
+            debouncedEmissions++;
+        pending.controllerData.update(fields);
+        if (scratch && !fields.empty()) pending.scratchKey = fields.begin().key();
+    } catch (const std::exception &e) {
+        DisplayMessage(std::string("OnFlightPlanControllerAssignedDataUpdate exception: ") + e.what());
+    } catch (...) {
+        DisplayMessage("OnFlightPlanControllerAssignedDataUpdate: Unknown exception");
+    }
+}
 
-        nlohmann::json message = nlohmann::json::object();
-        message["type"] = "controllerAssignedDataUpdate";
-        SetJsonIfValidUtf8(message, "callsign", callsign.c_str());
+bool VatEFSPlugin::CollectControllerAssignedData(EuroScopePlugIn::CFlightPlan FlightPlan,
+                                                 int DataType,
+                                                 nlohmann::json &fields)
+{
+    std::stringstream out;
+    out << "ControllerAssignedDataUpdate " << FlightPlan.GetCallsign();
 
-        const char *controllerCallsign = FlightPlan.GetTrackingControllerCallsign();
-        if (controllerCallsign && strlen(controllerCallsign) > 0 && strlen(controllerCallsign) < 20) {
-            SetJsonIfValidUtf8(message, "controller", controllerCallsign);
-            out << " controller " << controllerCallsign;
+    const EuroScopePlugIn::CFlightPlanControllerAssignedData ctrData =
+    FlightPlan.GetControllerAssignedData();
+
+    switch (DataType) {
+    case EuroScopePlugIn::CTR_DATA_TYPE_SQUAWK: {
+        BoundedString<4> squawk(ctrData.GetSquawk());
+        if (squawk.Length() == 4 && !squawk.IsTooLong()) { // Valid squawk is always 4 digits
+            out << " squawk " << squawk.View();
+            SetJsonIfValid(fields, "squawk", squawk);
+        }
+        break;
+    }
+    case EuroScopePlugIn::CTR_DATA_TYPE_FINAL_ALTITUDE: {
+        int rfl = ctrData.GetFinalAltitude();
+        if (rfl >= 0 && rfl <= 100000) { // Reasonable altitude range
+            out << " rfl " << rfl;
+            fields["rfl"] = rfl;
+        }
+        break;
+    }
+    case EuroScopePlugIn::CTR_DATA_TYPE_TEMPORARY_ALTITUDE: {
+        int cfl = ctrData.GetClearedAltitude();
+        out << " cfl " << cfl;
+        fields["cfl"] = cfl;
+        // 0 - no cleared level (use the final instead of)
+        // 1 - cleared for ILS approach
+        // 2 - cleared for visual approach
+        if (cfl == 1 || cfl == 2) {
+            fields["ahdg"] = 0;
+            fields["direct"] = "";
+        }
+        break;
+    }
+    case EuroScopePlugIn::CTR_DATA_TYPE_COMMUNICATION_TYPE:
+        out << " comm " << ctrData.GetCommunicationType();
+        break;
+    case EuroScopePlugIn::CTR_DATA_TYPE_SCRATCH_PAD_STRING: {
+        BoundedString<50> scratch(ctrData.GetScratchPadString());
+        if (scratch.IsNull()) return false;
+
+        // Limit scratch pad string length
+        if (scratch.IsTooLong()) {
+            DebugMessage("Scratch pad string too long: " + scratch.Str() + "...");
+            return false;
         }
 
-        const EuroScopePlugIn::CFlightPlanControllerAssignedData ctrData =
-        FlightPlan.GetControllerAssignedData();
+        out << " scratch " << scratch.View();
 
-        switch (DataType) {
-        case EuroScopePlugIn::CTR_DATA_TYPE_SQUAWK: {
-            const char *squawk = ctrData.GetSquawk();
-            if (squawk && strlen(squawk) == 4) { // Valid squawk is always 4 digits
-                out << " squawk " << squawk;
-                SetJsonIfValidUtf8(message, "squawk", squawk);
-            }
+        // Only valid UTF-8 is decoded, the fields below are views into it
+        const ScratchPadEvent event =
+        scratch.IsValidUtf8() ? DecodeScratchPad(scratch.View()) : ScratchPadEvent();
+        switch (event.kind) {
+        case ScratchPadEvent::NOISE:
+            DebugMessage("Ignored TopSky scratch pad " + scratch.Str());
+            return false;
+        case ScratchPadEvent::GROUND_STATE:
+            SetJsonIfValid(fields, "groundstate", scratch);
             break;
-        }
-        case EuroScopePlugIn::CTR_DATA_TYPE_FINAL_ALTITUDE: {
-            int rfl = ctrData.GetFinalAltitude();
-            if (rfl >= 0 && rfl <= 100000) { // Reasonable altitude range
-                out << " rfl " << rfl;
-                message["rfl"] = rfl;
-            }
+        case ScratchPadEvent::CLEARED_TO_LAND:
+            fields["clearedToLand"] = event.value != 0;
             break;
-        }
-        case EuroScopePlugIn::CTR_DATA_TYPE_TEMPORARY_ALTITUDE: {
-            int cfl = ctrData.GetClearedAltitude();
-            out << " cfl " << cfl;
-            message["cfl"] = cfl;
-            // 0 - no cleared level (use the final instead of)
-            // 1 - cleared for ILS approach
-            // 2 - cleared for visual approach
-            if (cfl == 1 || cfl == 2) {
-                message["ahdg"] = 0;
-                message["direct"] = "";
-            }
+        case ScratchPadEvent::STAND:
+            if (event.argument.empty())
+                SetJsonIfValid(fields, "scratch", scratch);
+            else
+                fields["stand"] = event.argument;
+            break;
+        case ScratchPadEvent::HOLD: {
+            // The fix, empty when the hold is cancelled (/HOLD//0) or left (/XHOLD/<fix>/)
+            const auto hold = SplitScratchPadFields(event.argument);
+            fields["hold"] = event.value != 0 && !hold.empty() ? hold[0] : std::string_view();
             break;
         }
-        case EuroScopePlugIn::CTR_DATA_TYPE_COMMUNICATION_TYPE:
-            out << " comm " << ctrData.GetCommunicationType();
+        case ScratchPadEvent::COORDINATION:
+            fields["coordination"] = { { "code", event.code },
+                                       { "fields", SplitScratchPadFields(event.argument) } };
             break;
-        case EuroScopePlugIn::CTR_DATA_TYPE_SCRATCH_PAD_STRING: {
-            const char *scratchStr = ctrData.GetScratchPadString();
-            if (!scratchStr) return;
-
-            // Limit scratch pad string length
-            if (strlen(scratchStr) > 50) {
-                DebugMessage("Scratch pad string too long: " + std::string(scratchStr));
-                return;
-            }
-
-            std::string scratch = scratchStr;
-            out << " scratch " << scratch;
-
-            // Safe string comparisons
-            if (scratch == "LINEUP" || scratch == "ONFREQ" || scratch == "DE-ICE") {
-                SetJsonIfValidUtf8(message, "groundstate", scratch.c_str());
-            } else if (scratch == "/EFS/CTL") {
-                message["clearedToLand"] = true;
-            } else if (scratch == "/EFS/CTL-") {
-                message["clearedToLand"] = false;
-            } else if (scratch.length() > 6 && scratch.find("GRP/S/") != std::string::npos) {
-                // Ensure we have enough characters for substr(6)
-                SetJsonIfValidUtf8(message, "stand", scratch.substr(6).c_str());
-            } else {
-                SetJsonIfValidUtf8(message, "scratch", scratch.c_str());
-            }
-            // Scratch pad inputs noticed in the wild (if we ever want to
-            // reverse-engineer/understand some TopSky plugin features): /PRESHDG/ /ASP=/ /ASP+/
-            // /ASP-/ /ES /C_FLAG_ACK/ /C_FLAG_RESET/ MISAP_ /ROF/SAS525/ESMM_5_CTR
-            // /LAM/ROF/ESMM_5_CTR
-            // /ROF/RYR6Q/EKCH_F_APP
-            // /COB
-            // /PLU
-            // /TIT
-            // /OPTEXT2_REQ/ESMM_7_CTR/LHA3218/NC M7
-            // /SBY/RTI/EDDB_S_APP/S290+
-            // /ACP/RTI/EDDB_S_APP
-            // SAS88J controller ESMM_2_CTR scratch /RTI/DLH6RA/ESMM_2_CTR/S074-
-            // DLH6RA controller EKDK_CTR scratch /SBY/RTI/ESMM_2_CTR/S074-
-            // DLH6RA controller EKDK_CTR scratch /ACP/RTI/ESMM_2_CTR
-            // DLH6RA controller EKDK_CTR mach 74
-            // DLH6RA controller EKDK_CTR scratch /ASP-/
-            // /OPTEXT2_REQ/ESSA_M_APP/NRD1121/"NORTH RIDER"
-            // /FTEXT/L0
-            // /HOLD/ERNOV/
-            // /XHOLD/ERNOV/
-            // /HOLD//0
-            // /ARC+/
-            // /ACK_STAR/RISMA3S
-            // /OPTEXT/TEST
-            // /OPTEXT/
-            // /CAT2/
-            // /CAT3/
-            // ON_CONTACT+
-            // ON_CONTACT-
+        case ScratchPadEvent::OPERATOR_TEXT:
+            fields["operatorText"] = event.argument;
+            break;
+        case ScratchPadEvent::OPERATOR_TEXT_REQUEST: {
+            const auto request = SplitScratchPadFields(event.argument, 3);
+            nlohmann::json &value = fields["operatorTextRequest"] = nlohmann::json::object();
+            if (request.size() > 0) value["controller"] = request[0];
+            if (request.size() > 1) value["callsign"] = request[1];
+            if (request.size() > 2) value["text"] = request[2];
             break;
         }
-        case EuroScopePlugIn::CTR_DATA_TYPE_GROUND_STATE:
-            out << " groundstate " << FlightPlan.GetGroundState();
-            SetJsonIfValidUtf8(message, "groundstate", FlightPlan.GetGroundState());
+        case ScratchPadEvent::APPROACH_CATEGORY:
+            fields["approachCategory"] = event.value;
             break;
-        case EuroScopePlugIn::CTR_DATA_TYPE_CLEARENCE_FLAG:
-            out << " clearance " << FlightPlan.GetClearenceFlag();
-            message["clearance"] = (bool)FlightPlan.GetClearenceFlag();
+        case ScratchPadEvent::ON_CONTACT:
+            fields["onContact"] = event.value != 0;
             break;
-        case EuroScopePlugIn::CTR_DATA_TYPE_DEPARTURE_SEQUENCE:
-            out << " dsq"; // TODO where dis dsq?
+        case ScratchPadEvent::STAR_ACKNOWLEDGED:
+            fields["starAcknowledged"] = event.argument;
             break;
-        case EuroScopePlugIn::CTR_DATA_TYPE_SPEED: {
-            int speed = ctrData.GetAssignedSpeed();
-            if (speed >= 0 && speed <= 1500) { // Reasonable speed range
-                out << " asp " << speed;
-                message["asp"] = speed;
-            }
+        default:
+            SetJsonIfValid(fields, "scratch", scratch);
             break;
         }
-        case EuroScopePlugIn::CTR_DATA_TYPE_MACH: {
-            double mach = ctrData.GetAssignedMach();
-            if (mach >= 0.0 && mach <= 10.0) { // Reasonable mach range
-                out << " mach " << mach;
-                message["mach"] = mach;
-            }
-            break;
+        break;
+    }
+    case EuroScopePlugIn::CTR_DATA_TYPE_GROUND_STATE: {
+        BoundedString<31> groundState(FlightPlan.GetGroundState());
+        out << " groundstate " << groundState.View();
+        SetJsonIfValid(fields, "groundstate", groundState);
+        break;
+    }
+    case EuroScopePlugIn::CTR_DATA_TYPE_CLEARENCE_FLAG:
+        out << " clearance " << FlightPlan.GetClearenceFlag();
+        fields["clearance"] = (bool)FlightPlan.GetClearenceFlag();
+        break;
+    case EuroScopePlugIn::CTR_DATA_TYPE_DEPARTURE_SEQUENCE:
+        out << " dsq"; // TODO where dis dsq?
+        break;
+    case EuroScopePlugIn::CTR_DATA_TYPE_SPEED: {
+        int speed = ctrData.GetAssignedSpeed();
+        if (speed >= 0 && speed <= 1500) { // Reasonable speed range
+            out << " asp " << speed;
+            fields["asp"] = speed;
         }
-        case EuroScopePlugIn::CTR_DATA_TYPE_RATE: {
-            int rate = ctrData.GetAssignedRate();
-            if (rate >= -50000 && rate <= 50000) { // Reasonable rate range
-                out << " arc " << rate;
-                message["arc"] = rate;
-            }
-            break;
+        break;
+    }
+    case EuroScopePlugIn::CTR_DATA_TYPE_MACH: {
+        double mach = ctrData.GetAssignedMach();
+        if (mach >= 0.0 && mach <= 10.0) { // Reasonable mach range
+            out << " mach " << mach;
+            fields["mach"] = mach;
         }
-        case EuroScopePlugIn::CTR_DATA_TYPE_HEADING: {
-            int heading = ctrData.GetAssignedHeading();
-            if (heading >= 0 && heading <= 360) { // Valid heading range
-                out << " ahdg " << heading;
-                message["ahdg"] = heading;
-                message["direct"] = "";
-            }
-            break;
+        break;
+    }
+    case EuroScopePlugIn::CTR_DATA_TYPE_RATE: {
+        int rate = ctrData.GetAssignedRate();
+        if (rate >= -50000 && rate <= 50000) { // Reasonable rate range
+            out << " arc " << rate;
+            fields["arc"] = rate;
         }
-        case EuroScopePlugIn::CTR_DATA_TYPE_DIRECT_TO: {
-            const char *directTo = ctrData.GetDirectToPointName();
-            if (directTo && strlen(directTo) < 50) { // Reasonable waypoint name length
-                out << " direct " << directTo;
-                SetJsonIfValidUtf8(message, "direct", directTo);
-                if (strlen(directTo) > 0) message["ahdg"] = 0;
-            }
-            break;
+        break;
+    }
+    case EuroScopePlugIn::CTR_DATA_TYPE_HEADING: {
+        int heading = ctrData.GetAssignedHeading();
+        if (heading >= 0 && heading <= 360) { // Valid heading range
+            out << " ahdg " << heading;
+            fields["ahdg"] = heading;
+            fields["direct"] = "";
         }
-        default:
-            out << " unknown data type " << DataType;
-            break;
+        break;
+    }
+    case EuroScopePlugIn::CTR_DATA_TYPE_DIRECT_TO: {
+        BoundedString<49> directTo(ctrData.GetDirectToPointName()); // Reasonable waypoint name length
+        if (!directTo.IsNull() && !directTo.IsTooLong()) {
+            out << " direct " << directTo.View();
+            SetJsonIfValid(fields, "direct", directTo);
+            if (!directTo.IsEmpty()) fields["ahdg"] = 0;
+        }
+        break;
+    }
+    default:
+        out << " unknown data type " << DataType;
+        break;
+    }
+    // for (int i = 0; i < 9; i++) {
+    //     const char* annotation = ctrData.GetFlightStripAnnotation(i);
+    //     if (annotation && strlen(annotation) > 0 && strlen(annotation) < 50) { // Reasonable length limit
+    //         out << " a" << i << " " << annotation;
+    //     }
+    // }
+    DebugMessage(out.str());
+    return true;
+}
+
+void VatEFSPlugin::PostPendingControllerData(const std::string &callsign, PendingUpdate &pending)
+{
+    try {
+        if (!subscription.Wants(Subscription::CONTROLLER_DATA)) {
+            pending.controllerData = nullptr;
+            pending.scratchKey.clear();
+            return;
         }
-        // for (int i = 0; i < 9; i++) {
-        //     const char* annotation = ctrData.GetFlightStripAnnotation(i);
-        //     if (annotation && strlen(annotation) > 0 && strlen(annotation) < 50) { // Reasonable length limit
-        //         out << " a" << i << " " << annotation;
-        //     }
-        // }
-        DebugMessage(out.str());
-        PostJson(message, "OnFlightPlanControllerAssignedDataUpdate");
+        nlohmann::json message = nlohmann::json::object();
+        message["type"] = "controllerAssignedDataUpdate";
+        SetJsonIfValid(message, "callsign", BoundedString<20>(callsign.c_str()));
+
+        EuroScopePlugIn::CFlightPlan fp = FlightPlanSelect(callsign.c_str());
+        BoundedString<19> controllerCallsign(fp.IsValid() ? fp.GetTrackingControllerCallsign() : nullptr);
+        if (!controllerCallsign.IsEmpty()) SetJsonIfValid(message, "controller", controllerCallsign);
+
+        message.update(pending.controllerData);
+        for (const std::string &key : subscription.ExcludedFields())
+            message.erase(key);
+        pending.controllerData = nullptr;
+        pending.scratchKey.clear();
+        PostJson(message, "PostPendingControllerData");
     } catch (const std::exception &e) {
-        DisplayMessage(std::string("OnFlightPlanControllerAssignedDataUpdate exception: ") + e.what());
+        DisplayMessage(std::string("PostPendingControllerData exception: ") + e.what());
     } catch (...) {
-        DisplayMessage("OnFlightPlanControllerAssignedDataUpdate: Unknown exception");
+        DisplayMessage("PostPendingControllerData: Unknown exception");
+    }
+}
+
+void VatEFSPlugin::FlushPendingUpdates()
+{
+    if (pendingUpdates.empty()) return;
+    // Swap out first, posting may trigger further callbacks
+    std::unordered_map<std::string, PendingUpdate> pending;
+    pending.swap(pendingUpdates);
+    for (auto &[callsign, update] : pending) {
+        EuroScopePlugIn::CFlightPlan fp = FlightPlanSelect(callsign.c_str());
+        if (!fp.IsValid() || !FilterFlightPlan(fp)) continue;
+        if (update.flightPlanData) PostFlightPlanData(fp);
+        if (!update.controllerData.is_null()) PostPendingControllerData(callsign, update);
     }
 }
 
 void VatEFSPlugin::OnFlightPlanDisconnect(EuroScopePlugIn::CFlightPlan FlightPlan)
 {
-    if (disabled || !FilterFlightPlan(FlightPlan)) return;
+    AllocScope allocScope(ALLOC_FLIGHT_PLAN);
+    BoundedString<20> callsign(FlightPlan.GetCallsign());
+    RemoveTarget(targets.Find(callsign.View()));
+    if (disabled || !FilterFlightPlan(FlightPlan)) {
+        flightPlanCache.Erase(FlightPlan.GetCallsign());
+        extractedRoutes.Erase(FlightPlan.GetCallsign());
+        return;
+    }
+    flightPlanCache.Erase(callsign.CStr());
+    flightPlanDetails.erase(callsign.Str());
+    extractedRoutes.Erase(callsign.Str());
+    pendingUpdates.erase(callsign.Str());
     std::stringstream out;
-    out << "FlightPlanDisconnect " << FlightPlan.GetCallsign();
+    out << "FlightPlanDisconnect " << callsign.View();
     DebugMessage(out.str());
     nlohmann::json message = nlohmann::json::object();
     message["type"] = "flightPlanDisconnect";
-    SetJsonIfValidUtf8(message, "callsign", FlightPlan.GetCallsign());
+    SetJsonIfValid(message, "callsign", callsign);
     PostJson(message, "OnFlightPlanDisconnect");
 }
 
@@ -410,109 +709,783 @@ void VatEFSPlugin::OnFlightPlanFlightStripPushed(EuroScopePlugIn::CFlightPlan Fl
                                                  const char *sSenderController,
                                                  const char *sTargetController)
 {
+    AllocScope allocScope(ALLOC_FLIGHT_PLAN);
     if (disabled || !FilterFlightPlan(FlightPlan)) return;
+    BoundedString<20> callsign(FlightPlan.GetCallsign());
+    BoundedString<19> sender(sSenderController);
+    BoundedString<19> target(sTargetController);
     std::stringstream out;
-    out << "FlightPlanFlightStripPushed " << FlightPlan.GetCallsign();
-    if (sSenderController && strlen(sSenderController) > 0 && strlen(sSenderController) < 20)
-        out << " sender " << sSenderController;
-    if (sTargetController && strlen(sTargetController) > 0 && strlen(sTargetController) < 20)
-        out << " target " << sTargetController;
+    out << "FlightPlanFlightStripPushed " << callsign.View();
+    if (!sender.IsEmpty() && !sender.IsTooLong()) out << " sender " << sender.View();
+    if (!target.IsEmpty() && !target.IsTooLong()) out << " target " << target.View();
     DebugMessage(out.str());
     nlohmann::json message = nlohmann::json::object();
     message["type"] = "flightPlanFlightStripPushed";
-    SetJsonIfValidUtf8(message, "callsign", FlightPlan.GetCallsign());
-    if (sSenderController && strlen(sSenderController) > 0 && strlen(sSenderController) < 20)
-        SetJsonIfValidUtf8(message, "sender", sSenderController);
-    if (sTargetController && strlen(sTargetController) > 0 && strlen(sTargetController) < 20)
-        SetJsonIfValidUtf8(message, "target", sTargetController);
+    SetJsonIfValid(message, "callsign", callsign);
+    if (!sender.IsEmpty()) SetJsonIfValid(message, "sender", sender);
+    if (!target.IsEmpty()) SetJsonIfValid(message, "target", target);
     PostJson(message, "OnFlightPlanFlightStripPushed");
     // The above message gets sent repeatedly from GND -> TWR... not sure when this is supposed to happen,
-    // but it isn't just on transfer...
+    // but it isn't just on transfer... the flight plan data update below is debounced though.
     OnFlightPlanFlightPlanDataUpdate(FlightPlan);
 }
 
 void VatEFSPlugin::OnControllerPositionUpdate(EuroScopePlugIn::CController Controller)
 {
+    AllocScope allocScope(ALLOC_CONTROLLER);
     if (disabled) return;
-    nlohmann::json message = nlohmann::json::object();
-    message["type"] = "controllerPositionUpdate";
-    SetJsonIfValidUtf8(message, "callsign", Controller.GetCallsign());
-    SetJsonIfValidUtf8(message, "position", Controller.GetPositionId());
-    SetJsonWithUtf8Replace(message, "name", Controller.GetFullName());
-    message["frequency"] = Controller.GetPrimaryFrequency();
-    message["rating"] = Controller.GetRating();
-    message["facility"] = Controller.GetFacility();
-    SetJsonIfValidUtf8(message, "sector", Controller.GetSectorFileName());
-    message["controller"] = Controller.IsController();
-    const char *myCallsign = Controller.GetCallsign();
-    const char *selfCallsign = ControllerMyself().GetCallsign();
-    if (myCallsign && selfCallsign && IsValidUtf8(myCallsign) && IsValidUtf8(selfCallsign))
-        message["me"] = (std::string(myCallsign) == std::string(selfCallsign));
-    PostJson(message, "OnControllerPositionUpdate");
+    PooledBuffer buffer = outputBuffers.Acquire(OutputBufferPool::SMALL);
+    std::string &line = buffer.Str();
+    JsonWriter message(line);
+    message.Exclude(subscription.ExcludedFields());
+    message.BeginObject();
+    message.String("type", "controllerPositionUpdate");
+    BoundedString<20> callsign(Controller.GetCallsign());
+    message.String("callsign", callsign);
+    message.String("position", BoundedString<20>(Controller.GetPositionId()));
+    BoundedString<100> name(Controller.GetFullName());
+    if (!name.IsNull()) message.StringWithUtf8Replace("name", name.View());
+    message.Double("frequency", Controller.GetPrimaryFrequency());
+    message.Int("rating", Controller.GetRating());
+    message.Int("facility", Controller.GetFacility());
+    message.String("sector", BoundedString<_MAX_PATH>(Controller.GetSectorFileName()));
+    message.Bool("controller", Controller.IsController());
+    BoundedString<20> selfCallsign(ControllerMyself().GetCallsign());
+    if (callsign.IsValid() && selfCallsign.IsValid())
+        message.Bool("me", callsign.View() == selfCallsign.View());
+    message.EndObject();
+    PostLine(line, "OnControllerPositionUpdate");
 }
 
 void VatEFSPlugin::OnControllerDisconnect(EuroScopePlugIn::CController Controller)
 {
+    AllocScope allocScope(ALLOC_CONTROLLER);
     if (disabled) return;
     std::stringstream out;
     out << "ControllerDisconnect " << Controller.GetCallsign();
     DebugMessage(out.str());
     nlohmann::json message = nlohmann::json::object();
     message["type"] = "controllerDisconnect";
-    SetJsonIfValidUtf8(message, "callsign", Controller.GetCallsign());
+    SetJsonIfValid(message, "callsign", BoundedString<20>(Controller.GetCallsign()));
     PostJson(message, "OnControllerDisconnect");
 }
 
+void VatEFSPlugin::OnNewMetarReceived(const char *sStation, const char *sFullMetar)
+{
+    AllocScope allocScope(ALLOC_METAR);
+    try {
+        if (disabled || !sStation || !sFullMetar) return;
+        const std::string_view text(sFullMetar);
+        const std::size_t hash = std::hash<std::string_view>()(text);
+        StoredMetar &stored = metars[sStation];
+        if (stored.hash == hash && stored.text == text) {
+            metarsUnchanged++;
+            return;
+        }
+        stored.hash = hash;
+        stored.text = text;
+        PostMetar(sStation);
+    } catch (const std::exception &e) {
+        DisplayMessage(std::string("OnNewMetarReceived exception: ") + e.what());
+    } catch (...) {
+        DisplayMessage("OnNewMetarReceived: Unknown exception");
+    }
+}
+
+void VatEFSPlugin::PostMetar(const std::string &station)
+{
+    if (!subscription.Wants(Subscription::METAR) || !subscription.WantsStation(station)) return;
+    auto stored = metars.find(station);
+    if (stored == metars.end() || stored->second.text.empty()) return;
+    PooledBuffer buffer = outputBuffers.Acquire(OutputBufferPool::SMALL);
+    std::string &line = buffer.Str();
+    JsonWriter message(line);
+    message.Exclude(subscription.ExcludedFields());
+    message.BeginObject();
+    message.String("type", "metar");
+    message.String("station", station);
+    message.String("metar", stored->second.text);
+    message.EndObject();
+    PostLine(line, "PostMetar");
+    metarsForwarded++;
+}
+
 void VatEFSPlugin::OnRadarTargetPositionUpdate(EuroScopePlugIn::CRadarTarget RadarTarget)
 {
+    AllocScope allocScope(ALLOC_RADAR);
     if (disabled || !RadarTarget.IsValid()) return;
     // std::stringstream out;
     // out << "RadarTargetPositionUpdate " << RadarTarget.GetCallsign();
     // DebugMessage(out.str());
-    nlohmann::json message = nlohmann::json::object();
-    message["type"] = "radarTargetPositionUpdate";
-    SetJsonIfValidUtf8(message, "callsign", RadarTarget.GetCallsign());
-    message["verticalSpeed"] = RadarTarget.GetVerticalSpeed();
-    message["groundSpeed"] = RadarTarget.GetGS();
+    BoundedString<20> callsign(RadarTarget.GetCallsign());
+    const int id = UpdateTarget(callsign);
+    const int verticalSpeed = RadarTarget.GetVerticalSpeed();
+    const int groundSpeed = RadarTarget.GetGS();
     auto position = RadarTarget.GetPosition();
+    auto correlated = RadarTarget.GetCorrelatedFlightPlan();
+    const FlightPlanView *fp =
+    correlated.IsValid() ? &flightPlanCache.Get(correlated, FlightPlanCache::CORE) : nullptr;
+    // Decided first, so that the events below are filtered too
+    const bool wanted = id == TargetTable::NONE || WantsTarget(id, correlated);
+
+    if (id != TargetTable::NONE) {
+        targets.verticalSpeed[id] = verticalSpeed;
+        targets.groundSpeed[id] = groundSpeed;
+        UpdateSquawk(id, position.IsValid() ? SquawkPool::Parse(position.GetSquawk())
+                                            : SquawkPool::NO_CODE);
+        // Only needed to allocate, and the flight plan callback may have missed it if it came
+        // before the target
+        if (squawks.RangeCount() > 0 && correlated.IsValid()) {
+            const FlightPlanView &assigned =
+            flightPlanCache.Get(correlated, FlightPlanCache::CORE | FlightPlanCache::CTR_DATA);
+            UpdateAssignedSquawk(id, assigned.squawk.IsTooLong()
+                                     ? SquawkPool::NO_CODE
+                                     : SquawkPool::Parse(assigned.squawk.View()));
+        }
+        targets.ownership[id] = TargetTable::OWNER_NONE;
+        if (fp && !fp->trackingController.IsEmpty())
+            targets.ownership[id] = fp->trackedByMe ? TargetTable::OWNER_ME : TargetTable::OWNER_OTHER;
+        if (position.IsValid()) {
+            const EuroScopePlugIn::CPosition coordinates = position.GetPosition();
+            if (targets.hasPosition[id] && !trackFilterEnabled) {
+                const GeoPoint previous = { targets.latitude[id], targets.longitude[id] };
+                const GeoPoint current = { coordinates.m_Latitude, coordinates.m_Longitude };
+                if (DistanceMeters(previous, current) > 10) // ignore jitter
+                    targets.track[id] = static_cast<int>(TrueBearing(previous, current));
+            }
+            targets.latitude[id] = coordinates.m_Latitude;
+            targets.longitude[id] = coordinates.m_Longitude;
+            targets.altitude[id] = position.GetPressureAltitude();
+            targets.heading[id] = position.GetReportedHeadingTrueNorth();
+            targets.hasPosition[id] = 1;
+            targets.history[id].Add({ targets.lastSeen[id], coordinates.m_Latitude,
+                                      coordinates.m_Longitude, targets.altitude[id], groundSpeed });
+        }
+        // The report time, in the whole seconds GetReceivedTime has
+        UpdateTrackFilter(id, position.IsValid() ? std::time(NULL) - position.GetReceivedTime() : 0);
+        targets.positionVersion[id]++;
+        bool changed = UpdateGeofences(id);
+        changed |= UpdateAirspace(id);
+        changed |= UpdateMovementState(id);
+        if (!changed && IsGroundPositionThrottled(id)) return;
+    }
+    if (!wanted || !subscription.Wants(Subscription::RADAR_POSITION)) return;
+
+    PooledBuffer buffer = outputBuffers.Acquire(OutputBufferPool::SMALL);
+    std::string &line = buffer.Str();
+    JsonWriter message(line);
+    message.Exclude(subscription.ExcludedFields());
+    message.BeginObject();
+    message.String("type", "radarTargetPositionUpdate");
+    message.String("callsign", callsign);
+    message.Int("verticalSpeed", verticalSpeed);
+    message.Int("groundSpeed", groundSpeed);
     if (position.IsValid()) {
-        message["latitude"] = position.GetPosition().m_Latitude;
-        message["longitude"] = position.GetPosition().m_Longitude;
-        message["altitude"] = position.GetPressureAltitude();
-        // message["headingMagnetic"] = position.GetReportedHeading();
-        message["heading"] = position.GetReportedHeadingTrueNorth();
-        const char *squawk = position.GetSquawk();
-        if (squawk && strlen(squawk) == 4) { // Valid squawk is always 4 digits
-            SetJsonIfValidUtf8(message, "squawk", squawk);
-        }
-        // message["modec"] = position.GetTransponderC();
-        // message["ident"] = position.GetTransponderI();
-    }
-    auto fp = RadarTarget.GetCorrelatedFlightPlan();
-    if (fp.IsValid()) {
-        const char *trackingCallsign = fp.GetTrackingControllerCallsign();
-        if (trackingCallsign && strlen(trackingCallsign) < 20) {
-            SetJsonIfValidUtf8(message, "controller", trackingCallsign);
-        }
-        const char *nextController = fp.GetCoordinatedNextController();
-        if (nextController && strlen(nextController) < 20) {
-            SetJsonIfValidUtf8(message, "nextController", nextController);
-            auto nextCon = ControllerSelect(nextController);
-            if (nextCon.IsValid())
-                message["nextControllerFrequency"] = nextCon.GetPrimaryFrequency();
-            else
-                message["nextControllerFrequency"] = 0;
+        message.Double("latitude", position.GetPosition().m_Latitude);
+        message.Double("longitude", position.GetPosition().m_Longitude);
+        message.Int("altitude", position.GetPressureAltitude());
+        // message.Int("headingMagnetic", position.GetReportedHeading());
+        message.Int("heading", position.GetReportedHeadingTrueNorth());
+        BoundedString<4> squawk(position.GetSquawk());
+        if (squawk.Length() == 4) { // Valid squawk is always 4 digits
+            message.String("squawk", squawk);
+        }
+        // message.Bool("modec", position.GetTransponderC());
+        // message.Bool("ident", position.GetTransponderI());
+    }
+    if (fp) {
+        message.String("controller", fp->trackingController);
+        if (!fp->nextController.IsTooLong()) {
+            message.String("nextController", fp->nextController);
+            message.Double("nextControllerFrequency", fp->nextControllerFrequency);
         }
-        const char *handoffTargetController = fp.GetHandoffTargetControllerCallsign();
-        if (handoffTargetController && strlen(handoffTargetController) < 20) {
-            SetJsonIfValidUtf8(message, "handoffTargetController", handoffTargetController);
+        message.String("handoffTargetController", fp->handoffTargetController);
+        if (fp->ete >= 0 && fp->ete <= 3600) { // Reasonable ETE range
+            message.Int("ete", fp->ete);
         }
-        int ete = fp.GetPositionPredictions().GetPointsNumber();
-        if (ete >= 0 && ete <= 3600) { // Reasonable ETE range
-            message["ete"] = ete;
+    }
+    message.EndObject();
+    PostLine(line, "OnRadarTargetPositionUpdate");
+    if (id != TargetTable::NONE) {
+        targets.sentPositionVersion[id] = targets.positionVersion[id];
+        targets.positionSentTime[id] = targets.lastSeen[id];
+    }
+}
+
+void VatEFSPlugin::UpdateTrackFilter(int id, std::time_t reportTime)
+{
+    if (!targets.hasPosition[id]) return;
+    if (!trackFilterEnabled) {
+        targets.filteredLatitude[id] = targets.latitude[id];
+        targets.filteredLongitude[id] = targets.longitude[id];
+        targets.filteredGroundSpeed[id] = targets.groundSpeed[id];
+        return;
+    }
+    TrackFilter &filter = targets.trackFilter[id];
+    // Only a report newer than the last one is a measurement. Feeding the filter the stored
+    // position again at a later time (no valid position, or the same report on a refresh) would
+    // pull its velocity towards zero.
+    if (reportTime == 0) return;
+    if (filter.initialized && static_cast<double>(reportTime) <= filter.time) return;
+    filter.Update(static_cast<double>(reportTime), { targets.latitude[id], targets.longitude[id] },
+                  targets.groundSpeed[id], targets.heading[id]);
+    const GeoPoint position = filter.Position();
+    targets.filteredLatitude[id] = position.latitude;
+    targets.filteredLongitude[id] = position.longitude;
+    targets.filteredGroundSpeed[id] = static_cast<int>(std::lround(filter.GroundSpeed()));
+    // The direction of a standing target is noise, keep the last one
+    if (filter.GroundSpeed() >= 2) targets.track[id] = static_cast<int>(filter.Track());
+}
+
+void VatEFSPlugin::OnGetTagItem(EuroScopePlugIn::CFlightPlan FlightPlan,
+                                EuroScopePlugIn::CRadarTarget RadarTarget,
+                                int ItemCode,
+                                int TagData,
+                                char sItemString[16],
+                                int *pColorCode,
+                                COLORREF *pRGB,
+                                double *pFontSize)
+{
+    // Called for every visible tag and list entry on each refresh: one hash lookup and a copy
+    // into EuroScope's buffer, nothing allocated
+    if (ItemCode < TAG_ITEM_EFS_STAND || ItemCode > TAG_ITEM_EFS_SECTION) return;
+    const char *callsign = FlightPlan.IsValid()    ? FlightPlan.GetCallsign()
+                           : RadarTarget.IsValid() ? RadarTarget.GetCallsign()
+                                                   : nullptr;
+    if (callsign == nullptr) return;
+    const int id = targets.Find(callsign);
+    if (id == TargetTable::NONE) return;
+
+    const BoundedString<15> *value = nullptr;
+    switch (ItemCode) {
+    case TAG_ITEM_EFS_STAND:
+        value = &targets.efsStand[id];
+        break;
+    case TAG_ITEM_EFS_CLEARED_TO_LAND:
+        if (targets.efsClearedToLand[id]) std::memcpy(sItemString, "CTL", 4);
+        return;
+    case TAG_ITEM_EFS_BAY:
+        value = &targets.efsBay[id];
+        break;
+    case TAG_ITEM_EFS_SECTION:
+        value = &targets.efsSection[id];
+        break;
+    }
+    std::memcpy(sItemString, value->CStr(), value->Length() + 1); // at most 15 characters
+}
+
+void VatEFSPlugin::ApplyEfsState(const nlohmann::json &message)
+{
+    const std::string callsign = message.value("callsign", "");
+    if (callsign.empty()) return;
+    const int id = UpdateTarget(BoundedString<20>(callsign.c_str()));
+    if (id == TargetTable::NONE) return;
+    // Only the fields present change, longer values are cut to what a tag item can show
+    auto assign = [&](const char *key, BoundedString<15> &value) {
+        if (message.contains(key)) value.Assign(message[key].get<std::string>().c_str());
+    };
+    assign("stand", targets.efsStand[id]);
+    assign("bay", targets.efsBay[id]);
+    assign("section", targets.efsSection[id]);
+    if (message.contains("clearedToLand"))
+        targets.efsClearedToLand[id] = message["clearedToLand"].get<bool>();
+}
+
+bool VatEFSPlugin::HasEfsState(int id) const
+{
+    return !targets.efsStand[id].IsEmpty() || !targets.efsBay[id].IsEmpty() || !targets.efsSection[id].IsEmpty() ||
+           targets.efsClearedToLand[id];
+}
+
+void VatEFSPlugin::PostTrackHistory(const std::string &callsign, std::time_t from, std::time_t to)
+{
+    std::vector<TrackHistory::Sample> samples;
+    const int id = targets.Find(callsign);
+    if (id != TargetTable::NONE) targets.history[id].Query(from, to, samples);
+
+    // In parts that fit in a datagram, at least one message even if there is nothing
+    std::size_t start = 0;
+    do {
+        const std::size_t end = std::min(start + MAX_TRACK_POINTS_PER_MESSAGE, samples.size());
+        nlohmann::json points = nlohmann::json::array();
+        for (std::size_t i = start; i < end; i++) {
+            const TrackHistory::Sample &sample = samples[i];
+            points.push_back({ sample.time, sample.latitude, sample.longitude, sample.altitude,
+                               sample.groundSpeed });
+        }
+        nlohmann::json message = nlohmann::json::object();
+        message["type"] = "trackHistory";
+        message["callsign"] = callsign;
+        message["points"] = std::move(points);
+        message["complete"] = end == samples.size();
+        if (id != TargetTable::NONE) message["bytes"] = targets.history[id].MemoryUsage();
+        PostJson(message, "PostTrackHistory");
+        start = end;
+    } while (start < samples.size());
+}
+
+void VatEFSPlugin::PostFlightPlanDetail(const std::string &callsign)
+{
+    auto cached = flightPlanDetails.find(callsign);
+    if (cached == flightPlanDetails.end()) {
+        nlohmann::json message = nlohmann::json::object();
+        message["type"] = "flightPlanDetail";
+        message["callsign"] = callsign;
+        EuroScopePlugIn::CFlightPlan FlightPlan = FlightPlanSelect(callsign.c_str());
+        if (FlightPlan.IsValid()) {
+            EuroScopePlugIn::CFlightPlanData fpData = FlightPlan.GetFlightPlanData();
+            message["route"] = AnsiToUtf8(fpData.GetRoute());
+            message["remarks"] = AnsiToUtf8(fpData.GetRemarks());
+            bool extracted = false;
+            message["extractedRoute"] = ExtractedRouteToJson(ExtractRoute(
+            FlightPlan, flightPlanCache.Get(FlightPlan, FlightPlanCache::FP_DATA), extracted));
+        } else {
+            message["found"] = false; // so the backend stops waiting
         }
+        std::string line;
+        try {
+            line = message.dump();
+        } catch (const std::exception &e) {
+            DisplayMessage("PostFlightPlanDetail: " + std::string(e.what()));
+            return;
+        }
+        // Kept until the next amendment, but not for callsigns without a flight plan
+        if (!FlightPlan.IsValid()) {
+            PostLine(line, "PostFlightPlanDetail");
+            return;
+        }
+        cached = flightPlanDetails.emplace(callsign, std::move(line)).first;
+    }
+    PooledBuffer buffer = outputBuffers.Acquire(OutputBufferPool::LARGE);
+    buffer.Str() = cached->second; // PostLine appends to the line
+    PostLine(buffer.Str(), "PostFlightPlanDetail");
+}
+
+const ExtractedRouteCache::Route &VatEFSPlugin::ExtractRoute(EuroScopePlugIn::CFlightPlan FlightPlan,
+                                                            const FlightPlanView &fp, bool &extracted)
+{
+    std::uint64_t hash = ExtractedRouteCache::Hash(fp.route.View());
+    for (std::string_view field : { fp.depRwy.View(), fp.sid.View(), fp.arrRwy.View(), fp.star.View() })
+        hash = ExtractedRouteCache::Hash(field, hash);
+    const std::string callsign = fp.callsign.Str();
+    if (const ExtractedRouteCache::Route *cached = extractedRoutes.Find(callsign, hash)) {
+        extracted = false;
+        return *cached;
+    }
+
+    const int id = targets.Find(fp.callsign.View());
+    ExtractedRouteCache::Route &route =
+    extractedRoutes.Reset(callsign, hash, id != TargetTable::NONE ? targets.flightPlanVersion[id] : 0);
+    EuroScopePlugIn::CFlightPlanExtractedRoute points = FlightPlan.GetExtractedRoute();
+    double distance = 0;
+    EuroScopePlugIn::CPosition previous;
+    for (int i = 0; i < points.GetPointsNumber(); i++) {
+        const EuroScopePlugIn::CPosition position = points.GetPointPosition(i);
+        if (i > 0) distance += previous.DistanceTo(position);
+        previous = position;
+        extractedRoutes.Add(route, points.GetPointName(i), points.GetPointAirwayName(i),
+                            position.m_Latitude, position.m_Longitude, distance);
+    }
+    extracted = true;
+    return route;
+}
+
+nlohmann::json VatEFSPlugin::ExtractedRouteToJson(const ExtractedRouteCache::Route &route) const
+{
+    // Names are numbered per message, in order of appearance, with "" as 0 for no airway
+    std::unordered_map<std::uint32_t, std::size_t> indices = { { ExtractedRouteCache::NO_NAME, 0 } };
+    nlohmann::json names = nlohmann::json::array({ "" });
+    auto index = [&](std::uint32_t name) {
+        auto [it, added] = indices.emplace(name, names.size());
+        if (added) names.push_back(AnsiToUtf8(extractedRoutes.Name(name).c_str()));
+        return it->second;
+    };
+    nlohmann::json points = nlohmann::json::array();
+    for (const ExtractedRouteCache::Point &point : route.points) {
+        points.push_back(index(point.name));
+        points.push_back(index(point.airway));
+        points.push_back(point.latitude);
+        points.push_back(point.longitude);
+        points.push_back(point.distance);
+    }
+    nlohmann::json result = nlohmann::json::object();
+    result["version"] = route.version;
+    result["names"] = std::move(names);
+    result["points"] = std::move(points);
+    return result;
+}
+
+void VatEFSPlugin::BackfillPositions()
+{
+    const std::time_t now = std::time(NULL);
+    std::vector<TrackHistory::Sample> samples;
+    for (int n = 0; n < BACKFILL_TARGETS_PER_TICK && !backfillQueue.empty(); n++) {
+        const std::string callsign = std::move(backfillQueue.front());
+        backfillQueue.pop_front();
+        const int id = targets.Find(callsign);
+        EuroScopePlugIn::CRadarTarget RadarTarget = RadarTargetSelect(callsign.c_str());
+        if (id == TargetTable::NONE || !RadarTarget.IsValid()) continue;
+
+        samples.clear();
+        EuroScopePlugIn::CRadarTargetPositionData position = RadarTarget.GetPosition();
+        for (int i = 0; i < BACKFILL_POSITIONS && position.IsValid(); i++) {
+            const EuroScopePlugIn::CPosition coordinates = position.GetPosition();
+            samples.push_back({ now - position.GetReceivedTime(), coordinates.m_Latitude,
+                                coordinates.m_Longitude, position.GetPressureAltitude(),
+                                position.GetReportedGS() });
+            position = RadarTarget.GetPreviousPosition(position);
+        }
+        if (samples.size() < 2) continue; // nothing the current position doesn't say
+        std::reverse(samples.begin(), samples.end());
+
+        // A target first seen in the refresh has only its current position in the history
+        if (targets.history[id].Count() <= 1) {
+            targets.history[id].Clear();
+            for (const TrackHistory::Sample &sample : samples)
+                targets.history[id].Add(sample);
+        }
+
+        if (!subscription.Wants(Subscription::POSITION_BACKFILL) || !WantsTarget(id)) continue;
+        nlohmann::json points = nlohmann::json::array();
+        for (const TrackHistory::Sample &sample : samples)
+            points.push_back({ sample.time, sample.latitude, sample.longitude, sample.altitude,
+                               sample.groundSpeed });
+        nlohmann::json message = nlohmann::json::object();
+        message["type"] = "positionBackfill";
+        message["callsign"] = callsign;
+        message["points"] = std::move(points);
+        PostJson(message, "BackfillPositions");
+    }
+}
+
+void VatEFSPlugin::LoadGeofences()
+{
+    geofences.Clear();
+    arrivalThresholds.Clear();
+    for (int id = 0; id < targets.Size(); id++)
+        targets.runwayFence[id] = targets.standFence[id] = GeofenceIndex::NONE;
+
+    SelectActiveSectorfile();
+    for (EuroScopePlugIn::CSectorElement runway =
+         SectorFileElementSelectFirst(EuroScopePlugIn::SECTOR_ELEMENT_RUNWAY);
+         runway.IsValid();
+         runway = SectorFileElementSelectNext(runway, EuroScopePlugIn::SECTOR_ELEMENT_RUNWAY)) {
+        BoundedString<10> airport(runway.GetAirportName());
+        BoundedString<5> name0(runway.GetRunwayName(0));
+        BoundedString<5> name1(runway.GetRunwayName(1));
+        if (airport.IsEmpty() || !airport.IsValid() || !name0.IsValid() || !name1.IsValid()) continue;
+        EuroScopePlugIn::CPosition end0, end1;
+        if (!runway.GetPosition(&end0, 0) || !runway.GetPosition(&end1, 1)) continue;
+        std::string airportName = airport.Str();
+        airportName.erase(std::remove_if(airportName.begin(), airportName.end(), ::isspace),
+                          airportName.end());
+        geofences.AddRunway(airportName, name0.Str() + "/" + name1.Str(),
+                            { end0.m_Latitude, end0.m_Longitude }, { end1.m_Latitude, end1.m_Longitude });
+        arrivalThresholds.AddRunwayEnd(airportName, name0.Str(), { end0.m_Latitude, end0.m_Longitude });
+        arrivalThresholds.AddRunwayEnd(airportName, name1.Str(), { end1.m_Latitude, end1.m_Longitude });
+    }
+    for (EuroScopePlugIn::CSectorElement airport =
+         SectorFileElementSelectFirst(EuroScopePlugIn::SECTOR_ELEMENT_AIRPORT);
+         airport.IsValid();
+         airport = SectorFileElementSelectNext(airport, EuroScopePlugIn::SECTOR_ELEMENT_AIRPORT)) {
+        BoundedString<10> name(airport.GetName());
+        EuroScopePlugIn::CPosition position;
+        if (name.IsEmpty() || !name.IsValid() || !airport.GetPosition(&position, 0)) continue;
+        std::string airportName = name.Str();
+        airportName.erase(std::remove_if(airportName.begin(), airportName.end(), ::isspace),
+                          airportName.end());
+        arrivalThresholds.AddAirport(airportName, { position.m_Latitude, position.m_Longitude });
+    }
+    geofences.LoadStands(standsFile);
+    DebugMessage("Geofences: " + std::to_string(geofences.RunwayCount()) + " runways, " +
+                 std::to_string(geofences.StandCount()) + " stands from " + standsFile);
+}
+
+bool VatEFSPlugin::UpdateGeofences(int id)
+{
+    if (!targets.hasPosition[id]) return false;
+    const GeoPoint position = { targets.filteredLatitude[id], targets.filteredLongitude[id] };
+    const int altitude = targets.altitude[id];
+    const int groundSpeed = targets.filteredGroundSpeed[id];
+
+    // Parked and slowly taxiing aircraft tell where the ground is
+    int stand = geofences.FindStand(position);
+    int runway = geofences.FindRunway(position);
+    if (groundSpeed < 30) {
+        if (stand != GeofenceIndex::NONE) geofences.ObserveGround(geofences.Get(stand).airport, altitude);
+        else if (runway != GeofenceIndex::NONE) geofences.ObserveGround(geofences.Get(runway).airport, altitude);
+    }
+    if (runway != GeofenceIndex::NONE && !geofences.IsOnSurface(geofences.Get(runway).airport, altitude))
+        runway = GeofenceIndex::NONE;
+    // Only standing still counts as being on a stand, not taxiing across it
+    const int previousStand = targets.standFence[id];
+    if (stand != previousStand && groundSpeed > 5) stand = GeofenceIndex::NONE;
+
+    bool changed = false;
+    if (runway != targets.runwayFence[id]) {
+        if (targets.runwayFence[id] != GeofenceIndex::NONE)
+            PostGeofenceEvent("vacatedRunway", "runway", id, targets.runwayFence[id]);
+        if (runway != GeofenceIndex::NONE) PostGeofenceEvent("enteredRunway", "runway", id, runway);
+        targets.runwayFence[id] = runway;
+        changed = true;
+    }
+    if (stand != previousStand) {
+        if (previousStand != GeofenceIndex::NONE) PostGeofenceEvent("offStand", "stand", id, previousStand);
+        if (stand != GeofenceIndex::NONE) PostGeofenceEvent("onStand", "stand", id, stand);
+        targets.standFence[id] = stand;
+        changed = true;
+    }
+    return changed;
+}
+
+void VatEFSPlugin::PostGeofenceEvent(const char *type, const char *key, int id, int fence)
+{
+    if (!subscription.Wants(Subscription::GEOFENCE) || !WantsTarget(id)) return;
+    const GeofenceIndex::Fence &f = geofences.Get(fence);
+    PooledBuffer buffer = outputBuffers.Acquire(OutputBufferPool::SMALL);
+    JsonWriter message(buffer.Str());
+    message.BeginObject();
+    message.String("type", type);
+    message.String("callsign", targets.callsign[id]);
+    message.String("airport", geofences.AirportName(f.airport));
+    message.String(key, f.name);
+    message.EndObject();
+    PostLine(buffer.Str(), "PostGeofenceEvent");
+}
+
+void VatEFSPlugin::BuildAirspaces()
+{
+    airspaces.Build();
+    // Zone and cell indices have changed, test all targets again on their next position
+    for (int id = 0; id < targets.Size(); id++) {
+        targets.airspace[id] = targets.airspaceCell[id] = AirspaceIndex::NONE;
+        targets.airspaceCellKey[id] = AirspaceIndex::NO_CELL;
+    }
+    DebugMessage("Airspaces: " + std::to_string(airspaces.Count()) + " zones in " +
+                 std::to_string(airspaces.CellCount()) + " cells");
+}
+
+bool VatEFSPlugin::UpdateAirspace(int id)
+{
+    if (!targets.hasPosition[id] || airspaces.Count() == 0) return false;
+    const GeoPoint position = { targets.filteredLatitude[id], targets.filteredLongitude[id] };
+    // Only look up the cell when the target has moved into another one
+    const std::int64_t cellKey = AirspaceIndex::CellKey(position);
+    if (cellKey != targets.airspaceCellKey[id]) {
+        targets.airspaceCellKey[id] = cellKey;
+        targets.airspaceCell[id] = airspaces.FindCell(cellKey);
+    }
+    const int zone = airspaces.Find(targets.airspaceCell[id], position, targets.altitude[id]);
+    const int previous = targets.airspace[id];
+    if (zone == previous) return false;
+    if (previous != AirspaceIndex::NONE) PostAirspaceEvent("airspaceExit", id, previous);
+    if (zone != AirspaceIndex::NONE) PostAirspaceEvent("airspaceEnter", id, zone);
+    targets.airspace[id] = zone;
+    return true;
+}
+
+void VatEFSPlugin::PostAirspaceEvent(const char *type, int id, int zone)
+{
+    if (!subscription.Wants(Subscription::AIRSPACE) || !WantsTarget(id)) return;
+    const AirspaceIndex::Zone &z = airspaces.Get(zone);
+    PooledBuffer buffer = outputBuffers.Acquire(OutputBufferPool::SMALL);
+    JsonWriter message(buffer.Str());
+    message.BeginObject();
+    message.String("type", type);
+    message.String("callsign", targets.callsign[id]);
+    message.String("airspace", z.name);
+    message.String("airport", z.airport);
+    message.Int("altitude", targets.altitude[id]);
+    message.EndObject();
+    PostLine(buffer.Str(), "PostAirspaceEvent");
+}
+
+bool VatEFSPlugin::UpdateMovementState(int id)
+{
+    if (!targets.hasPosition[id]) return false;
+    const GeoPoint position = { targets.filteredLatitude[id], targets.filteredLongitude[id] };
+    MovementInput input;
+    input.groundSpeed = targets.filteredGroundSpeed[id];
+    input.verticalSpeed = targets.verticalSpeed[id];
+    int difference = std::abs(targets.track[id] - targets.heading[id]) % 360;
+    input.reversing = targets.track[id] >= 0 && std::min(difference, 360 - difference) > 120;
+    const int ground = geofences.GroundAltitude(position);
+    input.surface = ground == INT_MIN ? SURFACE_UNKNOWN
+                    : targets.altitude[id] <= ground + GeofenceIndex::ALTITUDE_THRESHOLD_FT
+                    ? SURFACE_GROUND
+                    : SURFACE_AIRBORNE;
+    input.onRunway = targets.runwayFence[id] != GeofenceIndex::NONE;
+    input.onStand = targets.standFence[id] != GeofenceIndex::NONE;
+
+    // The inferred state must be seen MOVEMENT_CONFIRMATIONS times in a row to be taken
+    const MovementState current = targets.movementState[id];
+    const MovementState inferred = InferMovementState(current, input);
+    if (!ConfirmMovementState(inferred, targets.movementState[id], targets.movementCandidate[id],
+                              targets.movementConfirmations[id]))
+        return false;
+
+    if (!subscription.Wants(Subscription::MOVEMENT) || !WantsTarget(id)) return true;
+    PooledBuffer buffer = outputBuffers.Acquire(OutputBufferPool::SMALL);
+    JsonWriter message(buffer.Str());
+    message.BeginObject();
+    message.String("type", "movementStateChanged");
+    message.String("callsign", targets.callsign[id]);
+    message.String("state", MovementStateName(inferred));
+    message.String("previousState", MovementStateName(current));
+    message.Int("groundSpeed", input.groundSpeed);
+    message.EndObject();
+    PostLine(buffer.Str(), "UpdateMovementState");
+    return true;
+}
+
+void VatEFSPlugin::SweepArrivalMetrics()
+{
+    const int count = targets.Size();
+    if (count == 0 || !subscription.Wants(Subscription::ARRIVAL_METRICS)) return;
+    // All targets in one batch, it is cheaper to compute the few irrelevant ones than to branch
+    ComputeArrivalMetrics(count, targets.filteredLatitude.data(), targets.filteredLongitude.data(),
+                          targets.thresholdLatitude.data(), targets.thresholdLongitude.data(),
+                          targets.filteredGroundSpeed.data(), targets.heading.data(),
+                          targets.arrivalDistance.data(), targets.arrivalClosure.data(),
+                          targets.arrivalEta.data());
+
+    for (int id = 0; id < count; id++) {
+        if (!targets.hasArrivalThreshold[id] || !targets.hasPosition[id]) continue;
+        if (targets.metricsPositionVersion[id] == targets.positionVersion[id]) continue;
+        const MovementState state = targets.movementState[id];
+        if (state != MOVEMENT_AIRBORNE && state != MOVEMENT_UNKNOWN) continue;
+        if (targets.arrivalDistance[id] > MAX_ARRIVAL_DISTANCE_NM) continue;
+        targets.metricsPositionVersion[id] = targets.positionVersion[id];
+        if (!WantsTarget(id)) continue;
+
+        PooledBuffer buffer = outputBuffers.Acquire(OutputBufferPool::SMALL);
+        JsonWriter message(buffer.Str());
+        message.BeginObject();
+        message.String("type", "arrivalMetrics");
+        message.String("callsign", targets.callsign[id]);
+        message.Double("distance", std::round(targets.arrivalDistance[id] * 10) / 10);
+        message.Int("closure", std::lround(targets.arrivalClosure[id]));
+        message.Int("eta", std::lround(targets.arrivalEta[id]));
+        message.EndObject();
+        PostLine(buffer.Str(), "SweepArrivalMetrics");
     }
-    PostJson(message, "OnRadarTargetPositionUpdate");
+}
+
+bool VatEFSPlugin::IsGroundPositionThrottled(int id)
+{
+    // Opt-in (groundpositioninterval in VatEFSPlugin.txt): aircraft moving slowly on the ground
+    // off the runways only get a position update every so often. Geofence events are sent as
+    // they happen regardless.
+    if (groundPositionInterval <= 0 || !targets.hasPosition[id]) return false;
+    if (targets.filteredGroundSpeed[id] >= 50 || targets.runwayFence[id] != GeofenceIndex::NONE)
+        return false;
+    const GeoPoint position = { targets.filteredLatitude[id], targets.filteredLongitude[id] };
+    if (!geofences.IsOnSurface(position, targets.altitude[id])) return false;
+    return targets.lastSeen[id] - targets.positionSentTime[id] < groundPositionInterval;
+}
+
+int VatEFSPlugin::UpdateTarget(const BoundedString<20> &callsign)
+{
+    if (callsign.IsEmpty() || callsign.IsTooLong()) return TargetTable::NONE;
+    int id = targets.Insert(callsign);
+    targets.lastSeen[id] = std::time(NULL);
+    return id;
+}
+
+void VatEFSPlugin::SweepTargets()
+{
+    // Radar targets going out of range don't get a callback, so they are dropped once nothing has
+    // been heard of them for a while. Backwards, as Remove() moves the last target into the hole.
+    const std::time_t expired = std::time(NULL) - TARGET_TIMEOUT_SECONDS;
+    // Plans still waiting for their full record stay until they disconnect, and so do targets
+    // with EFS state for the tag items - e.g. prefiled plans in the departure list - until the
+    // backend clears it when the strip goes away.
+    for (int id = targets.Size() - 1; id >= 0; id--) {
+        if (targets.lastSeen[id] < expired && targets.horizon[id] != TargetTable::HORIZON_SUMMARY &&
+            !HasEfsState(id))
+            RemoveTarget(id);
+    }
+}
+
+void VatEFSPlugin::RemoveTarget(int id)
+{
+    if (id == TargetTable::NONE) return;
+    squawks.RemoveSquawking(targets.squawkCode[id]);
+    squawks.RemoveAssigned(targets.assignedSquawkCode[id]);
+    targets.Remove(id);
+}
+
+void VatEFSPlugin::UpdateSquawk(int id, int code)
+{
+    if (targets.squawkCode[id] == code) return;
+    squawks.RemoveSquawking(targets.squawkCode[id]);
+    targets.squawkCode[id] = static_cast<std::int16_t>(code);
+    if (code == SquawkPool::NO_CODE) return;
+    if (squawks.AddSquawking(code) > 1 && SquawkPool::IsDiscrete(code)) PostDuplicateSquawk(code);
+}
+
+void VatEFSPlugin::UpdateAssignedSquawk(int id, int code)
+{
+    if (targets.assignedSquawkCode[id] == code) return;
+    squawks.RemoveAssigned(targets.assignedSquawkCode[id]);
+    targets.assignedSquawkCode[id] = static_cast<std::int16_t>(code);
+    squawks.AddAssigned(code);
+}
+
+void VatEFSPlugin::PostDuplicateSquawk(int code)
+{
+    duplicateSquawks++;
+    if (!subscription.Wants(Subscription::DUPLICATE_SQUAWK)) return;
+    nlohmann::json message = nlohmann::json::object();
+    message["type"] = "duplicateSquawk";
+    message["squawk"] = SquawkPool::Format(code);
+    nlohmann::json callsigns = nlohmann::json::array();
+    for (int id = 0; id < targets.Size(); id++) {
+        if (targets.squawkCode[id] == code) callsigns.push_back(targets.callsign[id].View());
+    }
+    message["callsigns"] = callsigns;
+    DebugMessage("Duplicate squawk " + message["squawk"].get<std::string>() + ": " +
+                 callsigns.dump());
+    PostJson(message, "PostDuplicateSquawk");
+}
+
+bool VatEFSPlugin::AddSquawkRange(const std::string &value)
+{
+    std::istringstream in(value);
+    std::string airport, rules, first, last;
+    if (!(in >> airport >> rules >> first >> last) || rules.size() != 1) return false;
+    for (auto &c : airport)
+        c = (char)std::toupper((unsigned char)c);
+    const char flightRules = (char)std::toupper((unsigned char)rules[0]);
+    return squawks.AddRange(airport, flightRules, SquawkPool::Parse(first),
+                            SquawkPool::Parse(last));
+}
+
+bool VatEFSPlugin::AllocateSquawk(const std::string &callsign)
+{
+    if (squawks.RangeCount() == 0) return false;
+    EuroScopePlugIn::CFlightPlan FlightPlan = FlightPlanSelect(callsign.c_str());
+    if (!FlightPlan.IsValid()) return false;
+    const FlightPlanView &fp = flightPlanCache.Get(FlightPlan, FlightPlanCache::FP_DATA);
+    const char flightRules =
+    fp.flightRules.IsEmpty() ? SquawkPool::ANY_RULES : fp.flightRules.View()[0];
+    if (!squawks.HasRange(fp.origin.View(), flightRules)) return false;
+    const int code = squawks.Allocate(fp.origin.View(), flightRules);
+    if (code == SquawkPool::NO_CODE) {
+        DisplayMessage("No free squawk for " + callsign + " in the ranges for " +
+                       std::string(fp.origin.View()));
+        return false;
+    }
+    const std::string squawk = SquawkPool::Format(code);
+    if (!FlightPlan.GetControllerAssignedData().SetSquawk(squawk.c_str())) {
+        DisplayMessage("Failed to assign squawk " + squawk + " to " + callsign);
+        return true;
+    }
+    DebugMessage("Assigned squawk " + squawk + " to " + callsign);
+    // Taken right away, in case the callback comes later
+    const int id = targets.Find(callsign);
+    if (id != TargetTable::NONE) UpdateAssignedSquawk(id, code);
+    return true;
 }
 
 EuroScopePlugIn::CRadarScreen *VatEFSPlugin::OnRadarScreenCreated(const char *sDisplayName,
@@ -783,6 +1756,9 @@ bool VatEFSPlugin::OnCompileCommand(const char *commandLine)
     } else if (subcommand == "stop") {
         StopBackend();
         return true;
+    } else if (subcommand == "stats") {
+        DisplayStats();
+        return true;
     } else if (subcommand == "status") {
         if (backendProcess == nullptr) {
             DisplayMessage("Backend is not running");
@@ -800,7 +1776,11 @@ bool VatEFSPlugin::OnCompileCommand(const char *commandLine)
 
 void VatEFSPlugin::OnTimer(int counter)
 {
+    AllocScope allocScope(ALLOC_TIMER);
     try {
+        // Values read from EuroScope are cached for one tick at most
+        flightPlanCache.NextTick();
+
         // Poll backend stdout/stderr pipe (msg mode) — runs regardless of connection state
         PollBackendOutput();
 
@@ -827,9 +1807,17 @@ void VatEFSPlugin::OnTimer(int counter)
             disabled = false;
             DebugMessage("EFS updates enabled");
             enabledTime = std::time(NULL);
+            debouncedEmissions = 0;
+            flightPlanCache.esCalls = 0;
+            flightPlanCache.esCallsAvoided = 0;
+            outputBuffers.ResetStats();
+#ifdef VATEFS_ALLOC_ACCOUNTING
+            ResetAllocCounters();
+#endif
             // Initialize Winsock and UDP receive socket
             InitializeWinsock();
             InitializeUdpReceiveSocket();
+            LoadGeofences();
             nlohmann::json message = nlohmann::json::object();
             message["type"] = "connectionTypeUpdate";
             message["connectionType"] = GetConnectionType();
@@ -839,6 +1827,13 @@ void VatEFSPlugin::OnTimer(int counter)
                    GetConnectionType() != EuroScopePlugIn::CONNECTION_TYPE_SWEATBOX) {
             disabled = true;
             DebugMessage("EFS updates disabled");
+            pendingUpdates.clear();
+            flightPlanCache.Clear();
+            flightPlanDetails.clear();
+            extractedRoutes.Clear();
+            backfillQueue.clear();
+            targets.Clear();
+            squawks.Clear();
             nlohmann::json message = nlohmann::json::object();
             message["type"] = "connectionTypeUpdate";
             message["connectionType"] = GetConnectionType();
@@ -853,9 +1848,20 @@ void VatEFSPlugin::OnTimer(int counter)
 
         // Receive UDP messages (non-blocking)
         ReceiveUdpMessages();
+        if (airspaces.NeedsBuild()) BuildAirspaces();
+
+        // Send flight plan updates collected since the last tick
+        FlushPendingUpdates();
+
+        if (counter % 10 == 0) SweepTargets();
+        if (counter % 30 == 0 && (horizonDeparture > 0 || horizonArrival > 0)) SweepHorizon();
+        SweepArrivalMetrics();
+        if (!backfillQueue.empty()) BackfillPositions();
 
         if (std::time(NULL) - enabledTime < 10) return;
         if (counter % 5 == 0) UpdateMyself();
+        // The sector file may not have been loaded when we connected
+        if (counter % 30 == 0 && geofences.RunwayCount() == 0) LoadGeofences();
     } catch (const std::exception &e) {
         DisplayMessage(std::string("OnTimer exception: ") + e.what());
     } catch (...) {
@@ -872,20 +1878,20 @@ void VatEFSPlugin::UpdateMyself()
             return;
         }
 
-        std::string callsign = me.GetCallsign();
-        if (callsign.empty() || callsign.length() > 20) {
+        BoundedString<20> callsign(me.GetCallsign());
+        if (callsign.IsEmpty() || callsign.IsTooLong()) {
             DebugMessage("UpdateMyself: Invalid callsign");
             return;
         }
 
         nlohmann::json message = nlohmann::json::object();
         message["type"] = "myselfUpdate";
-        SetJsonIfValidUtf8(message, "callsign", callsign.c_str());
-        SetJsonWithUtf8Replace(message, "name", me.GetFullName());
+        SetJsonIfValid(message, "callsign", callsign);
+        SetJsonWithUtf8Replace(message, "name", BoundedString<100>(me.GetFullName()));
         message["frequency"] = me.GetPrimaryFrequency();
         message["rating"] = me.GetRating();
         message["facility"] = me.GetFacility();
-        SetJsonIfValidUtf8(message, "sector", me.GetSectorFileName());
+        SetJsonIfValid(message, "sector", BoundedString<_MAX_PATH>(me.GetSectorFileName()));
         message["controller"] = me.IsController();
         message["pluginVersion"] = PLUGIN_VERSION;
 
@@ -903,11 +1909,10 @@ void VatEFSPlugin::UpdateMyself()
              airport = SectorFileElementSelectNext(airport, EuroScopePlugIn::SECTOR_ELEMENT_AIRPORT)) {
 
             airportCount++;
-            const char *airportName = airport.GetName();
-            if (!airportName || !*airportName || strlen(airportName) > 10) continue;
-            if (!IsValidUtf8(airportName)) continue;
+            BoundedString<10> airportName(airport.GetName());
+            if (airportName.IsEmpty() || !airportName.IsValid()) continue;
 
-            std::string airportStr = airportName;
+            std::string airportStr = airportName.Str();
             airportStr.erase(std::remove_if(airportStr.begin(), airportStr.end(), ::isspace),
                              airportStr.end());
             if (airportStr.empty()) continue;
@@ -927,30 +1932,29 @@ void VatEFSPlugin::UpdateMyself()
 
         do {
             runwayCount++;
-            const char *airportName = runway.GetAirportName();
-            if (!airportName || !*airportName || strlen(airportName) > 10) continue;
-            if (!IsValidUtf8(airportName)) continue;
+            BoundedString<10> airportName(runway.GetAirportName());
+            if (airportName.IsEmpty() || !airportName.IsValid()) continue;
 
-            std::string airport = airportName;
+            std::string airport = airportName.Str();
             airport.erase(std::remove_if(airport.begin(), airport.end(), ::isspace), airport.end());
             if (airport.empty()) continue;
 
-            const char *rwyName0 = runway.GetRunwayName(0);
-            const char *rwyName1 = runway.GetRunwayName(1);
+            BoundedString<5> rwyName0(runway.GetRunwayName(0));
+            BoundedString<5> rwyName1(runway.GetRunwayName(1));
 
             // Validate runway names
-            if (rwyName0 && *rwyName0 && strlen(rwyName0) <= 5 && IsValidUtf8(rwyName0)) {
+            if (!rwyName0.IsEmpty() && rwyName0.IsValid()) {
                 if (runway.IsElementActive(false, 0))
-                    message["rwyconfig"][airport][rwyName0]["arr"] = true;
+                    message["rwyconfig"][airport][rwyName0.Str()]["arr"] = true;
                 if (runway.IsElementActive(true, 0))
-                    message["rwyconfig"][airport][rwyName0]["dep"] = true;
+                    message["rwyconfig"][airport][rwyName0.Str()]["dep"] = true;
             }
 
-            if (rwyName1 && *rwyName1 && strlen(rwyName1) <= 5 && IsValidUtf8(rwyName1)) {
+            if (!rwyName1.IsEmpty() && rwyName1.IsValid()) {
                 if (runway.IsElementActive(false, 1))
-                    message["rwyconfig"][airport][rwyName1]["arr"] = true;
+                    message["rwyconfig"][airport][rwyName1.Str()]["arr"] = true;
                 if (runway.IsElementActive(true, 1))
-                    message["rwyconfig"][airport][rwyName1]["dep"] = true;
+                    message["rwyconfig"][airport][rwyName1.Str()]["dep"] = true;
             }
 
             runway = SectorFileElementSelectNext(runway, EuroScopePlugIn::SECTOR_ELEMENT_RUNWAY);
@@ -996,63 +2000,157 @@ bool VatEFSPlugin::UpdateScratchPad(const std::string &inCallsign, const std::st
 
 void VatEFSPlugin::Refresh()
 {
+    extractedRoutes.Clear(); // to be sent again
     for (EuroScopePlugIn::CFlightPlan FlightPlan = FlightPlanSelectFirst(); FlightPlan.IsValid();
          FlightPlan = FlightPlanSelectNext(FlightPlan)) {
-        OnFlightPlanFlightPlanDataUpdate(FlightPlan);
-
-        auto ctrData = FlightPlan.GetControllerAssignedData();
-        nlohmann::json message = nlohmann::json::object();
-        message["type"] = "controllerAssignedDataUpdate";
-        SetJsonIfValidUtf8(message, "callsign", FlightPlan.GetCallsign());
-        const char *squawk = ctrData.GetSquawk();
-        if (squawk && strlen(squawk) == 4) { // Valid squawk is always 4 digits
-            SetJsonIfValidUtf8(message, "squawk", squawk);
-        }
-        int rfl = ctrData.GetFinalAltitude();
-        if (rfl >= 0 && rfl <= 100000) { // Reasonable altitude range
-            message["rfl"] = rfl;
-        }
-        int cfl = ctrData.GetClearedAltitude();
-        message["cfl"] = cfl;
-        if (cfl == 1 || cfl == 2) {
-            message["ahdg"] = 0;
-            message["direct"] = "";
-        }
-        SetJsonIfValidUtf8(message, "scratch", ctrData.GetScratchPadString());
-        SetJsonIfValidUtf8(message, "groundstate", FlightPlan.GetGroundState());
-        message["clearance"] = (bool)FlightPlan.GetClearenceFlag();
-        int speed = ctrData.GetAssignedSpeed();
-        if (speed >= 0 && speed <= 1500) { // Reasonable speed range
-            message["asp"] = speed;
-        }
-        double mach = ctrData.GetAssignedMach();
-        if (mach >= 0.0 && mach <= 10.0) { // Reasonable mach range
-            message["mach"] = mach;
-        }
-        int rate = ctrData.GetAssignedRate();
-        if (rate >= -50000 && rate <= 50000) { // Reasonable rate range
-            message["arc"] = rate;
-        }
-        int heading = ctrData.GetAssignedHeading();
-        if (heading >= 0 && heading <= 360) { // Valid heading range
-            message["ahdg"] = heading;
-            message["direct"] = "";
-        }
-        const char *directTo = ctrData.GetDirectToPointName();
-        if (directTo && strlen(directTo) < 50) { // Reasonable waypoint name length
-            SetJsonIfValidUtf8(message, "direct", directTo);
-            if (strlen(directTo) > 0) message["ahdg"] = 0;
+        // Everything is sent below, so a pending flight plan data update is redundant. Pending
+        // controller data may hold scratch pad events though, which are sent first.
+        auto pending = pendingUpdates.find(FlightPlan.GetCallsign());
+        if (pending != pendingUpdates.end()) {
+            if (pending->second.flightPlanData) debouncedEmissions++;
+            if (!pending->second.controllerData.is_null())
+                PostPendingControllerData(pending->first, pending->second);
+            pendingUpdates.erase(pending);
+        }
+        PostFlightPlanData(FlightPlan);
+
+        const FlightPlanView &fp =
+        flightPlanCache.Get(FlightPlan, FlightPlanCache::CORE | FlightPlanCache::CTR_DATA);
+        // Resolve the heading/direct interplay first, each key is written once
+        bool hasAhdg = false, hasDirect = false;
+        int ahdg = 0;
+        std::string_view direct;
+        if (fp.cfl == 1 || fp.cfl == 2) {
+            hasAhdg = hasDirect = true;
+        }
+        if (fp.ahdg >= 0 && fp.ahdg <= 360) { // Valid heading range
+            hasAhdg = hasDirect = true;
+            ahdg = fp.ahdg;
+            direct = {};
+        }
+        if (!fp.direct.IsTooLong()) { // Reasonable waypoint name length
+            if (fp.direct.IsValid()) {
+                hasDirect = true;
+                direct = fp.direct.View();
+            }
+            if (!fp.direct.IsEmpty()) {
+                hasAhdg = true;
+                ahdg = 0;
+            }
         }
-        PostJson(message, "Refresh");
+
+        if (!subscription.Wants(Subscription::CONTROLLER_DATA)) continue;
+        PooledBuffer buffer = outputBuffers.Acquire(OutputBufferPool::SMALL);
+        std::string &line = buffer.Str();
+        JsonWriter message(line);
+        message.Exclude(subscription.ExcludedFields());
+        message.BeginObject();
+        message.String("type", "controllerAssignedDataUpdate");
+        message.String("callsign", fp.callsign);
+        if (fp.squawk.Length() == 4) { // Valid squawk is always 4 digits
+            message.String("squawk", fp.squawk);
+        }
+        if (fp.rfl >= 0 && fp.rfl <= 100000) { // Reasonable altitude range
+            message.Int("rfl", fp.rfl);
+        }
+        message.Int("cfl", fp.cfl);
+        message.String("scratch", fp.scratch);
+        message.String("groundstate", fp.groundState);
+        message.Bool("clearance", fp.clearance);
+        if (fp.asp >= 0 && fp.asp <= 1500) { // Reasonable speed range
+            message.Int("asp", fp.asp);
+        }
+        if (fp.mach >= 0.0 && fp.mach <= 10.0) { // Reasonable mach range
+            message.Double("mach", fp.mach);
+        }
+        if (fp.arc >= -50000 && fp.arc <= 50000) { // Reasonable rate range
+            message.Int("arc", fp.arc);
+        }
+        if (hasAhdg) message.Int("ahdg", ahdg);
+        if (hasDirect) message.String("direct", direct);
+        message.EndObject();
+        PostLine(line, "Refresh");
+    }
+    for (int id = 0; id < targets.Size(); id++) {
+        targets.positionSentTime[id] = 0; // not throttled
+        // Geofence events are only sent on changes, so resend the current state
+        if (targets.runwayFence[id] != GeofenceIndex::NONE)
+            PostGeofenceEvent("enteredRunway", "runway", id, targets.runwayFence[id]);
+        if (targets.standFence[id] != GeofenceIndex::NONE)
+            PostGeofenceEvent("onStand", "stand", id, targets.standFence[id]);
+        if (targets.airspace[id] != AirspaceIndex::NONE)
+            PostAirspaceEvent("airspaceEnter", id, targets.airspace[id]);
+        targets.movementState[id] = MOVEMENT_UNKNOWN; // sent again with the next position
     }
+    backfillQueue.clear();
     for (EuroScopePlugIn::CRadarTarget RadarTarget = RadarTargetSelectFirst();
          RadarTarget.IsValid(); RadarTarget = RadarTargetSelectNext(RadarTarget)) {
         OnRadarTargetPositionUpdate(RadarTarget);
+        // Only targets with a flight plan that passes the filter and is subscribed to, the rest
+        // are of no interest. Every target in range is in the table after the update above.
+        const int id = targets.Find(RadarTarget.GetCallsign());
+        EuroScopePlugIn::CFlightPlan correlated = RadarTarget.GetCorrelatedFlightPlan();
+        if (id != TargetTable::NONE && correlated.IsValid() && FilterFlightPlan(correlated) &&
+            WantsTarget(id, correlated))
+            backfillQueue.emplace_back(RadarTarget.GetCallsign());
     }
     for (EuroScopePlugIn::CController Controller = ControllerSelectFirst(); Controller.IsValid();
          Controller = ControllerSelectNext(Controller)) {
         OnControllerPositionUpdate(Controller);
     }
+    for (const auto &[station, stored] : metars)
+        PostMetar(station);
+}
+
+void VatEFSPlugin::DisplayStats()
+{
+    DisplayMessage("Debounced flight plan emissions: " + std::to_string(debouncedEmissions));
+    DisplayMessage("Squawks: " + std::to_string(squawks.InUseCount()) + " codes in use, " +
+                   std::to_string(duplicateSquawks) + " duplicates, " +
+                   std::to_string(squawks.RangeCount()) + " ranges");
+    DisplayMessage("METARs: " + std::to_string(metars.size()) + " stations, " +
+                   std::to_string(metarsForwarded) + " forwarded, " +
+                   std::to_string(metarsUnchanged) + " unchanged");
+    DisplayMessage("EuroScope flight plan calls: " + std::to_string(flightPlanCache.esCalls) +
+                   " made, " + std::to_string(flightPlanCache.esCallsAvoided) + " served from cache");
+    DisplayMessage("Targets: " + std::to_string(targets.Size()) + " (" +
+                   std::to_string(targets.HashCapacity()) + " hash slots)");
+    std::size_t historyBytes = 0, historyLargest = 0;
+    for (int id = 0; id < targets.Size(); id++) {
+        const std::size_t bytes = targets.history[id].MemoryUsage();
+        historyBytes += bytes;
+        historyLargest = std::max(historyLargest, bytes);
+    }
+    DisplayMessage("Track history: " + std::to_string(historyBytes / 1024) + " kB, " +
+                   std::to_string(targets.Size() ? historyBytes / targets.Size() : 0) +
+                   " bytes per target, largest " + std::to_string(historyLargest));
+    DisplayMessage("Geofences: " + std::to_string(geofences.RunwayCount()) + " runways, " +
+                   std::to_string(geofences.StandCount()) + " stands");
+    DisplayMessage("Airspaces: " + std::to_string(airspaces.Count()) + " zones in " +
+                   std::to_string(airspaces.CellCount()) + " cells");
+    for (const Destination &destination : destinations) {
+        DisplayMessage("Destination " + destination.name + ": " + std::to_string(destination.sent) +
+                       " sent, " + std::to_string(destination.dropped) + " dropped, " +
+                       std::to_string(destination.filtered) + " filtered" +
+                       (destination.consecutiveErrors > 0 ? ", " + destination.lastError : ""));
+    }
+    DisplayMessage("Extracted routes: " + std::to_string(extractedRoutes.Count()) + " with " +
+                   std::to_string(extractedRoutes.NameCount()) + " distinct names");
+    static const char *const classNames[] = { "small", "medium", "large" };
+    for (int i = 0; i < OutputBufferPool::SIZE_CLASSES; i++) {
+        const auto &s = outputBuffers.Stats(OutputBufferPool::SizeClass(i));
+        DisplayMessage("Output buffers (" + std::string(classNames[i]) + "): " +
+                       std::to_string(s.acquired) + " used, " + std::to_string(s.allocated) +
+                       " allocated, high-water " + std::to_string(s.highWater) + ", largest " +
+                       std::to_string(s.largest) + " bytes");
+    }
+#ifdef VATEFS_ALLOC_ACCOUNTING
+    const AllocCounters &allocs = GetAllocCounters();
+    for (int i = ALLOC_RADAR; i < ALLOC_ENTRY_POINTS; i++) {
+        DisplayMessage("Allocations in " + std::string(AllocEntryPointName(AllocEntryPoint(i))) + ": " +
+                       std::to_string(allocs.allocations[i]) + " in " + std::to_string(allocs.calls[i]) + " calls");
+    }
+#endif
 }
 
 void VatEFSPlugin::DebugMessage(const std::string &message, const std::string &sender)
@@ -1070,16 +2168,14 @@ bool VatEFSPlugin::FilterFlightPlan(EuroScopePlugIn::CFlightPlan FlightPlan)
     try {
         if (!FlightPlan.IsValid()) return false;
 
-        EuroScopePlugIn::CFlightPlanData fpData = FlightPlan.GetFlightPlanData();
-        if (!fpData.IsReceived()) return false;
-
-        const char *origin = fpData.GetOrigin();
-        const char *destination = fpData.GetDestination();
-        if (!origin || !destination || !*origin || !*destination) return false;
+        const FlightPlanView &fp = flightPlanCache.Get(FlightPlan, FlightPlanCache::FP_DATA);
+        if (!fp.received) return false;
 
         // Safe string comparison with length check
-        if (strlen(origin) < 2 || strlen(destination) < 2) return false;
-        if (strncmp(origin, "ES", 2) != 0 && strncmp(destination, "ES", 2) != 0) return false;
+        if (fp.origin.Length() < 2 || fp.destination.Length() < 2) return false;
+        if (!fp.origin.View().starts_with("ES") && !fp.destination.View().starts_with("ES")) return false;
+        if (!subscription.WantsFlight(fp.callsign.View(), fp.origin.View(), fp.destination.View()))
+            return false;
 
         return true;
     } catch (...) {
@@ -1088,6 +2184,65 @@ bool VatEFSPlugin::FilterFlightPlan(EuroScopePlugIn::CFlightPlan FlightPlan)
     }
 }
 
+bool VatEFSPlugin::WantsTarget(int id, EuroScopePlugIn::CFlightPlan FlightPlan)
+{
+    if (!subscription.HasFlightFilter()) return true;
+    if (targets.subscribed[id] == TargetTable::VERDICT_UNKNOWN) {
+        bool wants;
+        if (FlightPlan.IsValid()) {
+            const FlightPlanView &fp = flightPlanCache.Get(FlightPlan, FlightPlanCache::FP_DATA);
+            wants = subscription.WantsFlight(targets.callsign[id].View(), fp.origin.View(),
+                                             fp.destination.View());
+        } else {
+            wants = subscription.WantsFlight(targets.callsign[id].View(), {}, {});
+        }
+        targets.subscribed[id] = wants ? TargetTable::VERDICT_PASS : TargetTable::VERDICT_REJECT;
+    }
+    return targets.subscribed[id] == TargetTable::VERDICT_PASS;
+}
+
+bool VatEFSPlugin::WantsTarget(int id) const
+{
+    // Decided by the target's radar updates, so unknown only until its first one after a change
+    return targets.subscribed[id] != TargetTable::VERDICT_REJECT;
+}
+
+void VatEFSPlugin::ApplySubscription(const nlohmann::json &message)
+{
+    auto list = [&](const char *key) {
+        return message.value(key, std::vector<std::string>());
+    };
+    Subscription requested;
+    for (const std::string &type : requested.SetTypes(list("types")))
+        DisplayMessage("Subscription: Unknown message type " + type);
+    requested.SetAirports(list("airports"));
+    requested.SetCallsigns(list("callsigns"));
+    requested.SetStations(list("stations"));
+    requested.SetExcludedFields(list("excludeFields"));
+
+    // For the destination listening on port, or all of them
+    const int port = message.value("port", 0);
+    bool found = false;
+    for (Destination &destination : destinations) {
+        if (port != 0 && destination.port != port) continue;
+        destination.subscription = requested;
+        found = true;
+    }
+    if (!found) {
+        DisplayMessage("Subscription: No destination with port " + std::to_string(port));
+        return;
+    }
+    // What is built is what any destination wants, PostLine filters the types per destination
+    subscription = destinations.front().subscription;
+    for (std::size_t i = 1; i < destinations.size(); i++)
+        subscription.Merge(destinations[i].subscription);
+    std::fill(targets.subscribed.begin(), targets.subscribed.end(), TargetTable::VERDICT_UNKNOWN);
+    // The stations may have changed, and the next METARs could be a while
+    for (const auto &[station, stored] : metars)
+        PostMetar(station);
+    DebugMessage("Subscription updated");
+}
+
 void VatEFSPlugin::InitializeWinsock()
 {
     if (winsockInitialized) return;
@@ -1140,6 +2295,10 @@ void VatEFSPlugin::InitializeUdpReceiveSocket()
             return;
         }
 
+        // Room for the burst of airspace messages between two timer ticks (not fatal if refused)
+        int receiveBufferSize = 1 << 20;
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char *)&receiveBufferSize, sizeof(receiveBufferSize));
+
         // Set up local address (127.0.0.1:17772)
         sockaddr_in localAddr;
         memset(&localAddr, 0, sizeof(localAddr));
@@ -1202,13 +2361,202 @@ static bool IsSidPattern(const std::string &s)
     return true;
 }
 
+// Splits the route at its first space
+static void SplitFirstTerm(const std::string &route, std::string &firstTerm, std::string &rest)
+{
+    auto spacePos = route.find(' ');
+    if (spacePos != std::string::npos) {
+        firstTerm = route.substr(0, spacePos);
+        rest = route.substr(spacePos + 1);
+    } else {
+        firstTerm = route;
+        rest.clear();
+    }
+}
+
+// The route with the departure runway in its first term (SID/rwy or airport/rwy)
+static std::string RouteWithDepartureRunway(const std::string &route,
+                                            const std::string &departureAirport,
+                                            const std::string &runway)
+{
+    std::string firstTerm;
+    std::string restOfRoute;
+    SplitFirstTerm(route, firstTerm, restOfRoute);
+
+    std::string newRoute;
+    auto slashPos = firstTerm.find('/');
+    if (slashPos != std::string::npos) {
+        // Already has SID/rwy or airport/rwy prefix - keep prefix, change runway
+        newRoute = firstTerm.substr(0, slashPos) + "/" + runway;
+        if (!restOfRoute.empty()) newRoute += " " + restOfRoute;
+    } else if (IsSidPattern(firstTerm)) {
+        // Pilot-filed SID - remove it, prepend airport/runway
+        newRoute = departureAirport + "/" + runway;
+        if (!restOfRoute.empty()) newRoute += " " + restOfRoute;
+    } else {
+        // No prefix - prepend airport/runway before the full original route
+        newRoute = departureAirport + "/" + runway;
+        if (!route.empty()) newRoute += " " + route;
+    }
+    return newRoute;
+}
+
+// The route with the SID in its first term, keeping the runway there or currentRwy
+static std::string RouteWithSid(const std::string &route,
+                                const std::string &currentRwy,
+                                const std::string &sid)
+{
+    std::string firstTerm;
+    std::string restOfRoute;
+    SplitFirstTerm(route, firstTerm, restOfRoute);
+
+    std::string newRoute;
+    auto slashPos = firstTerm.find('/');
+    if (slashPos != std::string::npos) {
+        // Already has SID/rwy or airport/rwy prefix - keep runway, change SID
+        std::string existingRwy = firstTerm.substr(slashPos + 1);
+        newRoute = sid + "/" + existingRwy;
+        if (!restOfRoute.empty()) newRoute += " " + restOfRoute;
+    } else if (IsSidPattern(firstTerm)) {
+        // Pilot-filed SID - replace with new SID/runway
+        newRoute = sid + "/" + currentRwy;
+        if (!restOfRoute.empty()) newRoute += " " + restOfRoute;
+    } else {
+        // No prefix - prepend SID/runway before the full original route
+        newRoute = sid + "/" + currentRwy;
+        if (!route.empty()) newRoute += " " + route;
+    }
+    return newRoute;
+}
+
+// The route with the arrival runway in its last term (STAR/rwy or airport/rwy)
+static std::string RouteWithArrivalRunway(const std::string &route,
+                                          const std::string &arrivalAirport,
+                                          const std::string &star,
+                                          const std::string &runway)
+{
+    // Extract the last term and the rest of the route before it
+    std::string lastTerm;
+    std::string routeBeforeLast;
+    auto lastSpacePos = route.rfind(' ');
+    if (lastSpacePos != std::string::npos) {
+        lastTerm = route.substr(lastSpacePos + 1);
+        routeBeforeLast = route.substr(0, lastSpacePos);
+    } else {
+        lastTerm = route;
+    }
+
+    std::string suffix;
+    if (!star.empty()) {
+        suffix = star + "/" + runway;
+    } else {
+        suffix = arrivalAirport + "/" + runway;
+    }
+
+    std::string newRoute;
+    auto slashPos = lastTerm.find('/');
+    if (slashPos != std::string::npos) {
+        // Last term already has STAR/rwy or airport/rwy - replace it
+        newRoute = routeBeforeLast;
+        if (!newRoute.empty()) newRoute += " ";
+        newRoute += suffix;
+    } else {
+        // No suffix - append after the full original route
+        newRoute = route;
+        if (!newRoute.empty()) newRoute += " ";
+        newRoute += suffix;
+    }
+    return newRoute;
+}
+
+void VatEFSPlugin::Amend(const nlohmann::json &message)
+{
+    std::string callsign = message.value("callsign", "");
+    for (auto &c : callsign)
+        c = (char)std::toupper((unsigned char)c);
+    auto fp = FlightPlanSelect(callsign.c_str());
+    if (!fp.IsValid()) {
+        DisplayMessage("amend: Flight plan not found: " + callsign);
+        return;
+    }
+    std::stringstream out;
+    out << "amend " << callsign;
+
+    // Flight plan data is changed on one copy and sent as one amendment, so there is one network
+    // update and one round of callbacks however many fields change
+    EuroScopePlugIn::CFlightPlanData fpData = fp.GetFlightPlanData();
+    bool amended = false;
+    if (message.contains("departureRunway") || message.contains("sid") ||
+        message.contains("arrivalRunway")) {
+        const char *routeStr = fpData.GetRoute();
+        std::string route = routeStr ? routeStr : "";
+        // Each edit works on the route from the one before
+        if (message.contains("departureRunway")) {
+            const char *origin = fpData.GetOrigin();
+            route = RouteWithDepartureRunway(route, origin ? origin : "",
+                                             message["departureRunway"].get<std::string>());
+        }
+        if (message.contains("sid")) {
+            const char *depRwy = fpData.GetDepartureRwy();
+            route = RouteWithSid(route, depRwy ? depRwy : "", message["sid"].get<std::string>());
+        }
+        if (message.contains("arrivalRunway")) {
+            const char *dest = fpData.GetDestination();
+            const char *starName = fpData.GetStarName();
+            route = RouteWithArrivalRunway(route, dest ? dest : "", starName ? starName : "",
+                                           message["arrivalRunway"].get<std::string>());
+        }
+        std::string ansiRoute = Utf8ToAnsi(route);
+        out << " route " << ansiRoute;
+        fpData.SetRoute(ansiRoute.c_str());
+        amended = true;
+    }
+    if (message.contains("rfl")) {
+        const int rfl = message["rfl"].get<int>();
+        out << " rfl " << rfl;
+        fpData.SetFinalAltitude(rfl);
+        amended = true;
+    }
+    if (amended && !fpData.AmendFlightPlan()) DisplayMessage("amend: Failed to amend " + callsign);
+
+    // Controller assigned data has no amendment of its own, each setter takes effect by itself
+    EuroScopePlugIn::CFlightPlanControllerAssignedData ctrData = fp.GetControllerAssignedData();
+    std::string failed;
+    if (message.contains("cfl")) {
+        const int cfl = message["cfl"].get<int>();
+        out << " cfl " << cfl;
+        if (!ctrData.SetClearedAltitude(cfl)) failed += " cfl";
+    }
+    if (message.contains("heading")) {
+        const int heading = message["heading"].get<int>();
+        out << " heading " << heading;
+        if (!ctrData.SetAssignedHeading(heading)) failed += " heading";
+    }
+    if (message.contains("squawk")) {
+        const std::string squawk = message["squawk"].get<std::string>();
+        out << " squawk " << squawk;
+        if (!ctrData.SetSquawk(squawk.c_str())) failed += " squawk";
+    }
+    DebugMessage(out.str());
+    if (!failed.empty()) DisplayMessage("amend: Failed to set" + failed + " for " + callsign);
+}
+
 void VatEFSPlugin::ReceiveUdpMessages()
 {
-    if (udpReceiveSocket == nullptr) return;
+    AllocScope allocScope(ALLOC_INBOUND);
+    // Everything that arrived since the last tick, the backend sends airspaces in bursts
+    for (int i = 0; i < MAX_UDP_MESSAGES_PER_TICK; i++) {
+        if (!ReceiveUdpMessage()) break;
+    }
+}
+
+bool VatEFSPlugin::ReceiveUdpMessage()
+{
+    if (udpReceiveSocket == nullptr) return false;
 
     try {
         SOCKET sock = reinterpret_cast<SOCKET>(udpReceiveSocket);
-        char buffer[4096];
+        static char buffer[65536]; // the largest possible datagram, airspace polygons can be big
         sockaddr_in fromAddr;
         int fromAddrLen = sizeof(fromAddr);
 
@@ -1219,11 +2567,11 @@ void VatEFSPlugin::ReceiveUdpMessages()
             int error = WSAGetLastError();
             if (error == WSAEWOULDBLOCK || error == WSAECONNRESET) {
                 // No data available or connection reset, this is normal
-                return;
+                return false;
             } else {
                 // Real error occurred
                 DisplayMessage("UDP receive error: " + std::to_string(error));
-                return;
+                return false;
             }
         }
 
@@ -1365,7 +2713,11 @@ void VatEFSPlugin::ReceiveUdpMessages()
                 } else if (message["type"] == "resetSquawk") {
                     auto callsign = message["callsign"].get<std::string>();
                     DebugMessage("resetSquawk: " + callsign);
-                    if (dummyRadarScreens.size() > 0) {
+                    for (auto &c : callsign)
+                        c = (char)std::toupper((unsigned char)c);
+                    if (AllocateSquawk(callsign)) {
+                        // From the squawkrange settings, TopSky is not needed
+                    } else if (dummyRadarScreens.size() > 0) {
                         dummyRadarScreens[0]->AllocateSSR(callsign.c_str());
                     } else {
                         DisplayMessage(
@@ -1393,35 +2745,9 @@ void VatEFSPlugin::ReceiveUdpMessages()
                     } else {
                         auto fpData = fp.GetFlightPlanData();
                         const char *routeStr = fpData.GetRoute();
-                        std::string route = routeStr ? routeStr : "";
                         const char *origin = fpData.GetOrigin();
-                        std::string departureAirport = origin ? origin : "";
-
-                        std::string firstTerm;
-                        std::string restOfRoute;
-                        auto spacePos = route.find(' ');
-                        if (spacePos != std::string::npos) {
-                            firstTerm = route.substr(0, spacePos);
-                            restOfRoute = route.substr(spacePos + 1);
-                        } else {
-                            firstTerm = route;
-                        }
-
-                        std::string newRoute;
-                        auto slashPos = firstTerm.find('/');
-                        if (slashPos != std::string::npos) {
-                            // Already has SID/rwy or airport/rwy prefix - keep prefix, change runway
-                            newRoute = firstTerm.substr(0, slashPos) + "/" + runway;
-                            if (!restOfRoute.empty()) newRoute += " " + restOfRoute;
-                        } else if (IsSidPattern(firstTerm)) {
-                            // Pilot-filed SID - remove it, prepend airport/runway
-                            newRoute = departureAirport + "/" + runway;
-                            if (!restOfRoute.empty()) newRoute += " " + restOfRoute;
-                        } else {
-                            // No prefix - prepend airport/runway before the full original route
-                            newRoute = departureAirport + "/" + runway;
-                            if (!route.empty()) newRoute += " " + route;
-                        }
+                        std::string newRoute = RouteWithDepartureRunway(
+                        routeStr ? routeStr : "", origin ? origin : "", runway);
                         std::string ansiRoute = Utf8ToAnsi(newRoute);
                         DebugMessage("assignDepartureRunway: new route: " + ansiRoute);
                         fpData.SetRoute(ansiRoute.c_str());
@@ -1439,36 +2765,9 @@ void VatEFSPlugin::ReceiveUdpMessages()
                     } else {
                         auto fpData = fp.GetFlightPlanData();
                         const char *routeStr = fpData.GetRoute();
-                        std::string route = routeStr ? routeStr : "";
                         const char *depRwy = fpData.GetDepartureRwy();
-                        std::string currentRwy = depRwy ? depRwy : "";
-
-                        std::string firstTerm;
-                        std::string restOfRoute;
-                        auto spacePos = route.find(' ');
-                        if (spacePos != std::string::npos) {
-                            firstTerm = route.substr(0, spacePos);
-                            restOfRoute = route.substr(spacePos + 1);
-                        } else {
-                            firstTerm = route;
-                        }
-
-                        std::string newRoute;
-                        auto slashPos = firstTerm.find('/');
-                        if (slashPos != std::string::npos) {
-                            // Already has SID/rwy or airport/rwy prefix - keep runway, change SID
-                            std::string existingRwy = firstTerm.substr(slashPos + 1);
-                            newRoute = sid + "/" + existingRwy;
-                            if (!restOfRoute.empty()) newRoute += " " + restOfRoute;
-                        } else if (IsSidPattern(firstTerm)) {
-                            // Pilot-filed SID - replace with new SID/runway
-                            newRoute = sid + "/" + currentRwy;
-                            if (!restOfRoute.empty()) newRoute += " " + restOfRoute;
-                        } else {
-                            // No prefix - prepend SID/runway before the full original route
-                            newRoute = sid + "/" + currentRwy;
-                            if (!route.empty()) newRoute += " " + route;
-                        }
+                        std::string newRoute =
+                        RouteWithSid(routeStr ? routeStr : "", depRwy ? depRwy : "", sid);
                         std::string ansiRoute = Utf8ToAnsi(newRoute);
                         DebugMessage("assignSid: new route: " + ansiRoute);
                         fpData.SetRoute(ansiRoute.c_str());
@@ -1486,43 +2785,11 @@ void VatEFSPlugin::ReceiveUdpMessages()
                     } else {
                         auto fpData = fp.GetFlightPlanData();
                         const char *routeStr = fpData.GetRoute();
-                        std::string route = routeStr ? routeStr : "";
                         const char *dest = fpData.GetDestination();
-                        std::string arrivalAirport = dest ? dest : "";
                         const char *starName = fpData.GetStarName();
-                        std::string star = starName ? starName : "";
-
-                        // Extract the last term and the rest of the route before it
-                        std::string lastTerm;
-                        std::string routeBeforeLast;
-                        auto lastSpacePos = route.rfind(' ');
-                        if (lastSpacePos != std::string::npos) {
-                            lastTerm = route.substr(lastSpacePos + 1);
-                            routeBeforeLast = route.substr(0, lastSpacePos);
-                        } else {
-                            lastTerm = route;
-                        }
-
-                        std::string suffix;
-                        if (!star.empty()) {
-                            suffix = star + "/" + runway;
-                        } else {
-                            suffix = arrivalAirport + "/" + runway;
-                        }
-
-                        std::string newRoute;
-                        auto slashPos = lastTerm.find('/');
-                        if (slashPos != std::string::npos) {
-                            // Last term already has STAR/rwy or airport/rwy - replace it
-                            newRoute = routeBeforeLast;
-                            if (!newRoute.empty()) newRoute += " ";
-                            newRoute += suffix;
-                        } else {
-                            // No suffix - append after the full original route
-                            newRoute = route;
-                            if (!newRoute.empty()) newRoute += " ";
-                            newRoute += suffix;
-                        }
+                        std::string newRoute =
+                        RouteWithArrivalRunway(routeStr ? routeStr : "", dest ? dest : "",
+                                               starName ? starName : "", runway);
                         std::string ansiRoute = Utf8ToAnsi(newRoute);
                         DebugMessage("assignArrivalRunway: new route: " + ansiRoute);
                         fpData.SetRoute(ansiRoute.c_str());
@@ -1554,6 +2821,8 @@ void VatEFSPlugin::ReceiveUdpMessages()
                         bool ok = fp.GetControllerAssignedData().SetClearedAltitude(altitude);
                         if (!ok) DisplayMessage("assignCfl: Failed for " + callsign);
                     }
+                } else if (message["type"] == "amend") {
+                    Amend(message);
                 } else if (message["type"] == "createFlightPlan") {
                     auto callsign = message["callsign"].get<std::string>();
                     auto stripType = message["stripType"].get<std::string>();
@@ -1656,6 +2925,26 @@ void VatEFSPlugin::ReceiveUdpMessages()
                     } else {
                         DebugMessage("createFlightPlan: No flight plan or radar target for " + callsign + ", cannot amend");
                     }
+                } else if (message["type"] == "getTrack") {
+                    auto callsign = message["callsign"].get<std::string>();
+                    const std::time_t now = std::time(NULL);
+                    PostTrackHistory(callsign, message.value("from", now - TrackHistory::WINDOW_SECONDS),
+                                     message.value("to", now));
+                } else if (message["type"] == "efsState") {
+                    ApplyEfsState(message);
+                } else if (message["type"] == "subscribe") {
+                    ApplySubscription(message);
+                } else if (message["type"] == "getFlightPlanDetail") {
+                    PostFlightPlanDetail(message["callsign"].get<std::string>());
+                } else if (message["type"] == "airspace") {
+                    std::vector<GeoPoint> points;
+                    for (const auto &point : message["points"])
+                        points.push_back({ point[0].get<double>(), point[1].get<double>() });
+                    airspaces.Add(message["name"].get<std::string>(), message.value("airport", ""),
+                                  message.value("lowerFt", AirspaceIndex::SURFACE),
+                                  message["upperFt"].get<int>(), points);
+                } else if (message["type"] == "clearAirspaces") {
+                    airspaces.Clear();
                 } else {
                     DisplayMessage("Unknown message type: " + message["type"].get<std::string>());
                 }
@@ -1666,35 +2955,6 @@ void VatEFSPlugin::ReceiveUdpMessages()
     } catch (...) {
         DisplayMessage("ReceiveUdpMessages: Unknown exception");
     }
-}
-
-bool VatEFSPlugin::IsValidUtf8(const char *str)
-{
-    if (!str) return true; // null: caller typically skips
-    const unsigned char *p = reinterpret_cast<const unsigned char *>(str);
-    while (*p) {
-        unsigned char c = *p++;
-        if (c <= 0x7F) continue;
-        if (c >= 0xC2 && c <= 0xDF) {
-            if ((*p++ & 0xC0) != 0x80) return false;
-            continue;
-        }
-        if (c >= 0xE0 && c <= 0xEF) {
-            if ((*p & 0xC0) != 0x80) return false;
-            p++;
-            if ((*p++ & 0xC0) != 0x80) return false;
-            continue;
-        }
-        if (c >= 0xF0 && c <= 0xF4) {
-            if ((*p & 0xC0) != 0x80) return false;
-            p++;
-            if ((*p & 0xC0) != 0x80) return false;
-            p++;
-            if ((*p++ & 0xC0) != 0x80) return false;
-            continue;
-        }
-        return false; // invalid lead byte (0x80-0xBF, 0xC0-0xC1, 0xF5-0xFF)
-    }
     return true;
 }
 
@@ -1759,92 +3019,125 @@ std::string VatEFSPlugin::SanitizeUtf8(const char *str)
     return result;
 }
 
-void VatEFSPlugin::SetJsonIfValidUtf8(nlohmann::json &j, const char *key, const char *value)
+void VatEFSPlugin::PostJson(const nlohmann::json &jsonData, const char *whereaboutsInDaCode)
 {
-    if (value) {
-        if (IsValidUtf8(value)) {
-            j[key] = value;
-        } else {
-            DebugMessage("SetJsonIfValidUtf8: Invalid UTF-8 string in key " + std::string(key));
-        }
+    PooledBuffer buffer = outputBuffers.Acquire(OutputBufferPool::LARGE);
+    try {
+        // Same as dump(), but into the pooled buffer instead of a new string
+        nlohmann::detail::serializer<nlohmann::json> serializer(
+        nlohmann::detail::output_adapter<char, std::string>(buffer.Str()), ' ');
+        serializer.dump(jsonData, false, false, 0);
+    } catch (const std::exception &e) {
+        DisplayMessage("PostJson: Exception at " + std::string(whereaboutsInDaCode) + ": " + e.what());
+        return;
     }
+    PostLine(buffer.Str(), whereaboutsInDaCode);
 }
 
-void VatEFSPlugin::SetJsonWithUtf8Replace(nlohmann::json &j, const char *key, const char *value)
+bool VatEFSPlugin::AddDestination(const std::string &hostAndPort)
 {
-    if (value) {
-        j[key] = SanitizeUtf8(value);
-    }
+    const std::size_t colon = hostAndPort.rfind(':');
+    if (colon == std::string::npos) return false;
+    const unsigned long address = inet_addr(hostAndPort.substr(0, colon).c_str());
+    const int port = std::atoi(hostAndPort.c_str() + colon + 1);
+    if (address == INADDR_NONE || port <= 0 || port > 65535) return false;
+    Destination destination;
+    destination.name = hostAndPort;
+    destination.address = address;
+    destination.port = static_cast<unsigned short>(port);
+    destinations.push_back(std::move(destination));
+    return true;
 }
 
-void VatEFSPlugin::PostJson(const nlohmann::json &jsonData, const char *whereaboutsInDaCode)
+void VatEFSPlugin::CloseSendSocket()
 {
-    std::stringstream err;
-    SOCKET sock = INVALID_SOCKET;
+    if (sendSocket == nullptr) return;
+    closesocket((SOCKET)sendSocket);
+    sendSocket = nullptr;
+    WSACleanup(); // the one from opening it
+}
 
+void VatEFSPlugin::PostLine(std::string &line, const char *whereaboutsInDaCode)
+{
     try {
-        // Initialize Winsock
-        WSADATA wsaData;
-        int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
-        if (result != 0) {
-            err << "WSAStartup failed: " << result;
-            connectionError = err.str();
-            return;
-        }
-
-        // Create UDP socket
-        sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-        if (sock == INVALID_SOCKET) {
-            err << "Socket creation failed: " << WSAGetLastError();
-            connectionError = err.str();
-            WSACleanup();
-            return;
+        if (sendSocket == nullptr) {
+            // Its own WSAStartup, as the receiving side's is cleaned up when disconnected
+            WSADATA wsaData;
+            int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
+            if (result != 0) {
+                connectionError = "WSAStartup failed: " + std::to_string(result);
+                DisplayMessage(std::string("PostLine: ") + connectionError);
+                return;
+            }
+            SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            if (sock == INVALID_SOCKET) {
+                connectionError = "Socket creation failed: " + std::to_string(WSAGetLastError());
+                DisplayMessage(std::string("PostLine: ") + connectionError);
+                WSACleanup();
+                return;
+            }
+            sendSocket = (void *)sock;
+        }
+
+        // With several destinations, each may have subscribed to other types than the rest
+        Subscription::MessageType type = Subscription::FLIGHT_PLAN_DATA;
+        bool filterable = false;
+        if (destinations.size() > 1) {
+            static constexpr std::string_view TYPE_KEY = "\"type\":\"";
+            const std::size_t start = line.find(TYPE_KEY);
+            if (start != std::string::npos) {
+                const std::size_t name = start + TYPE_KEY.size();
+                const std::size_t end = line.find('"', name);
+                filterable = end != std::string::npos &&
+                             Subscription::TypeOf(std::string_view(line).substr(name, end - name), type);
+            }
         }
 
-        // Set up destination address (127.0.0.1:17771)
-        sockaddr_in destAddr;
-        memset(&destAddr, 0, sizeof(destAddr));
-        destAddr.sin_family = AF_INET;
-        destAddr.sin_port = htons(17771);
-        destAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
-
-        // Convert JSON to single-line string
-        std::string jsonString = jsonData.dump() + "\n";
-
-        // Send UDP packet
-        int sendResult = sendto(sock, jsonString.c_str(), static_cast<int>(jsonString.length()), 0,
-                                (sockaddr *)&destAddr, sizeof(destAddr));
-        if (sendResult == SOCKET_ERROR) {
-            err << "Send failed: " << WSAGetLastError();
-            connectionError = err.str();
-            closesocket(sock);
-            WSACleanup();
-            return;
+        line.push_back('\n');
+        const std::time_t now = std::time(NULL);
+        connectionError.clear();
+        for (Destination &destination : destinations) {
+            if (filterable && !destination.subscription.Wants(type)) {
+                destination.filtered++;
+                continue;
+            }
+            if (destination.consecutiveErrors >= DESTINATION_ERRORS_BEFORE_BACKOFF &&
+                now < destination.retryTime) {
+                destination.dropped++;
+                continue;
+            }
+            sockaddr_in destAddr;
+            memset(&destAddr, 0, sizeof(destAddr));
+            destAddr.sin_family = AF_INET;
+            destAddr.sin_port = htons(destination.port);
+            destAddr.sin_addr.s_addr = destination.address;
+            int sendResult = sendto((SOCKET)sendSocket, line.c_str(), static_cast<int>(line.length()),
+                                    0, (sockaddr *)&destAddr, sizeof(destAddr));
+            if (sendResult == SOCKET_ERROR) {
+                destination.dropped++;
+                destination.lastError = "Send failed: " + std::to_string(WSAGetLastError());
+                connectionError = destination.name + ": " + destination.lastError;
+                // Reported once, then retried every few seconds without a message each time
+                if (++destination.consecutiveErrors == DESTINATION_ERRORS_BEFORE_BACKOFF)
+                    DisplayMessage("PostLine: " + connectionError + ", backing off");
+                if (destination.consecutiveErrors >= DESTINATION_ERRORS_BEFORE_BACKOFF)
+                    destination.retryTime = now + DESTINATION_BACKOFF_SECONDS;
+                continue;
+            }
+            if (destination.consecutiveErrors >= DESTINATION_ERRORS_BEFORE_BACKOFF)
+                DisplayMessage("PostLine: " + destination.name + " is reachable again");
+            destination.consecutiveErrors = 0;
+            destination.sent++;
         }
-
-        closesocket(sock);
-        WSACleanup();
-        connectionError = "";
-        // DisplayMessage(std::string("Sent UDP ") + std::to_string(jsonString.length()));
     } catch (const std::exception &e) {
-        connectionError = "Exception in PostJson at " + std::string(whereaboutsInDaCode) + ": " + e.what();
-        if (sock != INVALID_SOCKET) {
-            closesocket(sock);
-            WSACleanup();
-        }
+        connectionError = "Exception in PostLine at " + std::string(whereaboutsInDaCode) + ": " + e.what();
+        DisplayMessage(std::string("PostLine: ") + connectionError);
     } catch (...) {
-        connectionError = "Unknown exception in PostJson at " + std::string(whereaboutsInDaCode);
-        if (sock != INVALID_SOCKET) {
-            closesocket(sock);
-            WSACleanup();
-        }
-    }
-    if (!connectionError.empty()) {
-        DisplayMessage(std::string("PostJson: ") + connectionError);
+        connectionError = "Unknown exception in PostLine at " + std::string(whereaboutsInDaCode);
+        DisplayMessage(std::string("PostLine: ") + connectionError);
     }
 }
 
-
 void VatEFSPlugin::CleanupBackendHandles()
 {
     if (backendOutputRead != nullptr) {
@@ -4,8 +4,22 @@
 #include "EuroScopePlugIn.h"
 #pragma warning(pop)
 
+#include "airspace.h"
+#include "arrivalmetrics.h"
+#include "boundedstring.h"
+#include "extractedroute.h"
+#include "flightplancache.h"
+#include "geofence.h"
+#include "jsonwriter.h"
+#include "outputbufferpool.h"
+#include "scratchpad.h"
+#include "squawkpool.h"
+#include "subscription.h"
+#include "targettable.h"
 #include "json.hpp"
+#include <deque>
 #include <string>
+#include <unordered_map>
 
 namespace VatEFS
 {
@@ -13,6 +27,14 @@ namespace VatEFS
 constexpr const char *TOPSKY_PLUGIN_NAME = "TopSky plugin";
 constexpr const int TOPSKY_SSR_FUNCTION_ID = 667;
 
+// Tag item types registered for EFS state, served from the target table
+enum EfsTagItem {
+    TAG_ITEM_EFS_STAND = 1,
+    TAG_ITEM_EFS_CLEARED_TO_LAND,
+    TAG_ITEM_EFS_BAY,
+    TAG_ITEM_EFS_SECTION,
+};
+
 // Dummy radar screen class because we need it to access TopSky functions
 class DummyRadarScreen;
 
@@ -29,6 +51,15 @@ class VatEFSPlugin : public EuroScopePlugIn::CPlugIn
     void OnControllerPositionUpdate (EuroScopePlugIn::CController Controller);
     void OnControllerDisconnect (EuroScopePlugIn::CController Controller);
     void OnRadarTargetPositionUpdate (EuroScopePlugIn::CRadarTarget RadarTarget);
+    void OnNewMetarReceived(const char *sStation, const char *sFullMetar);
+    void OnGetTagItem(EuroScopePlugIn::CFlightPlan FlightPlan,
+                      EuroScopePlugIn::CRadarTarget RadarTarget,
+                      int ItemCode,
+                      int TagData,
+                      char sItemString[16],
+                      int *pColorCode,
+                      COLORREF *pRGB,
+                      double *pFontSize);
     EuroScopePlugIn::CRadarScreen *OnRadarScreenCreated ( const char * sDisplayName,
         bool NeedRadarContent,
         bool GeoReferenced,
@@ -47,7 +78,118 @@ class VatEFSPlugin : public EuroScopePlugIn::CPlugIn
     void DisplayMessage(const std::string &message, const std::string &sender = "EFS");
     bool UpdateScratchPad(const std::string &callsign, const std::string &content, const bool resetAfterSet = false);
     void Refresh();
+    void DisplayStats();
     bool FilterFlightPlan(EuroScopePlugIn::CFlightPlan FlightPlan);
+    // False if the subscription has no interest in the target, deciding from its flight plan
+    bool WantsTarget(int id, EuroScopePlugIn::CFlightPlan FlightPlan);
+    bool WantsTarget(int id) const;
+    void ApplySubscription(const nlohmann::json &message);
+    // Stores the fields of an efsState message for the tag items
+    void ApplyEfsState(const nlohmann::json &message);
+    bool HasEfsState(int id) const;
+    // Applies the fields of an amend message, the flight plan ones in one amendment
+    void Amend(const nlohmann::json &message);
+
+    // Flight plan callbacks received since the last timer tick, collapsed into one emission per
+    // callsign and flushed from OnTimer
+    struct PendingUpdate {
+        bool flightPlanData = false;
+        nlohmann::json controllerData; // changed controller assigned fields, null if none
+        std::string scratchKey; // field set by a scratch pad event in controllerData, if any
+    };
+
+    void PostFlightPlanData(EuroScopePlugIn::CFlightPlan FlightPlan);
+    // Outside the horizonDeparture/horizonArrival window, so only a summary is sent for now
+    bool IsBeyondHorizon(const FlightPlanView &fp, int id) const;
+    void PostFlightPlanSummary(const FlightPlanView &fp);
+    void SweepHorizon();
+    bool CollectControllerAssignedData(EuroScopePlugIn::CFlightPlan FlightPlan,
+                                       int DataType,
+                                       nlohmann::json &fields);
+    void PostPendingControllerData(const std::string &callsign, PendingUpdate &pending);
+    void FlushPendingUpdates();
+
+    static constexpr int TARGET_TIMEOUT_SECONDS = 300;
+    // Adds the target if needed and marks it as seen, returns its ID or TargetTable::NONE
+    int UpdateTarget(const BoundedString<20> &callsign);
+    void SweepTargets();
+    // Removes the target, releasing its squawk codes
+    void RemoveTarget(int id);
+
+    // Counts the target under its new transponder code, posting duplicateSquawk if another
+    // target squawks it too
+    void UpdateSquawk(int id, int code);
+    void UpdateAssignedSquawk(int id, int code);
+    void PostDuplicateSquawk(int code);
+    // squawkrange setting: <airport or *> <flight rules or *> <first> <last>
+    bool AddSquawkRange(const std::string &value);
+    // Assigns a code from the configured ranges, false if none apply or all are used
+    bool AllocateSquawk(const std::string &callsign);
+
+    // Filters the target's new position into the filtered columns, or copies it if disabled
+    void UpdateTrackFilter(int id, std::time_t reportTime);
+    static constexpr std::size_t MAX_TRACK_POINTS_PER_MESSAGE = 500;
+    // Posts trackHistory messages with the target's positions from..to, for getTrack
+    void PostTrackHistory(const std::string &callsign, std::time_t from, std::time_t to);
+    // Posts flightPlanDetail with the route, remarks and extracted route, for getFlightPlanDetail
+    void PostFlightPlanDetail(const std::string &callsign);
+    // The cached extracted route, extracted again if the route, runways, SID or STAR have changed
+    const ExtractedRouteCache::Route &ExtractRoute(EuroScopePlugIn::CFlightPlan FlightPlan,
+                                                   const FlightPlanView &fp, bool &extracted);
+    // names and points ([name, airway, latitude, longitude, distance] per point, names by index)
+    nlohmann::json ExtractedRouteToJson(const ExtractedRouteCache::Route &route) const;
+    void LoadGeofences();
+    // Updates the target's runway and stand, posting events for changes; true if any changed
+    bool UpdateGeofences(int id);
+    void PostGeofenceEvent(const char *type, const char *key, int id, int fence);
+    // Runs the movement state machine, posting movementStateChanged; true if the state changed
+    bool UpdateMovementState(int id);
+    void BuildAirspaces();
+    // Updates the target's airspace, posting airspaceEnter/airspaceExit; true if it changed
+    bool UpdateAirspace(int id);
+    void PostAirspaceEvent(const char *type, int id, int zone);
+    bool IsGroundPositionThrottled(int id);
+
+    static constexpr double MAX_ARRIVAL_DISTANCE_NM = 250;
+    // Posts arrivalMetrics for airborne arrivals with new positions since the last sweep
+    void SweepArrivalMetrics();
+
+    static constexpr int BACKFILL_TARGETS_PER_TICK = 10;
+    static constexpr int BACKFILL_POSITIONS = 12; // EuroScope's previous positions per target
+    // Posts positionBackfill with the recent positions of queued targets, a few per tick
+    void BackfillPositions();
+    // Posts the stored METAR of the station, if the subscription wants it
+    void PostMetar(const std::string &station);
+
+    std::unordered_map<std::string, PendingUpdate> pendingUpdates;
+    FlightPlanCache flightPlanCache;
+    OutputBufferPool outputBuffers;
+    TargetTable targets;
+    GeofenceIndex geofences;
+    ArrivalThresholds arrivalThresholds;
+    AirspaceIndex airspaces; // sent by the backend
+    std::string standsFile; // GRpluginStands.txt
+    int groundPositionInterval; // seconds between ground position updates, 0 to send all
+    bool trackFilterEnabled; // detect geofences and movement from filtered positions
+    int horizonDeparture; // minutes to EOBT beyond which only a summary is sent, 0 for no limit
+    int horizonArrival;   // minutes to destination, likewise
+    bool lazyDetail; // send only the head of the route, the rest on getFlightPlanDetail
+    // Serialized flightPlanDetail messages by callsign, dropped on amendment or disconnect
+    std::unordered_map<std::string, std::string> flightPlanDetails;
+    ExtractedRouteCache extractedRoutes;
+    SquawkPool squawks; // codes in use, and the ranges for resetSquawk if any are configured
+    unsigned long long duplicateSquawks; // events posted this session
+    std::deque<std::string> backfillQueue; // callsigns from the last refresh
+    Subscription subscription; // what the backend wants, everything until it says otherwise
+    // Last METAR by station, EuroScope hands the same one over again on every fetch
+    struct StoredMetar {
+        std::size_t hash = 0;
+        std::string text;
+    };
+    std::unordered_map<std::string, StoredMetar> metars;
+    unsigned long long metarsForwarded;
+    unsigned long long metarsUnchanged; // received again and not forwarded
+    unsigned long long debouncedEmissions; // duplicate emissions avoided this session
 
     bool disabled;
     bool debug;
@@ -55,6 +197,26 @@ class VatEFSPlugin : public EuroScopePlugIn::CPlugIn
     void* udpReceiveSocket; // SOCKET (using void* to avoid including winsock2.h in header)
     bool winsockInitialized;
     std::string connectionError;
+
+    // Where PostLine sends each message, from the destination settings
+    struct Destination {
+        std::string name;          // host:port as configured
+        unsigned long address = 0; // IPv4, network byte order
+        unsigned short port = 0;
+        Subscription subscription; // everything until this destination subscribes
+        unsigned long long sent = 0;
+        unsigned long long dropped = 0;  // failed, or skipped while backing off
+        unsigned long long filtered = 0; // of a type it hasn't subscribed to
+        int consecutiveErrors = 0;
+        std::time_t retryTime = 0;
+        std::string lastError;
+    };
+    static constexpr int DESTINATION_ERRORS_BEFORE_BACKOFF = 3;
+    static constexpr int DESTINATION_BACKOFF_SECONDS = 5;
+    std::vector<Destination> destinations;
+    void* sendSocket; // SOCKET, opened on the first send and kept
+    bool AddDestination(const std::string &hostAndPort);
+    void CloseSendSocket();
     std::vector<DummyRadarScreen *> dummyRadarScreens;
 
     void* backendProcess; // HANDLE to the efs.exe process (void* to avoid windows.h in header)
@@ -71,13 +233,21 @@ class VatEFSPlugin : public EuroScopePlugIn::CPlugIn
     void CleanupWinsock();
     void InitializeUdpReceiveSocket();
     void CleanupUdpReceiveSocket();
+    static constexpr int MAX_UDP_MESSAGES_PER_TICK = 100;
     void ReceiveUdpMessages();
+    // Handles one message, false if there was none
+    bool ReceiveUdpMessage();
     void PostJson(const nlohmann::json& jsonData, const char *whereaboutsInDaCode);
+    // Sends one serialized JSON message, appending the newline to it
+    void PostLine(std::string &line, const char *whereaboutsInDaCode);
 
-    static bool IsValidUtf8(const char* str);
     static std::string SanitizeUtf8(const char* str);
-    void SetJsonIfValidUtf8(nlohmann::json& j, const char* key, const char* value);
-    void SetJsonWithUtf8Replace(nlohmann::json& j, const char* key, const char* value);
+    // Sets j[key] if the value is present, within its maximum length and valid UTF-8
+    template <std::size_t N>
+    void SetJsonIfValid(nlohmann::json& j, const char* key, const BoundedString<N>& value);
+    // Sets j[key] with invalid UTF-8 sequences replaced by '?'
+    template <std::size_t N>
+    void SetJsonWithUtf8Replace(nlohmann::json& j, const char* key, const BoundedString<N>& value);
 };
 
 class DummyRadarScreen : public EuroScopePlugIn::CRadarScreen
@@ -0,0 +1,154 @@
+#include "scratchpad.h"
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+
+namespace VatEFS
+{
+
+namespace
+{
+enum Match : std::uint8_t {
+    EXACT,  // the whole string
+    PREFIX, // followed by an argument
+};
+
+struct Encoding {
+    std::string_view pattern;
+    Match match;
+    ScratchPadEvent::Kind kind;
+    int value;
+};
+
+// Strings seen in the wild. The longest match wins, so /EFS/CTL- is not taken for /EFS/CTL.
+constexpr Encoding ENCODINGS[] = {
+    { "LINEUP", EXACT, ScratchPadEvent::GROUND_STATE, 0 },
+    { "ONFREQ", EXACT, ScratchPadEvent::GROUND_STATE, 0 },
+    { "DE-ICE", EXACT, ScratchPadEvent::GROUND_STATE, 0 },
+    { "/EFS/CTL", EXACT, ScratchPadEvent::CLEARED_TO_LAND, 1 },
+    { "/EFS/CTL-", EXACT, ScratchPadEvent::CLEARED_TO_LAND, 0 },
+    { "GRP/S/", PREFIX, ScratchPadEvent::STAND, 0 },
+    { "/HOLD/", PREFIX, ScratchPadEvent::HOLD, 1 },
+    { "/XHOLD/", PREFIX, ScratchPadEvent::HOLD, 0 },
+    { "/RTI/", PREFIX, ScratchPadEvent::COORDINATION, 0 },
+    { "/SBY/RTI/", PREFIX, ScratchPadEvent::COORDINATION, 0 },
+    { "/ACP/RTI/", PREFIX, ScratchPadEvent::COORDINATION, 0 },
+    { "/ROF/", PREFIX, ScratchPadEvent::COORDINATION, 0 },
+    { "/LAM/ROF/", PREFIX, ScratchPadEvent::COORDINATION, 0 },
+    { "/OPTEXT/", PREFIX, ScratchPadEvent::OPERATOR_TEXT, 0 },
+    { "/OPTEXT2_REQ/", PREFIX, ScratchPadEvent::OPERATOR_TEXT_REQUEST, 0 },
+    { "/CAT2/", EXACT, ScratchPadEvent::APPROACH_CATEGORY, 2 },
+    { "/CAT3/", EXACT, ScratchPadEvent::APPROACH_CATEGORY, 3 },
+    { "ON_CONTACT+", EXACT, ScratchPadEvent::ON_CONTACT, 1 },
+    { "ON_CONTACT-", EXACT, ScratchPadEvent::ON_CONTACT, 0 },
+    { "/ACK_STAR/", PREFIX, ScratchPadEvent::STAR_ACKNOWLEDGED, 0 },
+    { "/PRESHDG/", EXACT, ScratchPadEvent::NOISE, 0 },
+    { "/ASP=/", EXACT, ScratchPadEvent::NOISE, 0 },
+    { "/ASP+/", EXACT, ScratchPadEvent::NOISE, 0 },
+    { "/ASP-/", EXACT, ScratchPadEvent::NOISE, 0 },
+    { "/ARC+/", EXACT, ScratchPadEvent::NOISE, 0 },
+    { "/ARC-/", EXACT, ScratchPadEvent::NOISE, 0 },
+    { "/ES", EXACT, ScratchPadEvent::NOISE, 0 },
+    { "/C_FLAG_ACK/", EXACT, ScratchPadEvent::NOISE, 0 },
+    { "/C_FLAG_RESET/", EXACT, ScratchPadEvent::NOISE, 0 },
+    { "/COB", EXACT, ScratchPadEvent::NOISE, 0 },
+    { "/PLU", EXACT, ScratchPadEvent::NOISE, 0 },
+    { "/TIT", EXACT, ScratchPadEvent::NOISE, 0 },
+    { "/FTEXT/", PREFIX, ScratchPadEvent::NOISE, 0 },
+};
+constexpr int ENCODING_COUNT = static_cast<int>(std::size(ENCODINGS));
+
+// Children are kept as a linked list of siblings, as most nodes have one
+struct Node {
+    char c = 0;
+    std::int16_t child = -1;
+    std::int16_t sibling = -1;
+    std::int8_t encoding = -1; // index into ENCODINGS ending here
+};
+
+template <std::size_t N>
+struct Trie {
+    std::array<Node, N> nodes = {};
+    std::size_t count = 1; // the root
+};
+
+template <std::size_t N>
+constexpr Trie<N> BuildTrie()
+{
+    static_assert(ENCODING_COUNT < 128);
+    Trie<N> trie;
+    for (int e = 0; e < ENCODING_COUNT; e++) {
+        int node = 0;
+        for (char c : ENCODINGS[e].pattern) {
+            int child = trie.nodes[node].child;
+            while (child != -1 && trie.nodes[child].c != c)
+                child = trie.nodes[child].sibling;
+            if (child == -1) {
+                if (trie.count == N) throw "ScratchPad trie is too small"; // fails to compile
+                child = static_cast<int>(trie.count++);
+                trie.nodes[child].c = c;
+                trie.nodes[child].sibling = trie.nodes[node].child;
+                trie.nodes[node].child = static_cast<std::int16_t>(child);
+            }
+            node = child;
+        }
+        trie.nodes[node].encoding = static_cast<std::int8_t>(e);
+    }
+    return trie;
+}
+
+// Built twice, the first time to count the nodes
+constexpr std::size_t NODE_COUNT = BuildTrie<1024>().count;
+constexpr Trie<NODE_COUNT> TRIE = BuildTrie<NODE_COUNT>();
+} // namespace
+
+ScratchPadEvent DecodeScratchPad(std::string_view scratch)
+{
+    int found = -1;
+    std::size_t foundLength = 0;
+    int node = 0;
+    for (std::size_t i = 0; i < scratch.size(); i++) {
+        int child = TRIE.nodes[node].child;
+        while (child != -1 && TRIE.nodes[child].c != scratch[i])
+            child = TRIE.nodes[child].sibling;
+        if (child == -1) break;
+        node = child;
+        const int e = TRIE.nodes[node].encoding;
+        if (e != -1 && (ENCODINGS[e].match == PREFIX || i + 1 == scratch.size())) {
+            found = e;
+            foundLength = i + 1;
+        }
+    }
+
+    ScratchPadEvent event;
+    if (found == -1) return event;
+    const Encoding &encoding = ENCODINGS[found];
+    event.kind = encoding.kind;
+    event.value = encoding.value;
+    event.code = scratch.substr(0, foundLength);
+    while (!event.code.empty() && event.code.front() == '/')
+        event.code.remove_prefix(1);
+    while (!event.code.empty() && event.code.back() == '/')
+        event.code.remove_suffix(1);
+    event.argument = scratch.substr(foundLength);
+    return event;
+}
+
+std::vector<std::string_view> SplitScratchPadFields(std::string_view argument,
+                                                    std::size_t maxFields)
+{
+    std::vector<std::string_view> fields;
+    if (!argument.empty() && argument.back() == '/') argument.remove_suffix(1);
+    if (argument.empty() || maxFields == 0) return fields;
+    while (fields.size() + 1 < maxFields) {
+        const std::size_t slash = argument.find('/');
+        if (slash == std::string_view::npos) break;
+        fields.push_back(argument.substr(0, slash));
+        argument.remove_prefix(slash + 1);
+    }
+    fields.push_back(argument);
+    return fields;
+}
+
+} // namespace VatEFS
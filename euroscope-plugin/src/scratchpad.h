@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace VatEFS
+{
+
+// A scratch pad string decoded. TopSky uses the scratch pad as a side channel between
+// controllers, setting a code and resetting the previous value right after, and the EFS uses it
+// for a few states of its own. The known encodings are matched against a prefix trie that is
+// built at compile time from the table in scratchpad.cpp.
+struct ScratchPadEvent {
+    enum Kind : std::uint8_t {
+        RAW,                   // not a known encoding, sent as is (MISAP_, .remarks, "")
+        NOISE,                 // TopSky internal, of no use to the EFS
+        GROUND_STATE,          // LINEUP, ONFREQ, DE-ICE
+        CLEARED_TO_LAND,       // /EFS/CTL, /EFS/CTL- (value 1 or 0)
+        STAND,                 // GRP/S/<stand>
+        HOLD,                  // /HOLD/<fix>/ (value 1), /XHOLD/<fix>/ (value 0)
+        COORDINATION,          // /RTI/, /SBY/RTI/, /ACP/RTI/, /ROF/, /LAM/ROF/ and fields
+        OPERATOR_TEXT,         // /OPTEXT/<text>
+        OPERATOR_TEXT_REQUEST, // /OPTEXT2_REQ/<controller>/<callsign>/<text>
+        APPROACH_CATEGORY,     // /CAT2/, /CAT3/ (value 2 or 3)
+        ON_CONTACT,            // ON_CONTACT+, ON_CONTACT- (value 1 or 0)
+        STAR_ACKNOWLEDGED,     // /ACK_STAR/<star>
+    };
+
+    Kind kind = RAW;
+    int value = 0;
+    std::string_view code;     // the matched encoding without the outer slashes, e.g. SBY/RTI
+    std::string_view argument; // what follows it
+};
+
+// Views into scratch, which must outlive the event
+ScratchPadEvent DecodeScratchPad(std::string_view scratch);
+
+// The '/' separated fields of an argument, with a trailing slash ignored. At most maxFields, the
+// last one taking the rest.
+std::vector<std::string_view> SplitScratchPadFields(std::string_view argument,
+                                                    std::size_t maxFields = SIZE_MAX);
+
+} // namespace VatEFS
@@ -0,0 +1,147 @@
+#include "squawkpool.h"
+
+#include <bit>
+
+namespace VatEFS
+{
+
+SquawkPool::SquawkPool()
+{
+    Clear();
+}
+
+int SquawkPool::Parse(std::string_view squawk)
+{
+    if (squawk.size() != 4) return NO_CODE;
+    int code = 0;
+    for (char c : squawk) {
+        if (c < '0' || c > '7') return NO_CODE;
+        code = code * 8 + (c - '0');
+    }
+    return code;
+}
+
+std::string SquawkPool::Format(int code)
+{
+    std::string squawk(4, '0');
+    for (int i = 3; i >= 0; i--, code >>= 3)
+        squawk[i] = static_cast<char>('0' + (code & 7));
+    return squawk;
+}
+
+std::uint32_t SquawkPool::PackAirport(std::string_view icao)
+{
+    if (icao == "*") return 0;
+    std::uint32_t packed = 0;
+    for (std::size_t i = 0; i < 4; i++)
+        packed = (packed << 8) | (i < icao.size() ? static_cast<unsigned char>(icao[i]) : 0);
+    return packed;
+}
+
+bool SquawkPool::Matches(const Range &range, std::uint32_t airport, char flightRules)
+{
+    return (range.airport == 0 || range.airport == airport) &&
+           (range.flightRules == ANY_RULES || range.flightRules == flightRules);
+}
+
+bool SquawkPool::AddRange(std::string_view airport, char flightRules, int first, int last)
+{
+    if (first == NO_CODE || last == NO_CODE || first > last) return false;
+    if (airport != "*" && airport.size() != 4) return false;
+    ranges.push_back({ PackAirport(airport), flightRules, first, last, first });
+    return true;
+}
+
+bool SquawkPool::HasRange(std::string_view airport, char flightRules) const
+{
+    const std::uint32_t packed = PackAirport(airport);
+    for (const Range &range : ranges) {
+        if (Matches(range, packed, flightRules)) return true;
+    }
+    return false;
+}
+
+void SquawkPool::UpdateBit(int code)
+{
+    const std::uint64_t bit = std::uint64_t(1) << (code & 63);
+    if (squawking[code] > 0 || assigned[code] > 0 || !IsDiscrete(code))
+        inUse[code >> 6] |= bit;
+    else
+        inUse[code >> 6] &= ~bit;
+}
+
+int SquawkPool::AddSquawking(int code)
+{
+    if (code < 0 || code >= CODES) return 0;
+    squawking[code]++;
+    UpdateBit(code);
+    return squawking[code];
+}
+
+void SquawkPool::RemoveSquawking(int code)
+{
+    if (code < 0 || code >= CODES || squawking[code] == 0) return;
+    squawking[code]--;
+    UpdateBit(code);
+}
+
+void SquawkPool::AddAssigned(int code)
+{
+    if (code < 0 || code >= CODES) return;
+    assigned[code]++;
+    UpdateBit(code);
+}
+
+void SquawkPool::RemoveAssigned(int code)
+{
+    if (code < 0 || code >= CODES || assigned[code] == 0) return;
+    assigned[code]--;
+    UpdateBit(code);
+}
+
+void SquawkPool::Clear()
+{
+    squawking.fill(0);
+    assigned.fill(0);
+    inUse.fill(0);
+    for (int code = 0; code < CODES; code += 64)
+        UpdateBit(code);
+}
+
+int SquawkPool::InUseCount() const
+{
+    int count = 0;
+    for (std::uint64_t word : inUse)
+        count += std::popcount(word);
+    return count - CODES / 64; // the codes ending in 00 aren't used by anyone
+}
+
+int SquawkPool::FindFree(int from, int to) const
+{
+    for (int code = from; code <= to;) {
+        // The free codes of this word from code on
+        const std::uint64_t free = ~inUse[code >> 6] >> (code & 63);
+        if (free != 0) {
+            const int found = code + std::countr_zero(free);
+            return found <= to ? found : NO_CODE;
+        }
+        code = (code | 63) + 1;
+    }
+    return NO_CODE;
+}
+
+int SquawkPool::Allocate(std::string_view airport, char flightRules)
+{
+    const std::uint32_t packed = PackAirport(airport);
+    for (Range &range : ranges) {
+        if (!Matches(range, packed, flightRules)) continue;
+        int code = FindFree(range.next, range.last);
+        if (code == NO_CODE) code = FindFree(range.first, range.next - 1);
+        if (code == NO_CODE) continue;
+        range.next = code < range.last ? code + 1 : range.first;
+        return code;
+    }
+    return NO_CODE;
+}
+
+} // namespace VatEFS
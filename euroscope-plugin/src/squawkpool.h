@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace VatEFS
+{
+
+// Transponder codes in use and the ranges to allocate from. Codes are kept as their value 0..4095
+// (octal 0000..7777). A 4096-bit map of the codes in use is updated as targets change their
+// squawk or get one assigned, so checking a code is one bit test and allocation skips used codes
+// 64 at a time. Codes ending in 00 are not discrete (conspicuity, emergency) and are neither
+// allocated nor reported as duplicates.
+class SquawkPool
+{
+    public:
+    static constexpr int CODES = 4096;
+    static constexpr int NO_CODE = -1;
+    static constexpr char ANY_RULES = '*';
+
+    SquawkPool();
+
+    // The code for four octal digits, NO_CODE if it isn't one
+    static int Parse(std::string_view squawk);
+    static std::string Format(int code);
+    static bool IsDiscrete(int code)
+    {
+        return code >= 0 && code % 64 != 0;
+    }
+
+    // first..last for departures from airport ("*" for any) with the flight rules (ANY_RULES for
+    // any), returns false if it isn't a valid range. Ranges are tried in the order added.
+    bool AddRange(std::string_view airport, char flightRules, int first, int last);
+    bool HasRange(std::string_view airport, char flightRules) const;
+    int RangeCount() const
+    {
+        return static_cast<int>(ranges.size());
+    }
+
+    // Counts a target squawking the code, returns how many do now
+    int AddSquawking(int code);
+    void RemoveSquawking(int code);
+    // Counts a flight plan with the code assigned
+    void AddAssigned(int code);
+    void RemoveAssigned(int code);
+    // Forgets the codes in use, the ranges stay
+    void Clear();
+
+    bool InUse(int code) const
+    {
+        return (inUse[code >> 6] >> (code & 63)) & 1;
+    }
+    int InUseCount() const;
+
+    // A free discrete code from the first matching range that has one, NO_CODE if none. Each
+    // range continues after the code it gave last, so a code that was just released isn't
+    // handed out again right away.
+    int Allocate(std::string_view airport, char flightRules);
+
+    private:
+    struct Range {
+        std::uint32_t airport; // packed ICAO code, 0 for any
+        char flightRules;
+        int first, last;
+        int next; // where the search starts
+    };
+
+    static std::uint32_t PackAirport(std::string_view icao);
+    static bool Matches(const Range &range, std::uint32_t airport, char flightRules);
+    // First free code in from..to, NO_CODE if none
+    int FindFree(int from, int to) const;
+    void UpdateBit(int code);
+
+    std::vector<Range> ranges;
+    std::array<std::uint16_t, CODES> squawking = {};
+    std::array<std::uint16_t, CODES> assigned = {};
+    std::array<std::uint64_t, CODES / 64> inUse = {}; // squawked or assigned, or not discrete
+};
+
+} // namespace VatEFS
@@ -0,0 +1,162 @@
+#include "subscription.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace VatEFS
+{
+
+static constexpr std::uint32_t ALL_TYPES = ~std::uint32_t(0);
+
+static const struct {
+    const char *name;
+    Subscription::MessageType type;
+} MESSAGE_TYPES[] = {
+    { "flightPlanDataUpdate", Subscription::FLIGHT_PLAN_DATA },
+    { "flightPlanSummary", Subscription::FLIGHT_PLAN_DATA },
+    { "controllerAssignedDataUpdate", Subscription::CONTROLLER_DATA },
+    { "radarTargetPositionUpdate", Subscription::RADAR_POSITION },
+    { "extractedRoute", Subscription::EXTRACTED_ROUTE },
+    { "positionBackfill", Subscription::POSITION_BACKFILL },
+    { "enteredRunway", Subscription::GEOFENCE },
+    { "vacatedRunway", Subscription::GEOFENCE },
+    { "onStand", Subscription::GEOFENCE },
+    { "offStand", Subscription::GEOFENCE },
+    { "airspaceEnter", Subscription::AIRSPACE },
+    { "airspaceExit", Subscription::AIRSPACE },
+    { "movementStateChanged", Subscription::MOVEMENT },
+    { "arrivalMetrics", Subscription::ARRIVAL_METRICS },
+    { "metar", Subscription::METAR },
+    { "duplicateSquawk", Subscription::DUPLICATE_SQUAWK },
+};
+
+Subscription::Subscription()
+{
+    Clear();
+}
+
+void Subscription::Clear()
+{
+    types = ALL_TYPES;
+    airports.clear();
+    callsigns.clear();
+    stations.clear();
+    excludedFields.clear();
+}
+
+bool Subscription::TypeOf(std::string_view name, MessageType &type)
+{
+    for (const auto &entry : MESSAGE_TYPES) {
+        if (name == entry.name) {
+            type = entry.type;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> Subscription::SetTypes(const std::vector<std::string> &names)
+{
+    std::vector<std::string> unknown;
+    if (names.empty()) {
+        types = ALL_TYPES;
+        return unknown;
+    }
+    types = 0;
+    for (const std::string &name : names) {
+        MessageType type;
+        if (TypeOf(name, type))
+            types |= std::uint32_t(1) << type;
+        else
+            unknown.push_back(name);
+    }
+    return unknown;
+}
+
+std::uint32_t Subscription::PackAirport(std::string_view icao)
+{
+    std::uint32_t packed = 0;
+    for (std::size_t i = 0; i < 4; i++)
+        packed = (packed << 8) | (i < icao.size() ? static_cast<unsigned char>(icao[i]) : 0);
+    return packed;
+}
+
+std::vector<std::uint32_t> Subscription::PackAirports(const std::vector<std::string> &icaos)
+{
+    std::vector<std::uint32_t> packed;
+    for (const std::string &icao : icaos) {
+        if (icao.size() == 4) packed.push_back(PackAirport(icao));
+    }
+    std::sort(packed.begin(), packed.end());
+    return packed;
+}
+
+void Subscription::SetAirports(const std::vector<std::string> &icaos)
+{
+    airports = PackAirports(icaos);
+}
+
+void Subscription::SetCallsigns(const std::vector<std::string> &names)
+{
+    callsigns = std::set<std::string, std::less<>>(names.begin(), names.end());
+}
+
+void Subscription::SetStations(const std::vector<std::string> &icaos)
+{
+    stations = PackAirports(icaos);
+}
+
+void Subscription::SetExcludedFields(const std::vector<std::string> &fields)
+{
+    excludedFields.clear();
+    for (const std::string &field : fields) {
+        if (field != "type" && field != "callsign") excludedFields.push_back(field);
+    }
+}
+
+void Subscription::Merge(const Subscription &other)
+{
+    types |= other.types;
+    if (!HasFlightFilter() || !other.HasFlightFilter()) {
+        airports.clear();
+        callsigns.clear();
+    } else {
+        std::vector<std::uint32_t> merged;
+        std::set_union(airports.begin(), airports.end(), other.airports.begin(),
+                       other.airports.end(), std::back_inserter(merged));
+        airports = std::move(merged);
+        callsigns.insert(other.callsigns.begin(), other.callsigns.end());
+    }
+    if (stations.empty() || other.stations.empty()) {
+        stations.clear();
+    } else {
+        std::vector<std::uint32_t> merged;
+        std::set_union(stations.begin(), stations.end(), other.stations.begin(),
+                       other.stations.end(), std::back_inserter(merged));
+        stations = std::move(merged);
+    }
+    std::erase_if(excludedFields, [&](const std::string &field) {
+        return std::find(other.excludedFields.begin(), other.excludedFields.end(), field) ==
+               other.excludedFields.end();
+    });
+}
+
+bool Subscription::WantsFlight(std::string_view callsign, std::string_view origin,
+                               std::string_view destination) const
+{
+    if (!HasFlightFilter()) return true;
+    if (callsigns.find(callsign) != callsigns.end()) return true;
+    if (origin.size() == 4 && std::binary_search(airports.begin(), airports.end(), PackAirport(origin)))
+        return true;
+    return destination.size() == 4 &&
+           std::binary_search(airports.begin(), airports.end(), PackAirport(destination));
+}
+
+bool Subscription::WantsStation(std::string_view icao) const
+{
+    if (stations.empty()) return true;
+    return icao.size() == 4 &&
+           std::binary_search(stations.begin(), stations.end(), PackAirport(icao));
+}
+
+} // namespace VatEFS
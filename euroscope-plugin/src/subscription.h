@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace VatEFS
+{
+
+// What the backend has asked to receive, from its subscribe message. Empty lists mean no
+// restriction. The lists are compiled into a bit mask, packed airport codes and a callsign set,
+// and checked before a message is built, so what is filtered out is never encoded.
+class Subscription
+{
+    public:
+    // Message types that can be filtered, the rest are always sent
+    enum MessageType : std::uint8_t {
+        FLIGHT_PLAN_DATA, // flightPlanDataUpdate, flightPlanSummary
+        CONTROLLER_DATA,  // controllerAssignedDataUpdate
+        RADAR_POSITION,   // radarTargetPositionUpdate
+        EXTRACTED_ROUTE,
+        POSITION_BACKFILL,
+        GEOFENCE, // enteredRunway, vacatedRunway, onStand, offStand
+        AIRSPACE, // airspaceEnter, airspaceExit
+        MOVEMENT, // movementStateChanged
+        ARRIVAL_METRICS,
+        METAR,
+        DUPLICATE_SQUAWK,
+    };
+
+    Subscription();
+
+    // Back to everything
+    void Clear();
+    // Returns the names that are not filterable message types, which are ignored
+    std::vector<std::string> SetTypes(const std::vector<std::string> &names);
+    void SetAirports(const std::vector<std::string> &icaos);
+    void SetCallsigns(const std::vector<std::string> &names);
+    // Whose METARs are sent
+    void SetStations(const std::vector<std::string> &icaos);
+    // Keys left out of the messages, except type and callsign
+    void SetExcludedFields(const std::vector<std::string> &fields);
+    // Widens this to also take what other does: types and flights are united, only the fields
+    // both exclude stay excluded
+    void Merge(const Subscription &other);
+
+    // The filterable type with this name, false if there is none
+    static bool TypeOf(std::string_view name, MessageType &type);
+
+    bool Wants(MessageType type) const
+    {
+        return (types >> type) & 1;
+    }
+    bool HasFlightFilter() const
+    {
+        return !airports.empty() || !callsigns.empty();
+    }
+    // To or from one of the airports, or one of the callsigns
+    bool WantsFlight(std::string_view callsign, std::string_view origin,
+                     std::string_view destination) const;
+    bool WantsStation(std::string_view icao) const;
+    const std::vector<std::string> &ExcludedFields() const
+    {
+        return excludedFields;
+    }
+
+    private:
+    static std::uint32_t PackAirport(std::string_view icao);
+    static std::vector<std::uint32_t> PackAirports(const std::vector<std::string> &icaos);
+
+    std::uint32_t types;
+    std::vector<std::uint32_t> airports; // sorted
+    std::set<std::string, std::less<>> callsigns;
+    std::vector<std::uint32_t> stations; // sorted
+    std::vector<std::string> excludedFields;
+};
+
+} // namespace VatEFS
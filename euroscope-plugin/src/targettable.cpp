@@ -0,0 +1,126 @@
+#include "targettable.h"
+
+#include <utility>
+
+namespace VatEFS
+{
+
+static constexpr std::size_t INITIAL_CAPACITY = 1024; // slots; the table is kept at most half full
+
+TargetTable::TargetTable()
+{
+    slots.assign(INITIAL_CAPACITY, NONE);
+    ForEachColumn([](auto &column) { column.reserve(INITIAL_CAPACITY / 2); });
+}
+
+std::uint32_t TargetTable::Hash(std::string_view name)
+{
+    // FNV-1a
+    std::uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+int TargetTable::Find(std::string_view name) const
+{
+    const std::size_t mask = slots.size() - 1;
+    const std::uint32_t hash = Hash(name);
+    for (std::size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        int id = slots[slot];
+        if (id == NONE) return NONE;
+        if (hashes[id] == hash && callsign[id] == name) return id;
+    }
+}
+
+int TargetTable::Insert(const BoundedString<20> &name)
+{
+    int id = Find(name.View());
+    if (id != NONE) return id;
+
+    if (static_cast<std::size_t>(Size() + 1) * 2 > slots.size()) Rehash(slots.size() * 2);
+
+    id = Size();
+    ForEachColumn([](auto &column) { column.emplace_back(); });
+    callsign[id] = name;
+    hashes[id] = Hash(name.View());
+    runwayFence[id] = standFence[id] = -1; // GeofenceIndex::NONE
+    airspace[id] = airspaceCell[id] = -1; // AirspaceIndex::NONE
+    airspaceCellKey[id] = INT64_MIN;      // AirspaceIndex::NO_CELL
+    track[id] = -1;
+    squawkCode[id] = assignedSquawkCode[id] = -1; // SquawkPool::NO_CODE
+    movementState[id] = movementCandidate[id] = MOVEMENT_UNKNOWN;
+    ownership[id] = OWNER_NONE;
+    filterVerdict[id] = subscribed[id] = VERDICT_UNKNOWN;
+
+    const std::size_t mask = slots.size() - 1;
+    std::size_t slot = hashes[id] & mask;
+    while (slots[slot] != NONE)
+        slot = (slot + 1) & mask;
+    slots[slot] = id;
+    return id;
+}
+
+std::size_t TargetTable::SlotOf(int id) const
+{
+    const std::size_t mask = slots.size() - 1;
+    std::size_t slot = hashes[id] & mask;
+    while (slots[slot] != id)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+void TargetTable::Remove(int id)
+{
+    if (id < 0 || id >= Size()) return;
+    const std::size_t mask = slots.size() - 1;
+
+    // Backward-shift deletion: move later entries of the probe sequence into the hole so that
+    // lookups never need tombstones
+    std::size_t hole = SlotOf(id);
+    for (std::size_t next = (hole + 1) & mask; slots[next] != NONE; next = (next + 1) & mask) {
+        std::size_t home = hashes[slots[next]] & mask;
+        // Can the entry at next move to hole, i.e. is home cyclically outside (hole, next]?
+        bool movable = hole <= next ? (home <= hole || home > next) : (home <= hole && home > next);
+        if (movable) {
+            slots[hole] = slots[next];
+            hole = next;
+        }
+    }
+    slots[hole] = NONE;
+
+    // Keep the IDs dense by moving the last target into the removed one's place
+    const int last = Size() - 1;
+    if (id != last) {
+        slots[SlotOf(last)] = id;
+        ForEachColumn([id, last](auto &column) { column[id] = std::move(column[last]); });
+    }
+    ForEachColumn([](auto &column) { column.pop_back(); });
+}
+
+void TargetTable::Remove(std::string_view name)
+{
+    Remove(Find(name));
+}
+
+void TargetTable::Clear()
+{
+    ForEachColumn([](auto &column) { column.clear(); });
+    slots.assign(slots.size(), NONE);
+}
+
+void TargetTable::Rehash(std::size_t capacity)
+{
+    slots.assign(capacity, NONE);
+    const std::size_t mask = capacity - 1;
+    for (int id = 0; id < Size(); id++) {
+        std::size_t slot = hashes[id] & mask;
+        while (slots[slot] != NONE)
+            slot = (slot + 1) & mask;
+        slots[slot] = id;
+    }
+}
+
+} // namespace VatEFS
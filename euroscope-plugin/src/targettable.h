@@ -0,0 +1,186 @@
+#pragma once
+
+#include "boundedstring.h"
+#include "movement.h"
+#include "trackfilter.h"
+#include "trackhistory.h"
+#include <cstdint>
+#include <ctime>
+#include <string_view>
+#include <vector>
+
+namespace VatEFS
+{
+
+// State the plugin keeps per callsign (radar target and/or flight plan), stored as one array per
+// field so that sweeps over all targets only touch the fields they use. Callsigns map to dense
+// IDs 0..Size()-1 through an open-addressing hash table. Removing a target moves the last one
+// into its place, so IDs are only valid until the next Remove().
+class TargetTable
+{
+    public:
+    static constexpr int NONE = -1;
+
+    enum Ownership : std::uint8_t {
+        OWNER_NONE,  // not tracked
+        OWNER_ME,    // tracked by myself
+        OWNER_OTHER, // tracked by another controller
+    };
+    enum Verdict : std::uint8_t {
+        VERDICT_UNKNOWN,
+        VERDICT_PASS,   // passes FilterFlightPlan
+        VERDICT_REJECT,
+    };
+    enum Horizon : std::uint8_t {
+        HORIZON_UNKNOWN,
+        HORIZON_SUMMARY, // outside the window, only a flightPlanSummary has been sent
+        HORIZON_FULL,    // the full flight plan has been sent
+    };
+
+    TargetTable();
+
+    int Find(std::string_view name) const;
+    // Returns the ID of the target, adding it if it isn't in the table
+    int Insert(const BoundedString<20> &name);
+    void Remove(int id);
+    void Remove(std::string_view name);
+    void Clear();
+
+    int Size() const
+    {
+        return static_cast<int>(callsign.size());
+    }
+    std::size_t HashCapacity() const
+    {
+        return slots.size();
+    }
+
+    // Columns, indexed by ID
+    std::vector<BoundedString<20>> callsign;
+    std::vector<std::time_t> lastSeen; // last callback for the target
+
+    // Kinematics, from the last radar target position update
+    std::vector<double> latitude;
+    std::vector<double> longitude;
+    std::vector<int> altitude; // pressure altitude (ft)
+    std::vector<int> groundSpeed; // kt
+    std::vector<int> heading;     // true track (deg)
+    std::vector<int> verticalSpeed; // ft/min
+    std::vector<std::uint8_t> hasPosition;
+    std::vector<int> track; // direction of movement between the last two positions, -1 if unknown
+
+    // Position and ground speed as used for detection: through the TrackFilter if enabled, else
+    // the same as reported. The track then comes from the filter too.
+    std::vector<double> filteredLatitude;
+    std::vector<double> filteredLongitude;
+    std::vector<int> filteredGroundSpeed;
+    std::vector<TrackFilter> trackFilter;
+    std::vector<TrackHistory> history; // reported positions
+
+    // Geofences (GeofenceIndex) the target is in, or GeofenceIndex::NONE
+    std::vector<int> runwayFence;
+    std::vector<int> standFence;
+    std::vector<std::time_t> positionSentTime;
+
+    // Airspace (AirspaceIndex) the target is in or AirspaceIndex::NONE, and the cell it was in
+    // at the last test
+    std::vector<int> airspace;
+    std::vector<std::int64_t> airspaceCellKey;
+    std::vector<int> airspaceCell;
+
+    // Arrival metrics, see ComputeArrivalMetrics
+    std::vector<std::uint8_t> hasArrivalThreshold;
+    std::vector<double> thresholdLatitude;
+    std::vector<double> thresholdLongitude;
+    std::vector<double> arrivalDistance; // nm
+    std::vector<double> arrivalClosure;  // kt
+    std::vector<double> arrivalEta;      // s
+    std::vector<std::uint32_t> metricsPositionVersion; // positionVersion last sent arrivalMetrics for
+
+    // Movement state machine, see InferMovementState
+    std::vector<MovementState> movementState;
+    std::vector<MovementState> movementCandidate;
+    std::vector<std::uint8_t> movementConfirmations;
+
+    // EFS state from the backend's efsState messages, shown in the tag items
+    std::vector<BoundedString<15>> efsStand;
+    std::vector<BoundedString<15>> efsBay;
+    std::vector<BoundedString<15>> efsSection;
+    std::vector<std::uint8_t> efsClearedToLand;
+
+    // Codes (SquawkPool) the target is counted under, or SquawkPool::NO_CODE
+    std::vector<std::int16_t> squawkCode;         // from the transponder
+    std::vector<std::int16_t> assignedSquawkCode; // from the flight plan
+
+    std::vector<Ownership> ownership;
+    std::vector<Verdict> filterVerdict;
+    std::vector<Verdict> subscribed; // Subscription::WantsFlight, unknown until needed
+    std::vector<Horizon> horizon;
+
+    // Bumped when the data changes, and copied to the sent version when it is sent to the backend
+    std::vector<std::uint32_t> positionVersion;
+    std::vector<std::uint32_t> sentPositionVersion;
+    std::vector<std::uint32_t> flightPlanVersion;
+    std::vector<std::uint32_t> sentFlightPlanVersion;
+
+    private:
+    template <typename F>
+    void ForEachColumn(F &&f)
+    {
+        f(callsign);
+        f(hashes);
+        f(lastSeen);
+        f(latitude);
+        f(longitude);
+        f(altitude);
+        f(groundSpeed);
+        f(heading);
+        f(verticalSpeed);
+        f(hasPosition);
+        f(runwayFence);
+        f(standFence);
+        f(positionSentTime);
+        f(airspace);
+        f(airspaceCellKey);
+        f(airspaceCell);
+        f(track);
+        f(filteredLatitude);
+        f(filteredLongitude);
+        f(filteredGroundSpeed);
+        f(trackFilter);
+        f(history);
+        f(efsStand);
+        f(efsBay);
+        f(efsSection);
+        f(efsClearedToLand);
+        f(squawkCode);
+        f(assignedSquawkCode);
+        f(movementState);
+        f(movementCandidate);
+        f(movementConfirmations);
+        f(hasArrivalThreshold);
+        f(thresholdLatitude);
+        f(thresholdLongitude);
+        f(arrivalDistance);
+        f(arrivalClosure);
+        f(arrivalEta);
+        f(metricsPositionVersion);
+        f(ownership);
+        f(filterVerdict);
+        f(subscribed);
+        f(horizon);
+        f(positionVersion);
+        f(sentPositionVersion);
+        f(flightPlanVersion);
+        f(sentFlightPlanVersion);
+    }
+
+    static std::uint32_t Hash(std::string_view name);
+    std::size_t SlotOf(int id) const;
+    void Rehash(std::size_t capacity);
+
+    std::vector<std::uint32_t> hashes; // callsign hash per ID, so rehashing needn't rehash strings
+    std::vector<int> slots;            // ID per slot, NONE if empty; size is a power of two
+};
+
+} // namespace VatEFS
@@ -0,0 +1,94 @@
+#include "trackfilter.h"
+
+#include <cmath>
+
+namespace VatEFS
+{
+
+static constexpr double METERS_PER_DEGREE_LATITUDE = 111320;
+static constexpr double METERS_PER_SECOND_PER_KT = 1852.0 / 3600;
+static constexpr double PI = 3.14159265358979323846;
+static constexpr double INITIAL_VELOCITY_VARIANCE = 25; // (m/s)^2, for the reported velocity
+
+static double MetersPerDegreeLongitude(double latitude)
+{
+    return METERS_PER_DEGREE_LATITUDE * std::cos(latitude * PI / 180);
+}
+
+void TrackFilter::Reset(double now, GeoPoint position, int groundSpeed, int heading)
+{
+    initialized = true;
+    time = now;
+    origin = position;
+    east = north = 0;
+    const double speed = groundSpeed * METERS_PER_SECOND_PER_KT;
+    velocityEast = speed * std::sin(heading * PI / 180);
+    velocityNorth = speed * std::cos(heading * PI / 180);
+    p00 = POSITION_NOISE_M * POSITION_NOISE_M;
+    p01 = 0;
+    p11 = INITIAL_VELOCITY_VARIANCE;
+    outliers = 0;
+}
+
+void TrackFilter::Update(double now, GeoPoint position, int groundSpeed, int heading)
+{
+    const double dt = now - time;
+    if (!initialized || dt < 0 || dt > MAX_INTERVAL_SECONDS) {
+        Reset(now, position, groundSpeed, heading);
+        return;
+    }
+    if (std::abs(east) > REANCHOR_DISTANCE_M || std::abs(north) > REANCHOR_DISTANCE_M) {
+        origin = Position();
+        east = north = 0;
+    }
+    time = now;
+
+    // Predict, with white noise acceleration
+    const double q = ACCELERATION_NOISE * ACCELERATION_NOISE;
+    east += velocityEast * dt;
+    north += velocityNorth * dt;
+    p00 += dt * (2 * p01 + dt * p11) + q * dt * dt * dt / 3;
+    p01 += dt * p11 + q * dt * dt / 2;
+    p11 += q * dt;
+
+    // Correct with the measured position
+    const double measuredEast = (position.longitude - origin.longitude) * MetersPerDegreeLongitude(origin.latitude);
+    const double measuredNorth = (position.latitude - origin.latitude) * METERS_PER_DEGREE_LATITUDE;
+    const double s = p00 + POSITION_NOISE_M * POSITION_NOISE_M;
+    const double residualEast = measuredEast - east, residualNorth = measuredNorth - north;
+    // Beyond the noise, and further off than turning at the current speed could have taken it
+    const double gate = OUTLIER_GATE * std::sqrt(s) +
+                        2 * std::sqrt(velocityEast * velocityEast + velocityNorth * velocityNorth) * dt;
+    if (residualEast * residualEast + residualNorth * residualNorth > gate * gate) {
+        if (++outliers > MAX_OUTLIERS) Reset(now, position, groundSpeed, heading);
+        return;
+    }
+    outliers = 0;
+    const double k0 = p00 / s, k1 = p01 / s;
+    east += k0 * residualEast;
+    north += k0 * residualNorth;
+    velocityEast += k1 * residualEast;
+    velocityNorth += k1 * residualNorth;
+    p11 -= k1 * p01;
+    p01 -= k0 * p01;
+    p00 -= k0 * p00;
+}
+
+GeoPoint TrackFilter::Position() const
+{
+    return { origin.latitude + north / METERS_PER_DEGREE_LATITUDE,
+             origin.longitude + east / MetersPerDegreeLongitude(origin.latitude) };
+}
+
+double TrackFilter::GroundSpeed() const
+{
+    return std::sqrt(velocityEast * velocityEast + velocityNorth * velocityNorth) / METERS_PER_SECOND_PER_KT;
+}
+
+double TrackFilter::Track() const
+{
+    const double track = std::atan2(velocityEast, velocityNorth) * 180 / PI;
+    return track < 0 ? track + 360 : track;
+}
+
+} // namespace VatEFS
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "geofence.h"
+
+namespace VatEFS
+{
+
+// Constant-velocity Kalman filter over the reported positions of one target, in meters east and
+// north of a local origin near the target. Ground speed and track come from the filtered
+// velocity rather than the reported values. The axes are filtered independently, and as they
+// share the same noise model their covariances are equal, so only one is kept.
+struct TrackFilter {
+    static constexpr double POSITION_NOISE_M = 20;      // standard deviation of reported positions
+    static constexpr double ACCELERATION_NOISE = 0.5;   // m/s^2, how fast the velocity may change
+    static constexpr double MAX_INTERVAL_SECONDS = 30;  // longer gaps start over
+    static constexpr double REANCHOR_DISTANCE_M = 50000; // keep the flat-earth error small
+    static constexpr double OUTLIER_GATE = 6; // standard deviations of noise in a rejected residual
+    static constexpr int MAX_OUTLIERS = 2;    // rejected in a row before starting over
+
+    bool initialized = false;
+    double time = 0; // s, of the last update
+    GeoPoint origin = {};
+    double east = 0, north = 0;                 // m
+    double velocityEast = 0, velocityNorth = 0; // m/s
+    double p00 = 0, p01 = 0, p11 = 0;           // covariance of position and velocity, per axis
+    int outliers = 0;                           // reports rejected in a row
+
+    // Starts over at the position, with the velocity from the reported ground speed and heading
+    void Reset(double now, GeoPoint position, int groundSpeed, int heading);
+    // A report further from the prediction than noise and turning explain is taken as an outlier
+    // and only advances the prediction, unless there are more than MAX_OUTLIERS in a row (the
+    // target really jumped)
+    void Update(double now, GeoPoint position, int groundSpeed, int heading);
+
+    GeoPoint Position() const;
+    double GroundSpeed() const; // kt
+    double Track() const;       // true, deg
+};
+
+} // namespace VatEFS
@@ -0,0 +1,173 @@
+#include "trackhistory.h"
+
+#include <cmath>
+
+namespace VatEFS
+{
+
+static constexpr double COORDINATE_SCALE = 1e5; // 1e-5 degrees, about a meter
+
+// Delta-of-delta classes: prefix, prefix length and value bits, as in the Gorilla paper except
+// that the last class takes any value rather than 32 bits
+struct DeltaClass {
+    std::uint32_t prefix;
+    int prefixBits;
+    int valueBits;
+};
+static constexpr DeltaClass DELTA_CLASSES[] = {
+    { 0b10, 2, 7 }, { 0b110, 3, 9 }, { 0b1110, 4, 12 }, { 0b1111, 4, 64 }
+};
+
+namespace
+{
+class BitReader
+{
+    public:
+    explicit BitReader(const std::uint8_t *data) : bits(data), position(0)
+    {
+    }
+
+    std::uint64_t Read(int count)
+    {
+        std::uint64_t value = 0;
+        for (int i = 0; i < count; i++, position++)
+            value = (value << 1) | ((bits[position >> 3] >> (7 - (position & 7))) & 1);
+        return value;
+    }
+
+    std::int64_t ReadDeltaOfDelta()
+    {
+        if (Read(1) == 0) return 0;
+        int ones = 1;
+        while (ones < 4 && Read(1) == 1)
+            ones++;
+        const int valueBits = DELTA_CLASSES[ones - 1].valueBits;
+        const std::uint64_t raw = Read(valueBits);
+        // Sign-extend
+        const std::uint64_t sign = std::uint64_t(1) << (valueBits - 1);
+        return static_cast<std::int64_t>((raw ^ sign) - sign);
+    }
+
+    private:
+    const std::uint8_t *bits;
+    std::size_t position;
+};
+} // namespace
+
+void TrackHistory::ToFields(const Sample &sample, std::time_t start, std::int64_t *fields)
+{
+    fields[0] = static_cast<std::int64_t>(sample.time - start);
+    fields[1] = std::llround(sample.latitude * COORDINATE_SCALE);
+    fields[2] = std::llround(sample.longitude * COORDINATE_SCALE);
+    fields[3] = sample.altitude;
+    fields[4] = sample.groundSpeed;
+}
+
+void TrackHistory::WriteBits(Block &block, std::uint64_t value, int count)
+{
+    for (int i = count - 1; i >= 0; i--, block.bitCount++) {
+        if ((block.bitCount & 7) == 0) block.bits[block.bitCount >> 3] = 0;
+        if ((value >> i) & 1)
+            block.bits[block.bitCount >> 3] |= static_cast<std::uint8_t>(0x80 >> (block.bitCount & 7));
+    }
+}
+
+void TrackHistory::WriteDeltaOfDelta(Block &block, std::int64_t value)
+{
+    if (value == 0) {
+        WriteBits(block, 0, 1);
+        return;
+    }
+    for (const DeltaClass &c : DELTA_CLASSES) {
+        const std::int64_t limit = c.valueBits < 64 ? std::int64_t(1) << (c.valueBits - 1) : 0;
+        if (limit == 0 || (value >= -limit && value < limit)) {
+            WriteBits(block, c.prefix, c.prefixBits);
+            WriteBits(block, static_cast<std::uint64_t>(value), c.valueBits);
+            return;
+        }
+    }
+}
+
+TrackHistory::Block &TrackHistory::NewBlock(std::time_t start)
+{
+    if (used == blocks.size()) {
+        // No block to reuse - grow the ring, keeping its order
+        blocks.insert(blocks.begin() + first, Block());
+        if (used > 0) first++;
+    }
+    used++;
+    Block &block = At(used - 1);
+    block.start = block.end = start;
+    block.count = 0;
+    block.bitCount = 0;
+    for (int i = 0; i < FIELDS; i++)
+        previous[i] = previousDelta[i] = 0;
+    return block;
+}
+
+void TrackHistory::Add(const Sample &sample)
+{
+    if (used > 0 && sample.time <= At(used - 1).end) return;
+
+    // Drop what has left the window, keeping at least the last block
+    while (used > 1 && At(0).end < sample.time - WINDOW_SECONDS) {
+        first = (first + 1) % blocks.size();
+        used--;
+    }
+
+    Block *block = used > 0 ? &At(used - 1) : nullptr;
+    if (block == nullptr || block->count == BLOCK_SAMPLES ||
+        block->bitCount + MAX_SAMPLE_BITS > BLOCK_BYTES * std::size_t(8))
+        block = &NewBlock(sample.time);
+    std::int64_t fields[FIELDS];
+    ToFields(sample, block->start, fields);
+    for (int i = 0; i < FIELDS; i++) {
+        const std::int64_t delta = fields[i] - previous[i];
+        WriteDeltaOfDelta(*block, delta - previousDelta[i]);
+        previousDelta[i] = delta;
+        previous[i] = fields[i];
+    }
+    block->end = sample.time;
+    block->count++;
+}
+
+void TrackHistory::Clear()
+{
+    first = 0;
+    used = 0;
+}
+
+void TrackHistory::Query(std::time_t from, std::time_t to, std::vector<Sample> &out) const
+{
+    for (std::size_t b = 0; b < used; b++) {
+        const Block &block = At(b);
+        if (block.end < from || block.start > to) continue;
+        BitReader reader(block.bits);
+        std::int64_t value[FIELDS] = {}, delta[FIELDS] = {};
+        for (int n = 0; n < block.count; n++) {
+            for (int i = 0; i < FIELDS; i++) {
+                delta[i] += reader.ReadDeltaOfDelta();
+                value[i] += delta[i];
+            }
+            const std::time_t time = block.start + static_cast<std::time_t>(value[0]);
+            if (time < from || time > to) continue;
+            out.push_back({ time, value[1] / COORDINATE_SCALE, value[2] / COORDINATE_SCALE,
+                            static_cast<int>(value[3]), static_cast<int>(value[4]) });
+        }
+    }
+}
+
+int TrackHistory::Count() const
+{
+    int count = 0;
+    for (std::size_t b = 0; b < used; b++)
+        count += At(b).count;
+    return count;
+}
+
+std::size_t TrackHistory::MemoryUsage() const
+{
+    return sizeof(*this) + blocks.capacity() * sizeof(Block);
+}
+
+} // namespace VatEFS
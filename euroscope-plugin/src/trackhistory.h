@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+namespace VatEFS
+{
+
+// Recent positions of one target, compressed Gorilla-style: each field is stored as the
+// difference between successive deltas, in as few bits as it needs. With regular updates most of
+// those are zero or small, so a sample takes a few bytes. Samples are kept in fixed-size blocks
+// that can be decoded on their own. Blocks that have left the window are reused for new samples,
+// so once the window is full adding a sample doesn't allocate.
+class TrackHistory
+{
+    public:
+    static constexpr int WINDOW_SECONDS = 30 * 60;
+    static constexpr int BLOCK_SAMPLES = 64;
+    static constexpr int BLOCK_BYTES = 512; // about 64 samples of regular updates
+
+    struct Sample {
+        std::time_t time;
+        double latitude;
+        double longitude;
+        int altitude;    // ft
+        int groundSpeed; // kt
+    };
+
+    // Samples must come in time order, ones no newer than the last are ignored
+    void Add(const Sample &sample);
+    void Clear();
+    // Appends the samples from..to (inclusive) to out
+    void Query(std::time_t from, std::time_t to, std::vector<Sample> &out) const;
+
+    int Count() const;
+    // Bytes held, including unused capacity
+    std::size_t MemoryUsage() const;
+
+    private:
+    static constexpr int FIELDS = 5; // time, latitude, longitude, altitude, ground speed
+
+    // A sample takes at most a 4 bit prefix and 64 value bits per field
+    static constexpr std::size_t MAX_SAMPLE_BITS = FIELDS * (4 + 64);
+
+    struct Block {
+        std::time_t start = 0; // times are stored relative to this
+        std::time_t end = 0;
+        int count = 0;
+        std::size_t bitCount = 0;
+        std::uint8_t bits[BLOCK_BYTES];
+    };
+
+    static void ToFields(const Sample &sample, std::time_t start, std::int64_t *fields);
+    void WriteBits(Block &block, std::uint64_t value, int count);
+    void WriteDeltaOfDelta(Block &block, std::int64_t value);
+    Block &NewBlock(std::time_t start);
+    Block &At(std::size_t i) { return blocks[(first + i) % blocks.size()]; }
+    const Block &At(std::size_t i) const { return blocks[(first + i) % blocks.size()]; }
+
+    // Ring of blocks, used from first, oldest first
+    std::vector<Block> blocks;
+    std::size_t first = 0;
+    std::size_t used = 0;
+    // Encoder state for the last block
+    std::int64_t previous[FIELDS] = {};
+    std::int64_t previousDelta[FIELDS] = {};
+};
+
+} // namespace VatEFS
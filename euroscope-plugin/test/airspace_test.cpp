@@ -0,0 +1,159 @@
+#include "airspace.h"
+#include "check.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace VatEFS;
+
+// Polygon approximating a circle, with points counter-clockwise
+static std::vector<GeoPoint> Circle(double latitude, double longitude, double radius, int points)
+{
+    std::vector<GeoPoint> polygon;
+    for (int i = 0; i < points; i++) {
+        const double angle = i * 2 * 3.14159265358979323846 / points;
+        polygon.push_back({ latitude + radius * std::sin(angle), longitude + radius * 2 * std::cos(angle) });
+    }
+    return polygon;
+}
+
+// Brute force over all zones, the reference for both lookups
+static int FindLinear(const AirspaceIndex &index, GeoPoint position, int altitude)
+{
+    int found = AirspaceIndex::NONE;
+    for (int i = 0; i < index.Count(); i++) {
+        const AirspaceIndex::Zone &zone = index.Get(i);
+        const bool withinLimits = (zone.lowerFt == AirspaceIndex::SURFACE || altitude >= zone.lowerFt) &&
+                                  altitude <= zone.upperFt;
+        if (!withinLimits || !PointInPolygon(position, zone.points)) continue;
+        if (found == AirspaceIndex::NONE || zone.upperFt < index.Get(found).upperFt) found = i;
+    }
+    return found;
+}
+
+static AirspaceIndex MakeIndex()
+{
+    AirspaceIndex index;
+    // A CTR with a TIZ below part of it, and a grid of small zones for a tree of several levels
+    index.Add("ESGG CTR", "ESGG", AirspaceIndex::SURFACE, 4500, Circle(57.66, 12.28, 0.2, 48));
+    index.Add("ESGP TIZ", "ESGP", AirspaceIndex::SURFACE, 1500, Circle(57.72, 12.1, 0.08, 24));
+    for (int row = 0; row < 12; row++) {
+        for (int column = 0; column < 12; column++) {
+            char name[16];
+            std::snprintf(name, sizeof(name), "Z%d.%d", row, column);
+            index.Add(name, "ESXX", 1000 * (row % 3), 3000 + 1000 * (column % 4),
+                      Circle(58.5 + row * 0.13, 13.0 + column * 0.27, 0.05, 12));
+        }
+    }
+    index.Build();
+    return index;
+}
+
+static void TestKnownPositions()
+{
+    const AirspaceIndex index = MakeIndex();
+    CHECK(!index.NeedsBuild());
+    const int ctr = 0, tiz = 1;
+
+    // Center of the CTR, in the cell lookup and the R-tree
+    const GeoPoint landvetter = { 57.66, 12.28 };
+    const int cell = index.FindCell(AirspaceIndex::CellKey(landvetter));
+    CHECK(cell != AirspaceIndex::NONE);
+    CHECK(index.Find(cell, landvetter, 2000) == ctr);
+    CHECK(index.Find(landvetter, 2000) == ctr);
+    CHECK(index.Find(landvetter, 5000) == AirspaceIndex::NONE); // above
+
+    // Overlap: the zone with the lowest upper limit
+    const GeoPoint save = { 57.72, 12.1 };
+    CHECK(index.Find(save, 1000) == tiz);
+    CHECK(index.Find(save, 3000) == ctr);
+
+    // Far away, no cell at all
+    const GeoPoint away = { 40.0, 0.0 };
+    CHECK(index.FindCell(AirspaceIndex::CellKey(away)) == AirspaceIndex::NONE);
+    CHECK(index.Find(away, 1000) == AirspaceIndex::NONE);
+}
+
+static void TestCellsAgreeWithTree()
+{
+    const AirspaceIndex index = MakeIndex();
+    int checked = 0, inside = 0, disagreements = 0;
+    for (double latitude = 57.3; latitude < 60.2; latitude += 0.0071) {
+        for (double longitude = 11.5; longitude < 16.5; longitude += 0.0113) {
+            const GeoPoint position = { latitude, longitude };
+            const int altitude = (checked * 37) % 6000;
+            const int expected = FindLinear(index, position, altitude);
+            const int cell = index.FindCell(AirspaceIndex::CellKey(position));
+            if (index.Find(cell, position, altitude) != expected) disagreements++;
+            if (index.Find(position, altitude) != expected) disagreements++;
+            if (expected != AirspaceIndex::NONE) inside++;
+            checked++;
+        }
+    }
+    CHECK(disagreements == 0);
+    CHECK(inside > 1000); // the grid actually hits the zones
+    if (disagreements != 0)
+        std::fprintf(stderr, "  %d disagreements in %d positions\n", disagreements, checked);
+}
+
+// Not a pass/fail check, the numbers depend on the machine - printed for comparison. The cell is
+// looked up for every position here, the plugin only does so when a target changes cells.
+static void TimeLookups()
+{
+    const AirspaceIndex index = MakeIndex();
+    std::vector<GeoPoint> positions;
+    for (double latitude = 57.3; latitude < 60.2; latitude += 0.0373)
+        for (double longitude = 11.5; longitude < 16.5; longitude += 0.0411)
+            positions.push_back({ latitude, longitude });
+    constexpr int ROUNDS = 5;
+    using Clock = std::chrono::steady_clock;
+    long long linearSum = 0, treeSum = 0, cellSum = 0; // so that the loops aren't optimized away
+
+    const Clock::time_point linearStart = Clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (const GeoPoint &position : positions)
+            linearSum += FindLinear(index, position, 2000);
+    }
+    const Clock::time_point treeStart = Clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (const GeoPoint &position : positions)
+            treeSum += index.Find(position, 2000);
+    }
+    const Clock::time_point cellStart = Clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (const GeoPoint &position : positions)
+            cellSum += index.Find(index.FindCell(AirspaceIndex::CellKey(position)), position, 2000);
+    }
+    const Clock::time_point end = Clock::now();
+
+    CHECK(treeSum == linearSum && cellSum == linearSum);
+    const auto ns = [&](Clock::duration duration) {
+        const double count = ROUNDS * double(positions.size());
+        return std::chrono::duration<double, std::nano>(duration).count() / count;
+    };
+    const int zones = index.Count();
+    std::printf("  %d zones, every zone:    %.1f ns/position\n", zones, ns(treeStart - linearStart));
+    std::printf("  %d zones, R-tree:        %.1f ns/position\n", zones, ns(cellStart - treeStart));
+    std::printf("  %d zones, cell and tree: %.1f ns/position\n", zones, ns(end - cellStart));
+}
+
+static void TestEmpty()
+{
+    AirspaceIndex index;
+    index.Build();
+    CHECK(index.Count() == 0);
+    CHECK(index.Find({ 57.66, 12.28 }, 1000) == AirspaceIndex::NONE);
+    index.Add("Line", "ESGG", AirspaceIndex::SURFACE, 1000, { { 57, 12 }, { 58, 12 } });
+    CHECK(index.Count() == 0); // not a polygon
+}
+
+int main()
+{
+    TestKnownPositions();
+    TestCellsAgreeWithTree();
+    TestEmpty();
+    TimeLookups();
+    return CheckResult();
+}
@@ -0,0 +1,120 @@
+#include "allocaccounting.h"
+#include "check.h"
+#include "jsonwriter.h"
+#include "outputbufferpool.h"
+#include "targettable.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Built with VATEFS_ALLOC_ACCOUNTING. Runs the parts of the radar target update path that don't
+// need EuroScope - target lookup, history, buffer and serialization - the way
+// OnRadarTargetPositionUpdate does, and checks that once warmed up they don't allocate.
+
+using namespace VatEFS;
+
+static constexpr int TARGETS = 300;
+static constexpr int UPDATE_SECONDS = 5;
+
+struct Fixture {
+    TargetTable targets;
+    OutputBufferPool outputBuffers;
+    std::vector<std::string> excludedFields = { "verticalSpeed", "heading" };
+    std::vector<BoundedString<20>> callsigns;
+    std::size_t bytesSent = 0;
+
+    Fixture()
+    {
+        for (int i = 0; i < TARGETS; i++) {
+            char callsign[16];
+            std::snprintf(callsign, sizeof(callsign), "SAS%d", 100 + i);
+            callsigns.emplace_back(callsign);
+        }
+    }
+
+    void RadarUpdate(int i, std::time_t now)
+    {
+        AllocScope allocScope(ALLOC_RADAR);
+        const int id = targets.Insert(callsigns[i]);
+        targets.lastSeen[id] = now;
+        const double latitude = 57.66 + (now % 3600) * 0.0001 + i * 0.001;
+        const double longitude = 12.28 + i * 0.001;
+        const int altitude = 3000 + i * 10;
+        const int groundSpeed = 180 + i % 20;
+        targets.latitude[id] = latitude;
+        targets.longitude[id] = longitude;
+        targets.altitude[id] = altitude;
+        targets.groundSpeed[id] = groundSpeed;
+        targets.hasPosition[id] = 1;
+        targets.history[id].Add({ now, latitude, longitude, altitude, groundSpeed });
+        targets.positionVersion[id]++;
+
+        PooledBuffer buffer = outputBuffers.Acquire(OutputBufferPool::SMALL);
+        std::string &line = buffer.Str();
+        JsonWriter message(line);
+        message.Exclude(excludedFields);
+        message.BeginObject();
+        message.String("type", "radarTargetPositionUpdate");
+        message.String("callsign", callsigns[i]);
+        message.Int("verticalSpeed", 0);
+        message.Int("groundSpeed", groundSpeed);
+        message.Double("latitude", latitude);
+        message.Double("longitude", longitude);
+        message.Int("altitude", altitude);
+        message.Int("heading", 90);
+        message.String("squawk", "1234");
+        message.String("controller", "ESGG_TWR");
+        message.EndObject();
+        bytesSent += line.size();
+        targets.sentPositionVersion[id] = targets.positionVersion[id];
+    }
+
+    void Tick(std::time_t now)
+    {
+        for (int i = 0; i < TARGETS; i++)
+            RadarUpdate(i, now);
+    }
+};
+
+static void TestRadarUpdatesDontAllocate()
+{
+    Fixture fixture;
+    std::time_t now = 1700000000;
+    // Warm-up: targets are inserted and the history windows fill up
+    const int warmupTicks = 2 * TrackHistory::WINDOW_SECONDS / UPDATE_SECONDS;
+    for (int tick = 0; tick < warmupTicks; tick++, now += UPDATE_SECONDS)
+        fixture.Tick(now);
+
+    ResetAllocCounters();
+    for (int tick = 0; tick < warmupTicks; tick++, now += UPDATE_SECONDS)
+        fixture.Tick(now);
+    const AllocCounters &counters = GetAllocCounters();
+    CHECK(counters.calls[ALLOC_RADAR] == static_cast<unsigned long long>(warmupTicks) * TARGETS);
+    CHECK(counters.allocations[ALLOC_RADAR] == 0);
+    if (counters.allocations[ALLOC_RADAR] != 0)
+        std::fprintf(stderr, "%llu allocations in %llu radar updates\n", counters.allocations[ALLOC_RADAR],
+                     counters.calls[ALLOC_RADAR]);
+    CHECK(fixture.bytesSent > 0);
+    CHECK(fixture.outputBuffers.Stats(OutputBufferPool::SMALL).allocated == 0);
+}
+
+static void TestCountsAllocations()
+{
+    // The accounting itself: an allocation in a scope is counted against it
+    ResetAllocCounters();
+    {
+        AllocScope allocScope(ALLOC_TIMER);
+        std::vector<int> *v = new std::vector<int>(100);
+        delete v;
+    }
+    CHECK(GetAllocCounters().calls[ALLOC_TIMER] == 1);
+    CHECK(GetAllocCounters().allocations[ALLOC_TIMER] == 2);
+}
+
+int main()
+{
+    TestCountsAllocations();
+    TestRadarUpdatesDontAllocate();
+    return CheckResult();
+}
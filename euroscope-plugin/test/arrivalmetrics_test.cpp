@@ -0,0 +1,198 @@
+#include "arrivalmetrics.h"
+#include "check.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace VatEFS;
+
+static constexpr double NM_PER_DEGREE = 3440.065 * 3.14159265358979323846 / 180; // on a great circle
+
+static bool Near(double a, double b, double tolerance)
+{
+    return std::fabs(a - b) <= tolerance;
+}
+
+struct Track {
+    double latitude, longitude, thresholdLatitude, thresholdLongitude;
+    int groundSpeed, heading;
+};
+
+struct Metrics {
+    double distance, closure, eta;
+};
+
+static std::vector<Metrics> Compute(const std::vector<Track> &tracks)
+{
+    const int count = static_cast<int>(tracks.size());
+    std::vector<double> latitude, longitude, thresholdLatitude, thresholdLongitude;
+    std::vector<int> groundSpeed, heading;
+    for (const Track &track : tracks) {
+        latitude.push_back(track.latitude);
+        longitude.push_back(track.longitude);
+        thresholdLatitude.push_back(track.thresholdLatitude);
+        thresholdLongitude.push_back(track.thresholdLongitude);
+        groundSpeed.push_back(track.groundSpeed);
+        heading.push_back(track.heading);
+    }
+    std::vector<double> distance(count), closure(count), eta(count);
+    ComputeArrivalMetrics(count, latitude.data(), longitude.data(), thresholdLatitude.data(),
+                          thresholdLongitude.data(), groundSpeed.data(), heading.data(), distance.data(),
+                          closure.data(), eta.data());
+    std::vector<Metrics> metrics;
+    for (int i = 0; i < count; i++)
+        metrics.push_back({ distance[i], closure[i], eta[i] });
+    return metrics;
+}
+
+static void TestKnownTracks()
+{
+    const std::vector<Metrics> metrics = Compute({
+        { 0, 1, 0, 0, 300, 270 },                // on the equator, inbound from the east
+        { 56.0, 17.9, 57.0, 17.9, 240, 0 },      // along a meridian, inbound from the south
+        { 58.0, 17.9, 57.0, 17.9, 240, 0 },      // outbound to the north
+        { 57.0, 16.0, 57.0, 17.9, 240, 180 },    // crossing at right angles
+        { 59.65, 17.93, 59.65, 17.93, 140, 10 }, // at the threshold
+        { 59.0, 17.9, 59.65, 17.93, 180, 45 },   // 45 degrees off
+    });
+
+    CHECK(Near(metrics[0].distance, NM_PER_DEGREE, 0.01));
+    CHECK(Near(metrics[0].closure, 300, 0.01));
+    CHECK(Near(metrics[0].eta, NM_PER_DEGREE / 300 * 3600, 0.5));
+
+    CHECK(Near(metrics[1].distance, NM_PER_DEGREE, 0.01));
+    CHECK(Near(metrics[1].closure, 240, 0.01));
+    CHECK(Near(metrics[1].eta, 900.6, 0.5));
+
+    // Moving away: a negative closure, and the ETA at the minimum closure rate of 60 kt
+    CHECK(Near(metrics[2].closure, -240, 0.01));
+    CHECK(Near(metrics[2].eta, NM_PER_DEGREE / 60 * 3600, 0.5));
+
+    // Along a parallel, the great circle bearing is a bit north of east (about 0.8 degrees here)
+    const double parallel = 1.9 * NM_PER_DEGREE * std::cos(57.0 * 3.14159265358979323846 / 180);
+    CHECK(Near(metrics[3].distance, parallel, 0.1));
+    CHECK(std::fabs(metrics[3].closure) < 240 * 0.05);
+
+    CHECK(metrics[4].distance == 0);
+    CHECK(metrics[4].eta == 0);
+
+    // Bearing about 1.3 degrees, so the heading is about 43.7 degrees off
+    CHECK(Near(metrics[5].distance, 39.04, 0.01));
+    CHECK(Near(metrics[5].closure, 130.2, 0.1));
+}
+
+static void TestApproach()
+{
+    // A straight-in approach: the distance and ETA count down steadily with the ground speed
+    std::vector<Track> tracks;
+    for (int second = 0; second <= 600; second += 5) {
+        const double distance = 20 - second * 120 / 3600.0; // nm at 120 kt
+        tracks.push_back({ 59.65 - distance / NM_PER_DEGREE, 17.93, 59.65, 17.93, 120, 0 });
+    }
+    const std::vector<Metrics> metrics = Compute(tracks);
+    int off = 0;
+    for (std::size_t i = 0; i < metrics.size(); i++) {
+        const double expectedEta = 600 - i * 5.0;
+        if (!Near(metrics[i].eta, expectedEta, 1.0) || !Near(metrics[i].closure, 120, 0.01)) off++;
+    }
+    CHECK(off == 0);
+}
+
+static void TestThresholds()
+{
+    ArrivalThresholds thresholds;
+    thresholds.AddAirport("ESSA", { 59.65, 17.93 });
+    thresholds.AddRunwayEnd("ESSA", "19R", { 59.67, 17.93 });
+    GeoPoint threshold;
+    CHECK(thresholds.Find("ESSA", "19R", threshold) && threshold.latitude == 59.67);
+    CHECK(thresholds.Find("ESSA", "26", threshold) && threshold.latitude == 59.65); // the airport
+    CHECK(thresholds.Find("ESSA", "", threshold) && threshold.latitude == 59.65);
+    CHECK(!thresholds.Find("ESGG", "21", threshold));
+    thresholds.Clear();
+    CHECK(!thresholds.Find("ESSA", "19R", threshold));
+}
+
+// The per-target version ComputeArrivalMetrics is measured against: one target at a time, with the
+// early exits a scalar implementation would take
+static void ComputeOne(const Track &track, Metrics &metrics)
+{
+    constexpr double DEG_TO_RAD = 3.14159265358979323846 / 180;
+    const double lat1 = track.latitude * DEG_TO_RAD, lat2 = track.thresholdLatitude * DEG_TO_RAD;
+    const double dLon = (track.thresholdLongitude - track.longitude) * DEG_TO_RAD;
+    const double sinLat = std::sin((lat2 - lat1) * 0.5), sinLon = std::sin(dLon * 0.5);
+    const double a = sinLat * sinLat + std::cos(lat1) * std::cos(lat2) * sinLon * sinLon;
+    metrics.distance = 2 * 3440.065 * std::asin(std::sqrt(std::min(a, 1.0)));
+    if (metrics.distance == 0) {
+        metrics.closure = track.groundSpeed;
+        metrics.eta = 0;
+        return;
+    }
+    const double y = std::sin(dLon) * std::cos(lat2);
+    const double x = std::cos(lat1) * std::sin(lat2) - std::sin(lat1) * std::cos(lat2) * std::cos(dLon);
+    const double bearing = std::atan2(y, x);
+    metrics.closure = track.groundSpeed * std::cos(track.heading * DEG_TO_RAD - bearing);
+    metrics.eta = metrics.distance / (metrics.closure < 60 ? 60 : metrics.closure) * 3600;
+}
+
+// Not a pass/fail check, the numbers depend on the machine - printed for comparison
+static void TimeKernel()
+{
+    constexpr int TARGETS = 5000;
+    constexpr int ROUNDS = 200;
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<Track> tracks;
+    for (int i = 0; i < TARGETS; i++) {
+        tracks.push_back({ 55.0 + (i % 100) * 0.05, 11.0 + (i / 100) * 0.15, 59.65, 17.93, 120 + i % 300,
+                           (i * 7) % 360 });
+    }
+    std::vector<double> latitude, longitude, thresholdLatitude, thresholdLongitude;
+    std::vector<int> groundSpeed, heading;
+    for (const Track &track : tracks) {
+        latitude.push_back(track.latitude);
+        longitude.push_back(track.longitude);
+        thresholdLatitude.push_back(track.thresholdLatitude);
+        thresholdLongitude.push_back(track.thresholdLongitude);
+        groundSpeed.push_back(track.groundSpeed);
+        heading.push_back(track.heading);
+    }
+    std::vector<double> distance(TARGETS), closure(TARGETS), eta(TARGETS);
+    std::vector<Metrics> metrics(TARGETS);
+
+    const Clock::time_point scalarStart = Clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < TARGETS; i++)
+            ComputeOne(tracks[i], metrics[i]);
+    }
+    const Clock::time_point kernelStart = Clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        ComputeArrivalMetrics(TARGETS, latitude.data(), longitude.data(), thresholdLatitude.data(),
+                              thresholdLongitude.data(), groundSpeed.data(), heading.data(), distance.data(),
+                              closure.data(), eta.data());
+    }
+    const Clock::time_point end = Clock::now();
+
+    int disagreements = 0;
+    for (int i = 0; i < TARGETS; i++) {
+        if (!Near(metrics[i].eta, eta[i], 1e-6 * eta[i])) disagreements++;
+    }
+    CHECK(disagreements == 0);
+    const auto ns = [](Clock::duration duration) {
+        return std::chrono::duration<double, std::nano>(duration).count() / (ROUNDS * double(TARGETS));
+    };
+    std::printf("  %d targets, one at a time:         %.1f ns/target\n", TARGETS,
+                ns(kernelStart - scalarStart));
+    std::printf("  %d targets, ComputeArrivalMetrics: %.1f ns/target\n", TARGETS, ns(end - kernelStart));
+}
+
+int main()
+{
+    TestKnownTracks();
+    TestApproach();
+    TestThresholds();
+    TimeKernel();
+    return CheckResult();
+}
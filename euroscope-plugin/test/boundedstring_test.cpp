@@ -0,0 +1,160 @@
+#include "boundedstring.h"
+#include "check.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace VatEFS;
+
+static void TestNullAndEmpty()
+{
+    BoundedString<8> null(nullptr);
+    CHECK(null.IsNull() && null.IsEmpty() && !null.IsValid());
+    CHECK(null.View().empty() && null.CStr()[0] == '\0');
+
+    BoundedString<8> empty("");
+    CHECK(!empty.IsNull() && empty.IsEmpty() && empty.IsValid() && empty.IsAscii());
+
+    // A default constructed one is null too
+    BoundedString<8> unset;
+    CHECK(unset.IsNull() && unset.IsEmpty());
+}
+
+static void TestLength()
+{
+    BoundedString<4> exact("7000");
+    CHECK(exact.Length() == 4 && !exact.IsTooLong() && exact.IsValid());
+    CHECK(exact == "7000");
+
+    BoundedString<4> over("70001");
+    CHECK(over.IsTooLong() && !over.IsValid() && !over.IsAscii());
+    CHECK(over.Length() == 4 && over == "7000"); // truncated
+    CHECK(std::strlen(over.CStr()) == 4);
+
+    // Reassigning clears the flags of the previous value
+    over.Assign("12");
+    CHECK(!over.IsTooLong() && over.IsValid() && over == "12");
+    over.Assign(nullptr);
+    CHECK(over.IsNull() && over.IsEmpty());
+}
+
+static void TestUtf8()
+{
+    // Å and € (2 and 3 bytes) and an emoji (4 bytes)
+    BoundedString<16> valid("\xC3\x85re \xE2\x82\xAC \xF0\x9F\x98\x80");
+    CHECK(valid.IsValidUtf8() && valid.IsValid() && !valid.IsAscii());
+    CHECK(valid.Length() == 13);
+
+    CHECK(!BoundedString<8>("\x80").IsValidUtf8());           // lone continuation byte
+    CHECK(!BoundedString<8>("\xC0\xAF").IsValidUtf8());       // overlong lead byte
+    CHECK(!BoundedString<8>("\xF5\x80\x80\x80").IsValidUtf8()); // beyond U+10FFFF
+    CHECK(!BoundedString<8>("\xFF").IsValidUtf8());
+    CHECK(!BoundedString<8>("\xC3").IsValidUtf8());           // truncated at the end
+    CHECK(!BoundedString<8>("\xE2\x82").IsValidUtf8());
+    CHECK(!BoundedString<8>("\xC3 x").IsValidUtf8());         // continuation missing
+    CHECK(!BoundedString<8>("\xE2\x82" "A").IsValidUtf8());
+
+    // Cutting a sequence short at MaxLength leaves invalid UTF-8 behind
+    BoundedString<4> cut("abc\xC3\x85");
+    CHECK(cut.IsTooLong() && !cut.IsValidUtf8() && cut.Length() == 4);
+    BoundedString<5> fits("abc\xC3\x85");
+    CHECK(!fits.IsTooLong() && fits.IsValidUtf8());
+
+    // Invalid UTF-8 is still copied as it is, for the callers that replace it
+    BoundedString<8> latin1("\xE5");
+    CHECK(!latin1.IsValid() && latin1.Length() == 1 && latin1.CStr()[0] == '\xE5');
+}
+
+static void TestAscii()
+{
+    CHECK(BoundedString<32>("N0450F360 LABAN T317 RISMA").IsAscii());
+    CHECK(BoundedString<8>("\x01\x7F").IsAscii());
+    CHECK(!BoundedString<8>("G\xC3\xB6teborg").IsAscii());
+    CHECK(!BoundedString<8>("\xE5").IsAscii()); // neither ASCII nor valid UTF-8
+}
+
+// What each field used to go through: a null check, strlen, a copy into a std::string and a
+// separate validation pass (VatEFSPlugin::IsValidUtf8 as it was)
+static bool BaselineIsValidUtf8(const char *str)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(str);
+    while (*p) {
+        unsigned char c = *p++;
+        if (c <= 0x7F) continue;
+        if (c >= 0xC2 && c <= 0xDF) {
+            if ((*p++ & 0xC0) != 0x80) return false;
+            continue;
+        }
+        if (c >= 0xE0 && c <= 0xEF) {
+            if ((*p & 0xC0) != 0x80) return false;
+            p++;
+            if ((*p++ & 0xC0) != 0x80) return false;
+            continue;
+        }
+        if (c >= 0xF0 && c <= 0xF4) {
+            if ((*p & 0xC0) != 0x80) return false;
+            p++;
+            if ((*p & 0xC0) != 0x80) return false;
+            p++;
+            if ((*p++ & 0xC0) != 0x80) return false;
+            continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+static bool BaselineExtract(const char *str, std::size_t maxLength, std::string &out)
+{
+    if (!str || std::strlen(str) > maxLength) return false;
+    out = str;
+    return BaselineIsValidUtf8(out.c_str());
+}
+
+// Not a pass/fail check, the numbers depend on the machine - printed for comparison
+static void TimeAgainstBaseline()
+{
+    const std::vector<const char *> fields = { "SAS123", "ESGG", "ESSA", "A320", "IFR", "ESGG_TWR",
+                                               "N0450F360 LABAN T317 RISMA", "G\xC3\xB6teborg",
+                                               "ARRIVED", "7000" };
+    constexpr int ROUNDS = 200000;
+    using Clock = std::chrono::steady_clock;
+    std::size_t validCount = 0; // so that the loops aren't optimized away
+
+    const Clock::time_point baselineStart = Clock::now();
+    std::string copy;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (const char *field : fields) {
+            if (BaselineExtract(field, 50, copy)) validCount += copy.size();
+        }
+    }
+    const Clock::time_point boundedStart = Clock::now();
+    BoundedString<50> bounded;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (const char *field : fields) {
+            bounded.Assign(field);
+            if (bounded.IsValid()) validCount -= bounded.Length();
+        }
+    }
+    const Clock::time_point end = Clock::now();
+
+    CHECK(validCount == 0); // both accept the same fields
+    const auto ns = [](Clock::duration duration) {
+        return std::chrono::duration<double, std::nano>(duration).count() / (ROUNDS * 10.0);
+    };
+    std::printf("  strlen + std::string + validate: %.1f ns/field\n", ns(boundedStart - baselineStart));
+    std::printf("  BoundedString::Assign:           %.1f ns/field\n", ns(end - boundedStart));
+}
+
+int main()
+{
+    TestNullAndEmpty();
+    TestLength();
+    TestUtf8();
+    TestAscii();
+    TimeAgainstBaseline();
+    return CheckResult();
+}
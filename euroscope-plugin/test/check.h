@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal test support: CHECK reports a failed condition and carries on, and main returns
+// CheckResult() so that the test fails if any check did.
+inline int checkFailures = 0;
+
+#define CHECK(condition)                                                                           \
+    do {                                                                                           \
+        if (!(condition)) {                                                                        \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition);     \
+            checkFailures++;                                                                       \
+        }                                                                                          \
+    } while (false)
+
+inline int CheckResult()
+{
+    if (checkFailures > 0) std::fprintf(stderr, "%d check(s) failed\n", checkFailures);
+    return checkFailures > 0 ? 1 : 0;
+}
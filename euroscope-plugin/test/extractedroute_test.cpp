@@ -0,0 +1,69 @@
+#include "check.h"
+#include "extractedroute.h"
+
+using namespace VatEFS;
+
+static void TestFindByHash()
+{
+    ExtractedRouteCache cache;
+    const std::uint64_t hash = ExtractedRouteCache::Hash("N0450F360 LABAN T317 RISMA");
+    ExtractedRouteCache::Route &route = cache.Reset("SAS123", hash, 3);
+    cache.Add(route, "ESGG", "", 57.6628, 12.2798, 0);
+    cache.Add(route, "LABAN", "", 57.9, 12.9, 25.04);
+    cache.Add(route, "RISMA", "T317", 59.1, 17.3, 187.96);
+
+    const ExtractedRouteCache::Route *found = cache.Find("SAS123", hash);
+    CHECK(found != nullptr);
+    if (found == nullptr) return;
+    CHECK(found->version == 3);
+    CHECK(found->points.size() == 3);
+    CHECK(cache.Name(found->points[1].name) == "LABAN");
+    CHECK(found->points[0].airway == ExtractedRouteCache::NO_NAME);
+    CHECK(cache.Name(found->points[2].airway) == "T317");
+    CHECK(found->points[0].latitude == 5766280);
+    CHECK(found->points[0].longitude == 1227980);
+    CHECK(found->points[2].distance == 1880); // 0.1 nm
+
+    // Another source hash means the route has to be extracted again
+    CHECK(cache.Find("SAS123", ExtractedRouteCache::Hash("DCT")) == nullptr);
+    CHECK(cache.Find("SAS456", hash) == nullptr);
+
+    // Reset empties it
+    cache.Reset("SAS123", hash, 4);
+    found = cache.Find("SAS123", hash);
+    CHECK(found != nullptr && found->points.empty() && found->version == 4);
+}
+
+static void TestInterning()
+{
+    ExtractedRouteCache cache;
+    for (const char *callsign : { "SAS1", "SAS2", "SAS3" }) {
+        ExtractedRouteCache::Route &route = cache.Reset(callsign, 1, 0);
+        cache.Add(route, "LABAN", "T317", 57.9, 12.9, 0);
+        cache.Add(route, "RISMA", "T317", 59.1, 17.3, 100);
+    }
+    CHECK(cache.Count() == 3);
+    CHECK(cache.NameCount() == 4); // the empty name, LABAN, RISMA and T317
+
+    cache.Erase("SAS2");
+    CHECK(cache.Count() == 2);
+    cache.Clear();
+    CHECK(cache.Count() == 0);
+    CHECK(cache.NameCount() == 1);
+}
+
+static void TestHashSeparatesFields()
+{
+    using Cache = ExtractedRouteCache;
+    CHECK(Cache::Hash("C", Cache::Hash("AB")) != Cache::Hash("BC", Cache::Hash("A")));
+    CHECK(Cache::Hash("ESGG") == Cache::Hash("ESGG"));
+    CHECK(Cache::Hash("ESGG") != Cache::Hash("ESSA"));
+}
+
+int main()
+{
+    TestFindByHash();
+    TestInterning();
+    TestHashSeparatesFields();
+    return CheckResult();
+}
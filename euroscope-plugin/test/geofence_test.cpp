@@ -0,0 +1,251 @@
+#include "check.h"
+#include "geofence.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+using namespace VatEFS;
+
+static constexpr double PI = 3.14159265358979323846;
+
+// The point east and north of origin by the given meters
+static GeoPoint Offset(GeoPoint origin, double east, double north)
+{
+    return { origin.latitude + north / 111320,
+             origin.longitude + east / (111320 * std::cos(origin.latitude * PI / 180)) };
+}
+
+static bool Near(double a, double b, double tolerance)
+{
+    return std::fabs(a - b) <= tolerance;
+}
+
+// A runway like ESGG 03/21, 3300 m long on 035 degrees
+static const GeoPoint RUNWAY_03 = { 57.6476, 12.2733 };
+static const GeoPoint RUNWAY_21 =
+    Offset(RUNWAY_03, 3300 * std::sin(35 * PI / 180), 3300 * std::cos(35 * PI / 180));
+
+static void TestDistanceAndBearing()
+{
+    const GeoPoint origin = { 57.66, 12.28 };
+    CHECK(Near(DistanceMeters(origin, Offset(origin, 300, 400)), 500, 0.5));
+    CHECK(Near(TrueBearing(origin, Offset(origin, 0, 100)), 0, 0.01));
+    CHECK(Near(TrueBearing(origin, Offset(origin, 100, 0)), 90, 0.01));
+    CHECK(Near(TrueBearing(origin, Offset(origin, -100, -100)), 225, 0.01));
+    CHECK(Near(DistanceMeters(RUNWAY_03, RUNWAY_21), 3300, 5));
+    CHECK(Near(TrueBearing(RUNWAY_03, RUNWAY_21), 35, 0.1));
+
+    const std::vector<GeoPoint> square = { { 0, 0 }, { 0, 1 }, { 1, 1 }, { 1, 0 } };
+    CHECK(PointInPolygon({ 0.5, 0.5 }, square));
+    CHECK(!PointInPolygon({ 1.5, 0.5 }, square));
+    CHECK(!PointInPolygon({ 0.5, -0.01 }, square));
+}
+
+static void TestRunway()
+{
+    GeofenceIndex index;
+    index.AddRunway("ESGG", "03/21", RUNWAY_03, RUNWAY_21);
+    index.AddRunway("ESGG", "zero", RUNWAY_03, RUNWAY_03); // no length, ignored
+    CHECK(index.RunwayCount() == 1);
+
+    // Across the runway: the half width is 75 ft plus the 200 ft buffer, about 84 m
+    const double bearing = TrueBearing(RUNWAY_03, RUNWAY_21) * PI / 180;
+    const auto along = [&](double meters, double right) {
+        return Offset(RUNWAY_03, meters * std::sin(bearing) + right * std::cos(bearing),
+                      meters * std::cos(bearing) - right * std::sin(bearing));
+    };
+    CHECK(index.FindRunway(along(0, 0)) == 0);
+    CHECK(index.FindRunway(along(1650, 0)) == 0);
+    CHECK(index.FindRunway(along(3000, 0)) == 0);
+    CHECK(index.FindRunway(along(1650, 75)) == 0);
+    CHECK(index.FindRunway(along(1650, -75)) == 0);
+    CHECK(index.FindRunway(along(1650, 95)) == GeofenceIndex::NONE);
+    CHECK(index.FindRunway(along(1650, -95)) == GeofenceIndex::NONE);
+    CHECK(index.FindRunway(along(-50, 0)) == GeofenceIndex::NONE); // before the threshold
+    CHECK(index.FindRunway({ 59.65, 17.93 }) == GeofenceIndex::NONE);
+    CHECK(index.Get(0).name == "03/21" && index.AirportName(index.Get(0).airport) == "ESGG");
+}
+
+static void TestStands()
+{
+    GeofenceIndex index;
+    const GeoPoint apron = { 57.6650, 12.2900 };
+    // A polygon stand, and point stands next to it and 150 m away
+    index.AddStand("ESGG", "10", { Offset(apron, 0, 0), Offset(apron, 40, 0), Offset(apron, 40, 60),
+                                   Offset(apron, 0, 60) });
+    index.AddStand("ESGG", "11", { Offset(apron, 70, 30) });
+    index.AddStand("ESGG", "12", { Offset(apron, 220, 30) });
+    index.AddStand("ESGG", "none", {});
+    CHECK(index.StandCount() == 3);
+
+    CHECK(index.FindStand(Offset(apron, 20, 30)) == 0);
+    CHECK(index.FindStand(Offset(apron, 38, 30)) == 0);   // inside the polygon, though nearer 11
+    CHECK(index.FindStand(Offset(apron, 45, 30)) == 1);   // outside the polygon, within 100 m of 11
+    CHECK(index.FindStand(Offset(apron, 150, 30)) == 2);  // the nearest of the two point stands
+    CHECK(index.FindStand(Offset(apron, 140, 30)) == 1);
+    CHECK(index.FindStand(Offset(apron, 330, 30)) == GeofenceIndex::NONE);
+    CHECK(index.FindStand(Offset(apron, 20, -120)) == GeofenceIndex::NONE);
+    CHECK(index.FindRunway(Offset(apron, 20, 30)) == GeofenceIndex::NONE);
+
+    // Point stands across a grid cell boundary (0.01 degrees) are still found
+    const GeoPoint corner = { 57.66 - 0.00001, 12.27 - 0.00001 };
+    index.AddStand("ESGG", "edge", { corner });
+    CHECK(index.FindStand(Offset(corner, 50, 50)) == 3);
+}
+
+static void TestLoadStands()
+{
+    const char *path = "geofence_test_stands.txt";
+    {
+        std::ofstream file(path);
+        file << "// ESGG stands\n"
+             << "STAND:ESGG:10:WIDTH\n"
+             << "COORD:N057.39.54.000:E012.17.24.000\n"
+             << "COORD:N057.39.54.000:E012.17.26.000\n"
+             << "COORD:N057.39.56.000:E012.17.26.000\n"
+             << "COORD:N057.39.56.000:E012.17.24.000\n"
+             << "\n"
+             << "STAND:ESGG:11\n"
+             << "  COORD:N057.39.55.000:E012.17.30.500  \r\n"
+             << "STAND:ESGG:12\n" // no coordinates, skipped
+             << "STAND:ESSA:F64\n"
+             << "COORD:S033.56.46.000:W018.35.00.000\n"
+             << "COORD:bad\n";
+    }
+    GeofenceIndex index;
+    CHECK(index.LoadStands(path) == 3);
+    std::remove(path);
+    CHECK(index.LoadStands(path) == 0);
+    CHECK(index.StandCount() == 3);
+
+    const GeoPoint inside = { 57.0 + 39.0 / 60 + 55.0 / 3600, 12.0 + 17.0 / 60 + 25.0 / 3600 };
+    const int stand = index.FindStand(inside);
+    CHECK(stand != GeofenceIndex::NONE && index.Get(stand).name == "10");
+    CHECK(index.Get(stand).points.size() == 4);
+    const GeofenceIndex::Fence &south = index.Get(2);
+    CHECK(south.name == "F64" && south.points.size() == 1);
+    CHECK(Near(south.points[0].latitude, -(33 + 56.0 / 60 + 46.0 / 3600), 1e-9));
+    CHECK(Near(south.points[0].longitude, -(18 + 35.0 / 60), 1e-9));
+}
+
+static void TestGroundLevel()
+{
+    GeofenceIndex index;
+    index.AddRunway("ESGG", "03/21", RUNWAY_03, RUNWAY_21);
+    const GeoPoint onRunway = RUNWAY_03;
+    CHECK(index.GroundAltitude(onRunway) == INT_MIN);
+    CHECK(!index.IsOnSurface(onRunway, 0));
+
+    const int airport = index.Get(0).airport;
+    index.ObserveGround(airport, 500);
+    index.ObserveGround(airport, 480); // lower values are taken at once
+    CHECK(index.GroundAltitude(onRunway) == 480);
+    index.ObserveGround(airport, 640); // higher ones slowly
+    CHECK(index.GroundAltitude(onRunway) == 490);
+    CHECK(index.IsOnSurface(onRunway, 490 + GeofenceIndex::ALTITUDE_THRESHOLD_FT));
+    CHECK(!index.IsOnSurface(onRunway, 491 + GeofenceIndex::ALTITUDE_THRESHOLD_FT));
+    CHECK(index.GroundAltitude({ 59.65, 17.93 }) == INT_MIN);
+}
+
+// Many stands around an airport, for the agreement check and the timing
+static GeofenceIndex MakeAirport(GeoPoint center)
+{
+    GeofenceIndex index;
+    index.AddRunway("ESGG", "03/21", RUNWAY_03, RUNWAY_21);
+    index.AddRunway("ESGG", "12/30", Offset(center, -1500, 300), Offset(center, 1000, -300));
+    for (int row = 0; row < 20; row++) {
+        for (int column = 0; column < 20; column++) {
+            const GeoPoint stand = Offset(center, 100 + column * 60, 400 + row * 70);
+            if ((row + column) % 2 == 0)
+                index.AddStand("ESGG", "P", { stand });
+            else
+                index.AddStand("ESGG", "S", { stand, Offset(stand, 40, 0), Offset(stand, 40, 50),
+                                               Offset(stand, 0, 50) });
+        }
+    }
+    return index;
+}
+
+// Every fence, without the grid
+static int FindRunwayLinear(const GeofenceIndex &index, GeoPoint position)
+{
+    for (int i = 0; i < index.RunwayCount(); i++) {
+        if (PointInPolygon(position, index.Get(i).points)) return i;
+    }
+    return GeofenceIndex::NONE;
+}
+
+static bool HitsStandLinear(const GeofenceIndex &index, GeoPoint position)
+{
+    const int count = index.RunwayCount() + index.StandCount();
+    for (int i = index.RunwayCount(); i < count; i++) {
+        const GeofenceIndex::Fence &fence = index.Get(i);
+        if (fence.points.size() >= 3 ? PointInPolygon(position, fence.points)
+                                     : DistanceMeters(position, fence.points[0]) <
+                                           GeofenceIndex::POINT_STAND_RADIUS_M)
+            return true;
+    }
+    return false;
+}
+
+static void TestGridAgreesWithLinear()
+{
+    const GeoPoint center = { 57.66, 12.28 };
+    const GeofenceIndex index = MakeAirport(center);
+    std::vector<GeoPoint> positions;
+    for (double north = -2500; north < 2500; north += 23)
+        for (double east = -2500; east < 2500; east += 29)
+            positions.push_back(Offset(center, east, north));
+
+    int disagreements = 0, runway = 0, stand = 0;
+    for (const GeoPoint &position : positions) {
+        const int expected = FindRunwayLinear(index, position);
+        if (index.FindRunway(position) != expected) disagreements++;
+        const bool standExpected = HitsStandLinear(index, position);
+        if ((index.FindStand(position) != GeofenceIndex::NONE) != standExpected) disagreements++;
+        if (expected != GeofenceIndex::NONE) runway++;
+        if (standExpected) stand++;
+    }
+    CHECK(disagreements == 0);
+    CHECK(runway > 1000 && stand > 1000);
+
+    // Not a pass/fail check, the numbers depend on the machine - printed for comparison
+    constexpr int ROUNDS = 3;
+    using Clock = std::chrono::steady_clock;
+    int hits = 0;
+    const Clock::time_point linearStart = Clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (const GeoPoint &position : positions)
+            hits += (FindRunwayLinear(index, position) != GeofenceIndex::NONE) +
+                    HitsStandLinear(index, position);
+    }
+    const Clock::time_point gridStart = Clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (const GeoPoint &position : positions)
+            hits -= (index.FindRunway(position) != GeofenceIndex::NONE) +
+                    (index.FindStand(position) != GeofenceIndex::NONE);
+    }
+    const Clock::time_point end = Clock::now();
+    CHECK(hits == 0);
+    const auto ns = [&](Clock::duration duration) {
+        const double count = ROUNDS * double(positions.size());
+        return std::chrono::duration<double, std::nano>(duration).count() / count;
+    };
+    const int fences = index.RunwayCount() + index.StandCount();
+    std::printf("  %d fences, every fence: %.1f ns/position\n", fences, ns(gridStart - linearStart));
+    std::printf("  %d fences, grid index:  %.1f ns/position\n", fences, ns(end - gridStart));
+}
+
+int main()
+{
+    TestDistanceAndBearing();
+    TestRunway();
+    TestStands();
+    TestLoadStands();
+    TestGroundLevel();
+    TestGridAgreesWithLinear();
+    return CheckResult();
+}
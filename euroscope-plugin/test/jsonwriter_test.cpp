@@ -0,0 +1,199 @@
+#include "check.h"
+#include "json.hpp"
+#include "jsonwriter.h"
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// AppendJsonString has to produce exactly what nlohmann::json::dump() did for the same string, and
+// reject what dump() throws on. Checked around the 16-byte blocks of the SSE2 scan in particular.
+
+using namespace VatEFS;
+
+static int mismatches = 0;
+
+static void Printable(const std::string &value)
+{
+    for (unsigned char c : value) {
+        if (c >= 0x20 && c < 0x7F)
+            std::fputc(c, stderr);
+        else
+            std::fprintf(stderr, "\\x%02X", c);
+    }
+}
+
+// Compares with dump(), printing the first few differences
+static bool MatchesDump(const std::string &value)
+{
+    std::string expected;
+    bool valid = true;
+    try {
+        expected = nlohmann::json(value).dump();
+    } catch (const nlohmann::json::type_error &) {
+        valid = false; // 316: invalid UTF-8
+    }
+    std::string out = "prefix";
+    const bool written = AppendJsonString(out, value, false);
+    const bool matches = valid ? written && out == "prefix" + expected : !written && out == "prefix";
+    if (!matches && mismatches++ < 10) {
+        std::fprintf(stderr, "  mismatch for \"");
+        Printable(value);
+        std::fprintf(stderr, "\": %s\n", valid ? "valid" : "invalid");
+    }
+    return matches;
+}
+
+static void TestControlAndEscapes()
+{
+    for (int c = 0; c < 0x80; c++) {
+        CHECK(MatchesDump(std::string(1, static_cast<char>(c))));
+        CHECK(MatchesDump("a" + std::string(1, static_cast<char>(c)) + "b"));
+    }
+    CHECK(MatchesDump(""));
+    CHECK(MatchesDump("say \"hi\""));
+    CHECK(MatchesDump("C:\\path\\"));
+    CHECK(MatchesDump("\"\\\"\\"));
+    CHECK(MatchesDump("RMK/\tTCAS\r\n"));
+}
+
+// Each special byte or sequence at every offset across the first few blocks, with plain ASCII around
+static void TestBlockBoundaries()
+{
+    const std::vector<std::string> specials = {
+        "\"", "\\", "\n", "\x01", "\x1F", "\x7F", std::string(1, '\0'),
+        "\xC3\xA5",                 // å
+        "\xE2\x82\xAC",             // €
+        "\xF0\x9F\x98\x80",         // 4 bytes
+        "\xC3", "\xE2\x82", "\xF0\x9F\x98", "\x80", "\xFF", // invalid
+    };
+    for (const std::string &special : specials) {
+        for (std::size_t offset = 0; offset < 50; offset++) {
+            std::string value(offset, 'a');
+            value += special;
+            CHECK(MatchesDump(value));
+            value += std::string(40, 'b');
+            CHECK(MatchesDump(value));
+            value += special;
+            CHECK(MatchesDump(value));
+        }
+    }
+    // Exactly one and two blocks, nothing to escape
+    CHECK(MatchesDump(std::string(16, 'x')));
+    CHECK(MatchesDump(std::string(32, 'x')));
+}
+
+static void TestUtf8()
+{
+    const std::vector<std::string> values = {
+        "\xC2\x80", "\xDF\xBF", "\xE0\xA0\x80", "\xEF\xBF\xBF", "\xF0\x90\x80\x80", "\xF4\x8F\xBF\xBF",
+        "\xED\x9F\xBF", "\xEE\x80\x80", // both sides of the surrogates
+        "G\xC3\xB6teborg \xF0\x9F\x9B\xAB\xF0\x9F\x9B\xAC",
+        // Overlong
+        "\xC0\x80", "\xC1\xBF", "\xE0\x80\x80", "\xE0\x9F\xBF", "\xF0\x80\x80\x80", "\xF0\x8F\xBF\xBF",
+        // Surrogates
+        "\xED\xA0\x80", "\xED\xAF\xBF", "\xED\xB0\x80", "\xED\xBF\xBF", "\xED\xA0\xBD\xED\xB8\x80",
+        // Beyond U+10FFFF
+        "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xF8\x88\x80\x80\x80",
+        // Truncated, at the end and followed by ASCII
+        "\xC3", "\xE2\x82", "\xF0\x9F\x98", "\xC3z", "\xE2\x82z", "\xF0\x9F\x98z", "\xF0\x9F\x98\x80\x80",
+    };
+    for (const std::string &value : values)
+        CHECK(MatchesDump(value));
+
+    // Every lead byte with every second byte, and with every third byte of a 3 and 4 byte sequence
+    int failed = 0;
+    for (int lead = 0x80; lead <= 0xFF; lead++) {
+        for (int next = 0; next <= 0xFF; next++) {
+            const char l = static_cast<char>(lead), n = static_cast<char>(next);
+            if (!MatchesDump({ l, n })) failed++;
+            if (!MatchesDump({ l, '\x80', n })) failed++;
+            if (!MatchesDump({ l, '\x90', '\x80', n })) failed++;
+            if (!MatchesDump({ l, n, '\x80', '\x80' })) failed++;
+        }
+    }
+    CHECK(failed == 0);
+}
+
+static void TestReplaceInvalid()
+{
+    const auto replaced = [](std::string_view value) {
+        std::string out;
+        CHECK(AppendJsonString(out, value, true));
+        return out;
+    };
+    // Each offending byte becomes a '?', valid sequences around them are kept
+    CHECK(replaced("G\xF6teborg") == "\"G?teborg\"");
+    CHECK(replaced("\xC3z\xFF") == "\"?z?\"");
+    CHECK(replaced("\xE2\x82") == "\"??\"");
+    CHECK(replaced("\xED\xA0\x80") == "\"???\"");
+    CHECK(replaced("\xC0\xAF\xC3\xA5\"") == "\"??\xC3\xA5\\\"\"");
+    CHECK(replaced(std::string(15, 'a') + "\xE5\n") == "\"" + std::string(15, 'a') + "?\\n\"");
+
+    // Whatever is replaced, the result is valid JSON
+    std::string value;
+    for (int c = 1; c <= 0xFF; c++)
+        value.push_back(static_cast<char>(c));
+    const std::string out = replaced(value);
+    CHECK(nlohmann::json::accept(out));
+}
+
+static void TestWriter()
+{
+    std::string buffer = "line:";
+    const std::vector<std::string> excluded = { "heading" };
+    JsonWriter writer(buffer);
+    writer.Exclude(excluded);
+    writer.BeginObject();
+    CHECK(!writer.String("first", "\xC3")); // dropped, and no comma left behind
+    CHECK(writer.InvalidKey() != nullptr && std::string(writer.InvalidKey()) == "first");
+    writer.String("callsign", "SAS123");
+    writer.String("remarks", "\"quoted\"\t\\ \xC3\xA5");
+    writer.String("empty", BoundedString<4>(""));
+    CHECK(!writer.String("tooLong", BoundedString<4>("12345")));
+    CHECK(!writer.String("null", BoundedString<4>()));
+    writer.StringWithUtf8Replace("name", "G\xF6teborg");
+    writer.Int("altitude", -1200);
+    writer.Int("heading", 270);
+    writer.Double("latitude", 57.6628);
+    writer.Double("nan", std::nan(""));
+    writer.Bool("onStand", true);
+    writer.EndObject();
+
+    CHECK(buffer.compare(0, 5, "line:") == 0);
+    const nlohmann::json expected = {
+        { "callsign", "SAS123" }, { "remarks", "\"quoted\"\t\\ \xC3\xA5" }, { "empty", "" },
+        { "name", "G?teborg" },   { "altitude", -1200 },                    { "latitude", 57.6628 },
+        { "nan", nullptr },       { "onStand", true },
+    };
+    const nlohmann::json parsed = nlohmann::json::parse(buffer.substr(5), nullptr, false);
+    CHECK(!parsed.is_discarded());
+    CHECK(parsed == expected);
+
+    // Same fields in the same order as dump() of an ordered object
+    std::string strings;
+    JsonWriter ordered(strings);
+    ordered.BeginObject();
+    ordered.String("callsign", "SAS123");
+    ordered.String("remarks", "\x01\x1F\"\\/");
+    ordered.Int("altitude", 3500);
+    ordered.Bool("onStand", false);
+    ordered.EndObject();
+    nlohmann::ordered_json reference;
+    reference["callsign"] = "SAS123";
+    reference["remarks"] = "\x01\x1F\"\\/";
+    reference["altitude"] = 3500;
+    reference["onStand"] = false;
+    CHECK(strings == reference.dump());
+}
+
+int main()
+{
+    TestControlAndEscapes();
+    TestBlockBoundaries();
+    TestUtf8();
+    TestReplaceInvalid();
+    TestWriter();
+    return CheckResult();
+}
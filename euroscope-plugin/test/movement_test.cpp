@@ -0,0 +1,148 @@
+#include "check.h"
+#include "movement.h"
+
+#include <cstdio>
+#include <vector>
+
+using namespace VatEFS;
+
+struct Target {
+    MovementState state = MOVEMENT_UNKNOWN;
+    MovementState candidate = MOVEMENT_UNKNOWN;
+    std::uint8_t confirmations = 0;
+    std::vector<MovementState> changes;
+
+    // One radar report, as UpdateMovementState handles it
+    void Report(const MovementInput &input)
+    {
+        if (ConfirmMovementState(InferMovementState(state, input), state, candidate, confirmations))
+            changes.push_back(state);
+    }
+    void Report(const MovementInput &input, int times)
+    {
+        for (int i = 0; i < times; i++)
+            Report(input);
+    }
+};
+
+static MovementInput Ground(int groundSpeed, bool onRunway = false, bool onStand = false)
+{
+    return { groundSpeed, 0, false, SURFACE_GROUND, onRunway, onStand };
+}
+
+static bool Changes(const Target &target, const std::vector<MovementState> &expected)
+{
+    if (target.changes == expected) return true;
+    std::fprintf(stderr, "  changes:");
+    for (MovementState state : target.changes)
+        std::fprintf(stderr, " %s", MovementStateName(state));
+    std::fprintf(stderr, "\n");
+    return false;
+}
+
+static void TestDeparture()
+{
+    Target target;
+    target.Report(Ground(0, false, true), 3);
+    MovementInput push = Ground(4, false, true);
+    push.reversing = true;
+    target.Report(push, 3);
+    push.onStand = false;
+    target.Report(push, 2); // still pushing back once off the stand
+    target.Report(Ground(0), 3);
+    target.Report(Ground(15), 10);
+    target.Report(Ground(0), 3);      // at the holding point
+    target.Report(Ground(8, true), 3); // entering the runway
+    target.Report(Ground(0, true), 3);
+    target.Report(Ground(20, true), 2);
+    target.Report(Ground(90, true), 3);
+    MovementInput climb = { 160, 1500, false, SURFACE_AIRBORNE, true, false };
+    target.Report(climb, 3);
+
+    CHECK(Changes(target, { MOVEMENT_PARKED, MOVEMENT_PUSHBACK, MOVEMENT_HOLDING, MOVEMENT_TAXI,
+                            MOVEMENT_HOLDING, MOVEMENT_LINEUP, MOVEMENT_TAKEOFF_ROLL, MOVEMENT_AIRBORNE }));
+}
+
+static void TestArrival()
+{
+    Target target;
+    target.Report({ 140, -700, false, SURFACE_AIRBORNE, false, false }, 3);
+    target.Report(Ground(130, true), 3);
+    target.Report(Ground(35, true), 3);  // below the rolling start, but still rolling
+    target.Report(Ground(20, true), 3);  // slowing down, vacating
+    target.Report(Ground(15), 5);
+    target.Report(Ground(0, false, true), 3);
+
+    CHECK(Changes(target, { MOVEMENT_AIRBORNE, MOVEMENT_LANDING_ROLL, MOVEMENT_TAXI, MOVEMENT_PARKED }));
+}
+
+static void TestConfirmations()
+{
+    // The first state is taken right away
+    Target target;
+    target.Report(Ground(15));
+    CHECK(Changes(target, { MOVEMENT_TAXI }));
+
+    // A single report pointing elsewhere doesn't change it
+    target.Report(Ground(0));
+    target.Report(Ground(15));
+    CHECK(target.state == MOVEMENT_TAXI);
+    for (int i = 1; i < MOVEMENT_CONFIRMATIONS; i++)
+        target.Report(Ground(0));
+    CHECK(target.state == MOVEMENT_TAXI);
+    target.Report(Ground(0));
+    CHECK(Changes(target, { MOVEMENT_TAXI, MOVEMENT_HOLDING }));
+
+    // The count restarts when the candidate changes
+    target.Report(Ground(0, true));
+    target.Report(Ground(15));
+    CHECK(target.state == MOVEMENT_HOLDING);
+    target.Report(Ground(15));
+    CHECK(target.state == MOVEMENT_TAXI);
+}
+
+static void TestHysteresis()
+{
+    // Between the stop and start speeds, the state stays what it was
+    Target moving;
+    moving.Report(Ground(10), 3);
+    moving.Report(Ground(2), 5);
+    CHECK(moving.state == MOVEMENT_TAXI);
+    Target parked;
+    parked.Report(Ground(0, false, true), 3);
+    parked.Report(Ground(2, false, true), 5);
+    CHECK(parked.state == MOVEMENT_PARKED);
+
+    Target rolling;
+    rolling.Report(Ground(60, true), 3);
+    rolling.Report(Ground(35, true), 5);
+    CHECK(rolling.state == MOVEMENT_TAKEOFF_ROLL);
+    Target lineup;
+    lineup.Report(Ground(20, true), 3);
+    lineup.Report(Ground(35, true), 5);
+    CHECK(lineup.state == MOVEMENT_LINEUP);
+}
+
+static void TestUnknownSurface()
+{
+    // Without a known ground level: slow is on the ground, and climbing fast is airborne
+    Target target;
+    target.Report({ 10, 0, false, SURFACE_UNKNOWN, false, false }, 3);
+    CHECK(target.state == MOVEMENT_TAXI);
+    target.Report({ 150, 0, false, SURFACE_UNKNOWN, false, false }, 3);
+    CHECK(target.state == MOVEMENT_TAXI); // fast off the runway, can't tell
+    target.Report({ 150, 0, false, SURFACE_UNKNOWN, true, false }, 3);
+    CHECK(target.state == MOVEMENT_TAKEOFF_ROLL);
+    target.Report({ 160, 1200, false, SURFACE_UNKNOWN, false, false }, 3);
+    CHECK(target.state == MOVEMENT_AIRBORNE);
+}
+
+int main()
+{
+    TestDeparture();
+    TestArrival();
+    TestConfirmations();
+    TestHysteresis();
+    TestUnknownSurface();
+    return CheckResult();
+}
@@ -0,0 +1,162 @@
+#include "check.h"
+#include "scratchpad.h"
+
+using namespace VatEFS;
+
+// Scratch pad strings seen in the wild
+
+static void TestEfsStrings()
+{
+    ScratchPadEvent event = DecodeScratchPad("/EFS/CTL");
+    CHECK(event.kind == ScratchPadEvent::CLEARED_TO_LAND);
+    CHECK(event.value == 1);
+    CHECK(event.argument.empty());
+
+    // The longer encoding wins, and isn't taken for /EFS/CTL with an argument
+    event = DecodeScratchPad("/EFS/CTL-");
+    CHECK(event.kind == ScratchPadEvent::CLEARED_TO_LAND);
+    CHECK(event.value == 0);
+
+    // Exact encodings don't match with anything after them
+    CHECK(DecodeScratchPad("/EFS/CTLX").kind == ScratchPadEvent::RAW);
+    CHECK(DecodeScratchPad("/EFS/CT").kind == ScratchPadEvent::RAW);
+
+    CHECK(DecodeScratchPad("LINEUP").kind == ScratchPadEvent::GROUND_STATE);
+    CHECK(DecodeScratchPad("ONFREQ").kind == ScratchPadEvent::GROUND_STATE);
+    CHECK(DecodeScratchPad("DE-ICE").kind == ScratchPadEvent::GROUND_STATE);
+}
+
+static void TestStand()
+{
+    ScratchPadEvent event = DecodeScratchPad("GRP/S/21A");
+    CHECK(event.kind == ScratchPadEvent::STAND);
+    CHECK(event.argument == "21A");
+    CHECK(event.code == "GRP/S");
+
+    // Without a stand the argument is empty, the plugin then sends it as scratch
+    event = DecodeScratchPad("GRP/S/");
+    CHECK(event.kind == ScratchPadEvent::STAND);
+    CHECK(event.argument.empty());
+
+    CHECK(DecodeScratchPad("GRP/S").kind == ScratchPadEvent::RAW);
+}
+
+static void TestHold()
+{
+    ScratchPadEvent event = DecodeScratchPad("/HOLD/ERNOV/");
+    CHECK(event.kind == ScratchPadEvent::HOLD);
+    CHECK(event.value == 1);
+    auto fields = SplitScratchPadFields(event.argument);
+    CHECK(fields.size() == 1 && fields[0] == "ERNOV");
+
+    // Hold cancelled: an empty fix
+    event = DecodeScratchPad("/HOLD//0");
+    CHECK(event.kind == ScratchPadEvent::HOLD);
+    CHECK(event.value == 1);
+    CHECK(event.argument == "/0");
+    fields = SplitScratchPadFields(event.argument);
+    CHECK(fields.size() == 2 && fields[0].empty() && fields[1] == "0");
+
+    event = DecodeScratchPad("/XHOLD/ERNOV/");
+    CHECK(event.kind == ScratchPadEvent::HOLD);
+    CHECK(event.value == 0);
+    CHECK(event.code == "XHOLD");
+}
+
+static void TestCoordination()
+{
+    ScratchPadEvent event = DecodeScratchPad("/SBY/RTI/ESMM_2_CTR/S074-");
+    CHECK(event.kind == ScratchPadEvent::COORDINATION);
+    CHECK(event.code == "SBY/RTI");
+    auto fields = SplitScratchPadFields(event.argument);
+    CHECK(fields.size() == 2 && fields[0] == "ESMM_2_CTR" && fields[1] == "S074-");
+
+    event = DecodeScratchPad("/RTI/DLH6RA/ESMM_2_CTR/S074-");
+    CHECK(event.kind == ScratchPadEvent::COORDINATION);
+    CHECK(event.code == "RTI");
+    CHECK(SplitScratchPadFields(event.argument).size() == 3);
+
+    event = DecodeScratchPad("/ACP/RTI/EDDB_S_APP");
+    CHECK(event.kind == ScratchPadEvent::COORDINATION);
+    CHECK(event.code == "ACP/RTI");
+    CHECK(event.argument == "EDDB_S_APP");
+
+    event = DecodeScratchPad("/LAM/ROF/ESMM_5_CTR");
+    CHECK(event.kind == ScratchPadEvent::COORDINATION);
+    CHECK(event.code == "LAM/ROF");
+
+    event = DecodeScratchPad("/ROF/RYR6Q/EKCH_F_APP");
+    CHECK(event.kind == ScratchPadEvent::COORDINATION);
+    CHECK(event.code == "ROF");
+}
+
+static void TestOperatorText()
+{
+    ScratchPadEvent event = DecodeScratchPad("/OPTEXT2_REQ/ESMM_7_CTR/LHA3218/NC M7");
+    CHECK(event.kind == ScratchPadEvent::OPERATOR_TEXT_REQUEST);
+    auto fields = SplitScratchPadFields(event.argument, 3);
+    CHECK(fields.size() == 3 && fields[0] == "ESMM_7_CTR" && fields[1] == "LHA3218" &&
+          fields[2] == "NC M7");
+
+    // The text may contain slashes, which the last field takes
+    event = DecodeScratchPad("/OPTEXT2_REQ/ESSA_M_APP/NRD1121/\"NORTH/RIDER\"");
+    fields = SplitScratchPadFields(event.argument, 3);
+    CHECK(fields.size() == 3 && fields[2] == "\"NORTH/RIDER\"");
+
+    event = DecodeScratchPad("/OPTEXT/TEST");
+    CHECK(event.kind == ScratchPadEvent::OPERATOR_TEXT);
+    CHECK(event.argument == "TEST");
+    event = DecodeScratchPad("/OPTEXT/");
+    CHECK(event.kind == ScratchPadEvent::OPERATOR_TEXT);
+    CHECK(event.argument.empty());
+}
+
+static void TestOtherTopSky()
+{
+    ScratchPadEvent event = DecodeScratchPad("/CAT3/");
+    CHECK(event.kind == ScratchPadEvent::APPROACH_CATEGORY);
+    CHECK(event.value == 3);
+    CHECK(DecodeScratchPad("/CAT2/").value == 2);
+
+    CHECK(DecodeScratchPad("ON_CONTACT+").kind == ScratchPadEvent::ON_CONTACT);
+    CHECK(DecodeScratchPad("ON_CONTACT+").value == 1);
+    CHECK(DecodeScratchPad("ON_CONTACT-").value == 0);
+
+    event = DecodeScratchPad("/ACK_STAR/RISMA3S");
+    CHECK(event.kind == ScratchPadEvent::STAR_ACKNOWLEDGED);
+    CHECK(event.argument == "RISMA3S");
+}
+
+static void TestNoise()
+{
+    const char *noise[] = { "/PRESHDG/", "/ASP=/", "/ASP+/", "/ASP-/", "/ARC+/",  "/ARC-/", "/ES",
+                            "/C_FLAG_ACK/", "/C_FLAG_RESET/", "/COB", "/PLU", "/TIT", "/FTEXT/L0" };
+    for (const char *scratch : noise) {
+        const bool isNoise = DecodeScratchPad(scratch).kind == ScratchPadEvent::NOISE;
+        CHECK(isNoise);
+        if (!isNoise) std::fprintf(stderr, "  not noise: %s\n", scratch);
+    }
+}
+
+static void TestRaw()
+{
+    // Passed on as scratch
+    CHECK(DecodeScratchPad("").kind == ScratchPadEvent::RAW);
+    CHECK(DecodeScratchPad("MISAP_").kind == ScratchPadEvent::RAW);
+    CHECK(DecodeScratchPad(".remarks").kind == ScratchPadEvent::RAW);
+    CHECK(DecodeScratchPad("/ESX").kind == ScratchPadEvent::RAW);
+    CHECK(DecodeScratchPad("HELLO").kind == ScratchPadEvent::RAW);
+}
+
+int main()
+{
+    TestEfsStrings();
+    TestStand();
+    TestHold();
+    TestCoordination();
+    TestOperatorText();
+    TestOtherTopSky();
+    TestNoise();
+    TestRaw();
+    return CheckResult();
+}
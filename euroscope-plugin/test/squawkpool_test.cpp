@@ -0,0 +1,113 @@
+#include "check.h"
+#include "squawkpool.h"
+
+using namespace VatEFS;
+
+static int Code(const char *squawk)
+{
+    return SquawkPool::Parse(squawk);
+}
+
+static void TestParseAndFormat()
+{
+    CHECK(Code("0000") == 0);
+    CHECK(Code("7777") == 4095);
+    CHECK(Code("1234") == 01234);
+    CHECK(Code("1238") == SquawkPool::NO_CODE);
+    CHECK(Code("123") == SquawkPool::NO_CODE);
+    CHECK(SquawkPool::Format(01234) == "1234");
+    CHECK(SquawkPool::Format(0) == "0000");
+
+    CHECK(!SquawkPool::IsDiscrete(Code("1200")));
+    CHECK(!SquawkPool::IsDiscrete(Code("7700")));
+    CHECK(SquawkPool::IsDiscrete(Code("1201")));
+}
+
+static void TestSkipsCodesEndingIn00()
+{
+    SquawkPool pool;
+    CHECK(pool.AddRange("*", SquawkPool::ANY_RULES, Code("4077"), Code("4102")));
+    // 4100 lies in the range but is not discrete
+    CHECK(pool.Allocate("ESGG", 'I') == Code("4077"));
+    CHECK(pool.Allocate("ESGG", 'I') == Code("4101"));
+    CHECK(pool.Allocate("ESGG", 'I') == Code("4102"));
+    CHECK(pool.InUseCount() == 0); // allocating doesn't mark the code used, assigning it does
+}
+
+static void TestWrapAround()
+{
+    SquawkPool pool;
+    const int first = Code("2301"), last = Code("2304");
+    CHECK(pool.AddRange("ESGG", 'I', first, last));
+    for (int code = first; code <= last; code++) {
+        CHECK(pool.Allocate("ESGG", 'I') == code);
+        pool.AddAssigned(code);
+    }
+    CHECK(pool.Allocate("ESGG", 'I') == SquawkPool::NO_CODE);
+    CHECK(pool.InUseCount() == 4);
+
+    // A code freed before where the search continues is found by wrapping around
+    pool.RemoveAssigned(Code("2302"));
+    CHECK(pool.Allocate("ESGG", 'I') == Code("2302"));
+    pool.AddAssigned(Code("2302"));
+
+    // Released codes aren't handed out again right away: the search continues after the last
+    pool.RemoveAssigned(Code("2301"));
+    pool.RemoveAssigned(Code("2304"));
+    CHECK(pool.Allocate("ESGG", 'I') == Code("2304"));
+    CHECK(pool.Allocate("ESGG", 'I') == Code("2301"));
+}
+
+static void TestInUse()
+{
+    SquawkPool pool;
+    CHECK(pool.AddRange("*", SquawkPool::ANY_RULES, Code("3001"), Code("3003")));
+    CHECK(pool.AddSquawking(Code("3001")) == 1);
+    CHECK(pool.AddSquawking(Code("3001")) == 2); // a duplicate
+    pool.AddAssigned(Code("3002"));
+    CHECK(pool.InUse(Code("3001")) && pool.InUse(Code("3002")) && !pool.InUse(Code("3003")));
+    CHECK(pool.InUse(Code("3000"))); // never free
+    CHECK(pool.Allocate("ESSA", 'V') == Code("3003"));
+
+    pool.RemoveSquawking(Code("3001"));
+    CHECK(pool.InUse(Code("3001")));
+    pool.RemoveSquawking(Code("3001"));
+    CHECK(!pool.InUse(Code("3001")));
+
+    pool.Clear();
+    CHECK(pool.InUseCount() == 0);
+    CHECK(pool.RangeCount() == 1);
+}
+
+static void TestRangeMatching()
+{
+    SquawkPool pool;
+    CHECK(!pool.AddRange("ES", SquawkPool::ANY_RULES, Code("1001"), Code("1077")));
+    CHECK(!pool.AddRange("ESGG", 'I', Code("1077"), Code("1001")));
+    CHECK(pool.AddRange("ESGG", 'V', Code("7001"), Code("7002")));
+    CHECK(pool.AddRange("ESGG", SquawkPool::ANY_RULES, Code("2001"), Code("2077")));
+    CHECK(pool.AddRange("*", SquawkPool::ANY_RULES, Code("5001"), Code("5077")));
+
+    CHECK(pool.HasRange("ESGG", 'V'));
+    CHECK(pool.HasRange("ESKN", 'I')); // the "*" range
+
+    // In the order added
+    CHECK(pool.Allocate("ESGG", 'V') == Code("7001"));
+    CHECK(pool.Allocate("ESGG", 'I') == Code("2001"));
+    CHECK(pool.Allocate("ESSA", 'I') == Code("5001"));
+
+    // A full range falls through to the next matching one
+    pool.AddAssigned(Code("7001"));
+    pool.AddAssigned(Code("7002"));
+    CHECK(pool.Allocate("ESGG", 'V') == Code("2002"));
+}
+
+int main()
+{
+    TestParseAndFormat();
+    TestSkipsCodesEndingIn00();
+    TestWrapAround();
+    TestInUse();
+    TestRangeMatching();
+    return CheckResult();
+}
@@ -0,0 +1,106 @@
+#include "check.h"
+#include "subscription.h"
+
+#include <algorithm>
+
+using namespace VatEFS;
+
+static bool Excludes(const Subscription &subscription, const char *field)
+{
+    const auto &fields = subscription.ExcludedFields();
+    return std::find(fields.begin(), fields.end(), field) != fields.end();
+}
+
+static void TestDefaultWantsEverything()
+{
+    Subscription subscription;
+    CHECK(subscription.Wants(Subscription::RADAR_POSITION));
+    CHECK(subscription.Wants(Subscription::METAR));
+    CHECK(!subscription.HasFlightFilter());
+    CHECK(subscription.WantsFlight("SAS123", "ESSA", "EKCH"));
+    CHECK(subscription.WantsStation("ESGG"));
+}
+
+static void TestFilters()
+{
+    Subscription subscription;
+    const auto unknown = subscription.SetTypes({ "radarTargetPositionUpdate", "metar", "bogus" });
+    CHECK(unknown.size() == 1 && unknown[0] == "bogus");
+    CHECK(subscription.Wants(Subscription::RADAR_POSITION));
+    CHECK(subscription.Wants(Subscription::METAR));
+    CHECK(!subscription.Wants(Subscription::FLIGHT_PLAN_DATA));
+
+    subscription.SetAirports({ "ESGG", "bad" });
+    subscription.SetCallsigns({ "NAX1" });
+    CHECK(subscription.HasFlightFilter());
+    CHECK(subscription.WantsFlight("SAS1", "ESGG", "EKCH"));
+    CHECK(subscription.WantsFlight("SAS1", "EKCH", "ESGG"));
+    CHECK(subscription.WantsFlight("NAX1", "ENGM", "EKCH"));
+    CHECK(!subscription.WantsFlight("SAS1", "ENGM", "EKCH"));
+
+    subscription.SetStations({ "ESSA" });
+    CHECK(subscription.WantsStation("ESSA"));
+    CHECK(!subscription.WantsStation("ESGG"));
+
+    // type and callsign can't be left out
+    subscription.SetExcludedFields({ "heading", "type", "callsign" });
+    CHECK(subscription.ExcludedFields().size() == 1 && Excludes(subscription, "heading"));
+}
+
+static void TestMerge()
+{
+    Subscription tower;
+    tower.SetTypes({ "radarTargetPositionUpdate" });
+    tower.SetAirports({ "ESGG" });
+    tower.SetStations({ "ESGG" });
+    tower.SetExcludedFields({ "heading", "verticalSpeed" });
+
+    Subscription ground;
+    ground.SetTypes({ "metar" });
+    ground.SetAirports({ "ESSA" });
+    ground.SetCallsigns({ "NAX1" });
+    ground.SetStations({ "ESSA" });
+    ground.SetExcludedFields({ "heading", "ete" });
+
+    Subscription merged = tower;
+    merged.Merge(ground);
+    // Types and flights are united
+    CHECK(merged.Wants(Subscription::RADAR_POSITION));
+    CHECK(merged.Wants(Subscription::METAR));
+    CHECK(!merged.Wants(Subscription::FLIGHT_PLAN_DATA));
+    CHECK(merged.WantsFlight("SAS1", "ESGG", "EKCH"));
+    CHECK(merged.WantsFlight("SAS1", "EKCH", "ESSA"));
+    CHECK(merged.WantsFlight("NAX1", "ENGM", "EKCH"));
+    CHECK(!merged.WantsFlight("SAS1", "ENGM", "EKCH"));
+    CHECK(merged.WantsStation("ESGG") && merged.WantsStation("ESSA"));
+    CHECK(!merged.WantsStation("EKCH"));
+    // Only the fields both leave out
+    CHECK(merged.ExcludedFields().size() == 1 && Excludes(merged, "heading"));
+
+    // No flight or station filter on either side means none at all
+    Subscription everything;
+    merged = tower;
+    merged.Merge(everything);
+    CHECK(!merged.HasFlightFilter());
+    CHECK(merged.WantsFlight("SAS1", "ENGM", "EKCH"));
+    CHECK(merged.WantsStation("EKCH"));
+    CHECK(merged.Wants(Subscription::FLIGHT_PLAN_DATA));
+    CHECK(merged.ExcludedFields().empty());
+}
+
+static void TestTypeOf()
+{
+    Subscription::MessageType type;
+    CHECK(Subscription::TypeOf("flightPlanSummary", type) && type == Subscription::FLIGHT_PLAN_DATA);
+    CHECK(Subscription::TypeOf("onStand", type) && type == Subscription::GEOFENCE);
+    CHECK(!Subscription::TypeOf("myselfUpdate", type)); // always sent
+}
+
+int main()
+{
+    TestDefaultWantsEverything();
+    TestFilters();
+    TestMerge();
+    TestTypeOf();
+    return CheckResult();
+}
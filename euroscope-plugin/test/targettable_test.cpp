@@ -0,0 +1,203 @@
+#include "check.h"
+#include "targettable.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace VatEFS;
+
+static constexpr int TARGETS = 5000;
+
+static std::vector<BoundedString<20>> MakeCallsigns(int count)
+{
+    std::vector<BoundedString<20>> callsigns;
+    for (int i = 0; i < count; i++) {
+        char callsign[16];
+        std::snprintf(callsign, sizeof(callsign), "%s%d", i % 3 == 0 ? "SAS" : i % 3 == 1 ? "NAX" : "DLH",
+                      100 + i);
+        callsigns.emplace_back(callsign);
+    }
+    return callsigns;
+}
+
+// Every callsign in the reference maps to its ID, and the IDs are dense
+static bool Consistent(const TargetTable &targets, const std::unordered_map<std::string, int> &reference)
+{
+    if (targets.Size() != static_cast<int>(reference.size())) return false;
+    for (const auto &[callsign, altitude] : reference) {
+        const int id = targets.Find(callsign);
+        if (id == TargetTable::NONE || targets.callsign[id] != callsign || targets.altitude[id] != altitude)
+            return false;
+    }
+    return true;
+}
+
+static void TestInsertFindRemove()
+{
+    TargetTable targets;
+    const std::vector<BoundedString<20>> callsigns = MakeCallsigns(TARGETS);
+    std::unordered_map<std::string, int> reference; // callsign to altitude, to tell the rows apart
+    for (int i = 0; i < TARGETS; i++) {
+        const int id = targets.Insert(callsigns[i]);
+        CHECK(id == i);
+        targets.altitude[id] = i;
+        reference[callsigns[i].Str()] = i;
+    }
+    CHECK(targets.HashCapacity() >= 2 * TARGETS); // rehashed while growing
+    CHECK(targets.Insert(callsigns[42]) == 42);   // already there
+    CHECK(targets.Find("SAS99999") == TargetTable::NONE);
+    CHECK(Consistent(targets, reference));
+
+    // Defaults of a new target
+    CHECK(targets.movementState[7] == MOVEMENT_UNKNOWN && targets.track[7] == -1);
+    CHECK(targets.runwayFence[7] == -1 && targets.airspace[7] == -1 && targets.squawkCode[7] == -1);
+
+    // Removing moves the last target into the hole and shifts probe sequences back
+    for (int i = 0; i < TARGETS; i += 3) {
+        targets.Remove(callsigns[i].View());
+        reference.erase(callsigns[i].Str());
+    }
+    CHECK(Consistent(targets, reference));
+    targets.Remove("SAS99999");
+    targets.Remove(targets.Size());
+    CHECK(Consistent(targets, reference));
+
+    // Removed callsigns come back with fresh IDs
+    for (int i = 0; i < TARGETS; i += 6) {
+        const int id = targets.Insert(callsigns[i]);
+        targets.altitude[id] = -i;
+        reference[callsigns[i].Str()] = -i;
+    }
+    CHECK(Consistent(targets, reference));
+
+    targets.Clear();
+    CHECK(targets.Size() == 0 && targets.Find(callsigns[1].View()) == TargetTable::NONE);
+}
+
+// The per-callsign state as it was before the target table: one struct per target in a map
+struct BaselineTarget {
+    std::time_t lastSeen = 0;
+    double latitude = 0, longitude = 0;
+    int altitude = 0, groundSpeed = 0, heading = 0, verticalSpeed = 0;
+    std::uint32_t positionVersion = 0;
+};
+
+// Not a pass/fail check, the numbers depend on the machine - printed for comparison. Each round is a
+// position update for every target looked up by callsign, then a sweep over one column, as the
+// stale target sweep and arrival metrics do
+static void TimeAgainstBaseline()
+{
+    constexpr int ROUNDS = 200;
+    using Clock = std::chrono::steady_clock;
+    const std::vector<BoundedString<20>> callsigns = MakeCallsigns(TARGETS);
+    long long checksum = 0;
+
+    std::unordered_map<std::string, BaselineTarget> baseline;
+    const Clock::time_point baselineStart = Clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < TARGETS; i++) {
+            BaselineTarget &target = baseline[callsigns[i].CStr()];
+            target.lastSeen = round;
+            target.latitude = 57.0 + i * 0.001;
+            target.longitude = 12.0 + round * 0.001;
+            target.altitude = 3000 + i;
+            target.groundSpeed = 180 + round % 20;
+            target.positionVersion++;
+        }
+        for (const auto &[callsign, target] : baseline)
+            checksum += target.groundSpeed;
+    }
+
+    TargetTable targets;
+    const Clock::time_point tableStart = Clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < TARGETS; i++) {
+            const int id = targets.Insert(callsigns[i]);
+            targets.lastSeen[id] = round;
+            targets.latitude[id] = 57.0 + i * 0.001;
+            targets.longitude[id] = 12.0 + round * 0.001;
+            targets.altitude[id] = 3000 + i;
+            targets.groundSpeed[id] = 180 + round % 20;
+            targets.positionVersion[id]++;
+        }
+        for (int id = 0; id < targets.Size(); id++)
+            checksum -= targets.groundSpeed[id];
+    }
+    const Clock::time_point end = Clock::now();
+
+    CHECK(checksum == 0);
+    const auto ns = [](Clock::duration duration) {
+        return std::chrono::duration<double, std::nano>(duration).count() / (ROUNDS * double(TARGETS));
+    };
+    std::printf("  %d targets, unordered_map of structs: %.1f ns/target update\n", TARGETS,
+                ns(tableStart - baselineStart));
+    std::printf("  %d targets, TargetTable:              %.1f ns/target update\n", TARGETS,
+                ns(end - tableStart));
+}
+
+// The core of OnGetTagItem, which EuroScope calls for every visible tag item on each refresh:
+// find the target by callsign and copy its EFS stand into the 16 character item buffer.
+// Compared with a map of strings keyed by callsign, looked up with a std::string per call.
+static void TimeTagItems()
+{
+    constexpr int ROUNDS = 200;
+    using Clock = std::chrono::steady_clock;
+    const std::vector<BoundedString<20>> callsigns = MakeCallsigns(TARGETS);
+
+    TargetTable targets;
+    std::unordered_map<std::string, std::string> stands;
+    for (int i = 0; i < TARGETS; i++) {
+        char stand[16];
+        std::snprintf(stand, sizeof(stand), "%d", i % 97);
+        const int id = targets.Insert(callsigns[i]);
+        if (i % 4 == 0) continue; // no stand
+        targets.efsStand[id].Assign(stand);
+        stands[callsigns[i].Str()] = stand;
+    }
+
+    char item[16];
+    std::size_t length = 0; // so that the copies aren't optimized away
+    const Clock::time_point baselineStart = Clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (const BoundedString<20> &callsign : callsigns) {
+            item[0] = '\0';
+            auto it = stands.find(std::string(callsign.CStr()));
+            if (it != stands.end()) std::strncpy(item, it->second.c_str(), sizeof(item) - 1);
+            length += std::strlen(item);
+        }
+    }
+    const Clock::time_point tableStart = Clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        for (const BoundedString<20> &callsign : callsigns) {
+            item[0] = '\0';
+            const int id = targets.Find(callsign.CStr());
+            if (id == TargetTable::NONE) continue;
+            const BoundedString<15> &value = targets.efsStand[id];
+            std::memcpy(item, value.CStr(), value.Length() + 1);
+            length -= value.Length();
+        }
+    }
+    const Clock::time_point end = Clock::now();
+
+    CHECK(length == 0);
+    const int id = targets.Find("NAX101");
+    CHECK(id != TargetTable::NONE && targets.efsStand[id] == "1");
+    const auto ns = [](Clock::duration duration) {
+        return std::chrono::duration<double, std::nano>(duration).count() / (ROUNDS * double(TARGETS));
+    };
+    std::printf("  tag item, map of strings: %.1f ns/item\n", ns(tableStart - baselineStart));
+    std::printf("  tag item, TargetTable:    %.1f ns/item\n", ns(end - tableStart));
+}
+
+int main()
+{
+    TestInsertFindRemove();
+    TimeAgainstBaseline();
+    TimeTagItems();
+    return CheckResult();
+}
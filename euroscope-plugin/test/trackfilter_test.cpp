@@ -0,0 +1,251 @@
+#include "check.h"
+#include "geofence.h"
+#include "movement.h"
+#include "trackfilter.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+using namespace VatEFS;
+
+static constexpr double PI = 3.14159265358979323846;
+static constexpr double METERS_PER_SECOND_PER_KT = 1852.0 / 3600;
+static constexpr int REPORT_SECONDS = 5;
+
+// Deterministic noise, so that the replays are the same on every run
+struct Noise {
+    std::uint32_t state = 12345;
+
+    double Uniform() // [-1, 1)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) / double(1 << 23) - 1;
+    }
+    double Normal(double deviation) // approximately, from the sum of uniforms
+    {
+        double sum = 0;
+        for (int i = 0; i < 6; i++)
+            sum += Uniform();
+        return sum * deviation / std::sqrt(2.0);
+    }
+};
+
+// The point east and north of origin by the given meters
+static GeoPoint Offset(GeoPoint origin, double east, double north)
+{
+    return { origin.latitude + north / 111320,
+             origin.longitude + east / (111320 * std::cos(origin.latitude * PI / 180)) };
+}
+
+static bool Near(double a, double b, double tolerance)
+{
+    return std::fabs(a - b) <= tolerance;
+}
+
+static const GeoPoint START = { 57.66, 12.28 };
+
+// Where a target moving at a constant speed and track is after the given time
+static GeoPoint Straight(double seconds, double groundSpeed, double track)
+{
+    const double meters = seconds * groundSpeed * METERS_PER_SECOND_PER_KT;
+    return Offset(START, meters * std::sin(track * PI / 180), meters * std::cos(track * PI / 180));
+}
+
+static void TestConvergence()
+{
+    // Taxiing at 15 kt on 040 with 20 m of position noise, starting from a bad reported velocity
+    Noise noise;
+    TrackFilter filter;
+    filter.Reset(0, START, 0, 270);
+    double filteredError = 0, reportedError = 0;
+    int samples = 0;
+    for (int t = REPORT_SECONDS; t <= 600; t += REPORT_SECONDS) {
+        const GeoPoint truth = Straight(t, 15, 40);
+        const GeoPoint reported = Offset(truth, noise.Normal(20), noise.Normal(20));
+        filter.Update(t, reported, 0, 270);
+        if (t < 120) continue;
+        filteredError += std::pow(DistanceMeters(filter.Position(), truth), 2);
+        reportedError += std::pow(DistanceMeters(reported, truth), 2);
+        samples++;
+    }
+    CHECK(Near(filter.GroundSpeed(), 15, 2));
+    CHECK(Near(filter.Track(), 40, 10));
+    CHECK(filter.outliers == 0);
+    // Clearly less than the error of the reports, as root mean square
+    const double filteredRms = std::sqrt(filteredError / samples);
+    const double reportedRms = std::sqrt(reportedError / samples);
+    CHECK(filteredRms < reportedRms * 0.75);
+    std::printf("  position error: reported %.1f m, filtered %.1f m (rms)\n", reportedRms, filteredRms);
+}
+
+static void TestOutlier()
+{
+    TrackFilter filter;
+    filter.Reset(0, START, 20, 90);
+    for (int t = REPORT_SECONDS; t <= 120; t += REPORT_SECONDS)
+        filter.Update(t, Straight(t, 20, 90), 20, 90);
+
+    // A single report 800 m off while taxiing is coasted through, velocity and all
+    filter.Update(125, Offset(Straight(125, 20, 90), 0, 800), 20, 90);
+    CHECK(filter.outliers == 1);
+    CHECK(DistanceMeters(filter.Position(), Straight(125, 20, 90)) < 2);
+    CHECK(Near(filter.GroundSpeed(), 20, 0.5) && Near(filter.Track(), 90, 1));
+    filter.Update(130, Straight(130, 20, 90), 20, 90);
+    CHECK(filter.outliers == 0);
+    CHECK(DistanceMeters(filter.Position(), Straight(130, 20, 90)) < 2);
+
+    // A target that really jumped (a new position after a reconnect) is followed after
+    // MAX_OUTLIERS reports
+    int t = 135;
+    for (int i = 0; i < TrackFilter::MAX_OUTLIERS; i++, t += REPORT_SECONDS) {
+        filter.Update(t, Offset(Straight(t, 20, 90), 0, 5000), 20, 90);
+        CHECK(DistanceMeters(filter.Position(), Straight(t, 20, 90)) < 2);
+    }
+    filter.Update(t, Offset(Straight(t, 20, 90), 0, 5000), 20, 90);
+    CHECK(filter.outliers == 0);
+    CHECK(DistanceMeters(filter.Position(), Offset(Straight(t, 20, 90), 0, 5000)) < 1);
+
+    // Turning at 3 degrees per second is not, though the filter lags well behind
+    int rejected = 0;
+    for (int groundSpeed : { 140, 250, 450 }) {
+        TrackFilter turning;
+        GeoPoint position = START;
+        double track = 0;
+        turning.Reset(0, position, groundSpeed, 0);
+        for (t = 1; t <= 180; t++) {
+            const double meters = groundSpeed * METERS_PER_SECOND_PER_KT;
+            position = Offset(position, meters * std::sin(track * PI / 180),
+                              meters * std::cos(track * PI / 180));
+            track = t > 30 ? std::fmod(track + 3, 360) : track;
+            if (t % REPORT_SECONDS != 0) continue;
+            turning.Update(t, position, groundSpeed, static_cast<int>(track));
+            rejected += turning.outliers > 0;
+        }
+    }
+    CHECK(rejected == 0);
+}
+
+static void TestStartsOver()
+{
+    TrackFilter filter;
+    filter.Update(100, START, 10, 90); // not initialized yet
+    CHECK(filter.initialized && filter.time == 100);
+    filter.Update(105, Straight(5, 10, 90), 10, 90);
+    CHECK(filter.origin.latitude == START.latitude);
+
+    // After a gap longer than MAX_INTERVAL_SECONDS, and going back in time
+    const GeoPoint later = Straight(60, 10, 90);
+    filter.Update(105 + TrackFilter::MAX_INTERVAL_SECONDS + 1, later, 12, 180);
+    CHECK(filter.origin.latitude == later.latitude && filter.east == 0);
+    CHECK(Near(filter.GroundSpeed(), 12, 0.01) && Near(filter.Track(), 180, 0.01));
+    filter.Update(100, START, 5, 0);
+    CHECK(filter.origin.latitude == START.latitude && Near(filter.Track(), 0, 0.01));
+
+    // A long flight moves the local origin along, without losing the position
+    TrackFilter cruise;
+    cruise.Reset(0, START, 450, 45);
+    int t = 0;
+    while (t < 1200) {
+        t += REPORT_SECONDS;
+        cruise.Update(t, Straight(t, 450, 45), 450, 45);
+    }
+    CHECK(DistanceMeters(cruise.origin, START) > TrackFilter::REANCHOR_DISTANCE_M);
+    CHECK(DistanceMeters(cruise.Position(), Straight(t, 450, 45)) < 50);
+}
+
+// A recorded-style ground movement: holding, taxiing parallel to a runway and holding again.
+// Positions jitter by 8 m and the reported ground speed by a few knots, as VATSIM reports do.
+struct Report {
+    int time;
+    GeoPoint position;
+    int groundSpeed;
+    int heading;
+};
+
+static std::vector<Report> GroundReplay(GeoPoint runwayEnd, double runwayTrack, double offset)
+{
+    const double sine = std::sin(runwayTrack * PI / 180), cosine = std::cos(runwayTrack * PI / 180);
+    Noise noise;
+    std::vector<Report> reports;
+    double along = 300;
+    for (int t = 0; t <= 900; t += REPORT_SECONDS) {
+        const double speed = t < 180 || t >= 540 ? 0 : 12; // kt
+        along += speed * METERS_PER_SECOND_PER_KT * REPORT_SECONDS;
+        const GeoPoint truth =
+            Offset(runwayEnd, along * sine + offset * cosine, along * cosine - offset * sine);
+        const int reportedSpeed = static_cast<int>(std::lround(std::fabs(speed + noise.Normal(2.5))));
+        reports.push_back({ t, Offset(truth, noise.Normal(8), noise.Normal(8)), reportedSpeed,
+                            static_cast<int>(runwayTrack) });
+    }
+    return reports;
+}
+
+struct Transitions {
+    int movement = 0;
+    int runway = 0;
+};
+
+// Runway fence and movement state changes along the reports, as the plugin detects them from the
+// reported or the filtered values
+static Transitions Replay(const std::vector<Report> &reports, const GeofenceIndex &index, bool filtered)
+{
+    Transitions transitions;
+    TrackFilter filter;
+    MovementState state = MOVEMENT_UNKNOWN, candidate = MOVEMENT_UNKNOWN;
+    std::uint8_t confirmations = 0;
+    int runway = GeofenceIndex::NONE;
+    for (const Report &report : reports) {
+        GeoPoint position = report.position;
+        int groundSpeed = report.groundSpeed;
+        if (filtered) {
+            filter.Update(report.time, report.position, report.groundSpeed, report.heading);
+            position = filter.Position();
+            groundSpeed = static_cast<int>(std::lround(filter.GroundSpeed()));
+        }
+        const int fence = index.FindRunway(position);
+        if (fence != runway) transitions.runway++;
+        runway = fence;
+        const bool onRunway = fence != GeofenceIndex::NONE;
+        const MovementInput input = { groundSpeed, 0, false, SURFACE_GROUND, onRunway, false };
+        if (ConfirmMovementState(InferMovementState(state, input), state, candidate, confirmations))
+            transitions.movement++;
+    }
+    return transitions;
+}
+
+static void TestFewerSpuriousTransitions()
+{
+    // The buffered edges of the runway lie 84 m from its centerline
+    GeofenceIndex index;
+    const GeoPoint runwayEnd = Offset(START, 0, -500);
+    index.AddRunway("ESGG", "03/21", runwayEnd,
+                    Offset(runwayEnd, 3300 * std::sin(35 * PI / 180), 3300 * std::cos(35 * PI / 180)));
+
+    // On a taxiway well clear of the runway: holding, taxi and holding again
+    const std::vector<Report> taxiway = GroundReplay(runwayEnd, 35, 300);
+    const Transitions raw = Replay(taxiway, index, false);
+    const Transitions filtered = Replay(taxiway, index, true);
+    std::printf("  movement state changes: reported %d, filtered %d\n", raw.movement,
+                filtered.movement);
+    CHECK(filtered.movement < raw.movement);
+    CHECK(raw.runway == 0 && filtered.runway == 0);
+
+    // 70 m from the centerline, inside the edge all the time
+    const std::vector<Report> edge = GroundReplay(runwayEnd, 35, 70);
+    const Transitions rawEdge = Replay(edge, index, false);
+    const Transitions filteredEdge = Replay(edge, index, true);
+    std::printf("  runway entries and exits: reported %d, filtered %d\n", rawEdge.runway,
+                filteredEdge.runway);
+    CHECK(filteredEdge.runway < rawEdge.runway);
+}
+
+int main()
+{
+    TestConvergence();
+    TestOutlier();
+    TestStartsOver();
+    TestFewerSpuriousTransitions();
+    return CheckResult();
+}
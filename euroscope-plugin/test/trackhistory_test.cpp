@@ -0,0 +1,109 @@
+#include "check.h"
+#include "trackhistory.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace VatEFS;
+
+static bool Near(double a, double b)
+{
+    return std::fabs(a - b) < 1e-5;
+}
+
+static bool SameSample(const TrackHistory::Sample &a, const TrackHistory::Sample &b)
+{
+    return a.time == b.time && Near(a.latitude, b.latitude) && Near(a.longitude, b.longitude) &&
+           a.altitude == b.altitude && a.groundSpeed == b.groundSpeed;
+}
+
+// Regular updates on a straight line, plus some irregular ones that need the larger delta classes
+static std::vector<TrackHistory::Sample> MakeTrack(std::time_t start, int count)
+{
+    std::vector<TrackHistory::Sample> samples;
+    std::time_t time = start;
+    for (int i = 0; i < count; i++) {
+        time += i % 50 == 49 ? 37 : 5;
+        const double jump = i % 100 == 99 ? 0.75 : 0.0;
+        samples.push_back({ time, 57.66 + i * 0.00123 + jump, 12.28 - i * 0.00071 - jump,
+                            i % 70 == 69 ? 35000 : 500 + i * 25, 140 + (i % 7) });
+    }
+    return samples;
+}
+
+static void TestRoundTrip()
+{
+    TrackHistory history;
+    const std::vector<TrackHistory::Sample> samples = MakeTrack(1700000000, 300);
+    for (const TrackHistory::Sample &sample : samples)
+        history.Add(sample);
+    CHECK(history.Count() == 300);
+
+    std::vector<TrackHistory::Sample> decoded;
+    history.Query(0, samples.back().time, decoded);
+    CHECK(decoded.size() == samples.size());
+    bool same = decoded.size() == samples.size();
+    for (std::size_t i = 0; same && i < samples.size(); i++)
+        same = SameSample(decoded[i], samples[i]);
+    CHECK(same);
+
+    // Inclusive range in the middle, across block boundaries
+    decoded.clear();
+    history.Query(samples[10].time, samples[200].time, decoded);
+    CHECK(decoded.size() == 191);
+    CHECK(!decoded.empty() && SameSample(decoded.front(), samples[10]));
+    CHECK(!decoded.empty() && SameSample(decoded.back(), samples[200]));
+}
+
+static void TestOutOfOrderIgnored()
+{
+    TrackHistory history;
+    history.Add({ 100, 57.0, 12.0, 1000, 150 });
+    history.Add({ 100, 58.0, 13.0, 2000, 160 });
+    history.Add({ 90, 58.0, 13.0, 2000, 160 });
+    CHECK(history.Count() == 1);
+}
+
+static void TestWindow()
+{
+    TrackHistory history;
+    // Two hours of 5 second updates, only about the last 30 minutes (plus the part of the oldest
+    // block still in it) are kept
+    const std::vector<TrackHistory::Sample> samples = MakeTrack(1700000000, 1440);
+    for (const TrackHistory::Sample &sample : samples)
+        history.Add(sample);
+    const int windowSamples = TrackHistory::WINDOW_SECONDS / 5;
+    CHECK(history.Count() >= windowSamples - 50);
+    CHECK(history.Count() <= windowSamples + TrackHistory::BLOCK_SAMPLES + 1);
+
+    std::vector<TrackHistory::Sample> decoded;
+    history.Query(0, samples.back().time, decoded);
+    CHECK(decoded.size() == static_cast<std::size_t>(history.Count()));
+    CHECK(!decoded.empty() && SameSample(decoded.back(), samples.back()));
+    // Decoded samples are the newest ones, in order
+    const std::size_t offset = samples.size() - decoded.size();
+    bool same = true;
+    for (std::size_t i = 0; same && i < decoded.size(); i++)
+        same = SameSample(decoded[i], samples[offset + i]);
+    CHECK(same);
+
+    // Blocks are reused, the memory doesn't keep growing
+    const std::size_t bytes = history.MemoryUsage();
+    const std::vector<TrackHistory::Sample> more = MakeTrack(samples.back().time, 1440);
+    for (const TrackHistory::Sample &sample : more)
+        history.Add(sample);
+    CHECK(history.MemoryUsage() == bytes);
+
+    history.Clear();
+    CHECK(history.Count() == 0);
+    history.Add(samples.front());
+    CHECK(history.Count() == 1);
+}
+
+int main()
+{
+    TestRoundTrip();
+    TestOutOfOrderIgnored();
+    TestWindow();
+    return CheckResult();
+}